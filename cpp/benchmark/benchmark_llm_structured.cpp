@@ -0,0 +1,644 @@
+#include "llm_structured.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llm_structured;
+
+// ---------------- Allocation counting ----------------
+
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+template <typename Fn>
+static size_t allocations_per_call(Fn&& fn) {
+  fn();  // warm up caches and thread-local scratch
+  const int calls = 10;
+  size_t before = g_allocations.load(std::memory_order_relaxed);
+  for (int i = 0; i < calls; ++i) fn();
+  return (g_allocations.load(std::memory_order_relaxed) - before) / calls;
+}
+
+// Keeps results alive so the optimizer cannot drop the measured work.
+static volatile size_t g_sink = 0;
+
+template <typename Fn>
+static double time_per_call_us(int iterations, Fn&& fn) {
+  for (int i = 0; i < iterations / 20 + 1; ++i) fn();  // warm up
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) fn();
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+}
+
+static void report(const char* name, int iterations, double per_call_us) {
+  std::printf("%-40s iterations=%-8d per_call=%.3fus\n", name, iterations, per_call_us);
+}
+
+// ---------------- String formats ----------------
+
+static void bench_string_formats() {
+  struct Case {
+    const char* format;
+    const char* regex;
+    std::vector<std::string> inputs;
+  };
+  // The regexes the hand-written validators replaced: schema validation used the email, uuid and date-time
+  // ones; date, time, ipv4, uri and hostname come from schema inference's format detection.
+  const std::vector<Case> cases = {
+      {"email", R"(^[^\s@]+@[^\s@]+\.[^\s@]+$)", {"alice@example.com", "bob.smith+tag@mail.example.org", "nope"}},
+      {"uuid",
+       R"(^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}$)",
+       {"123e4567-e89b-12d3-a456-426614174000", "not-a-uuid"}},
+      {"date-time",
+       R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(\.\d+)?(Z|[+-]\d{2}:\d{2})$)",
+       {"2024-01-15T10:30:00Z", "2024-01-15T10:30:00.123+08:00", "2024-01-15"}},
+      {"date", R"(^\d{4}-\d{2}-\d{2}$)", {"2024-01-15", "15/01/2024"}},
+      {"time", R"(^\d{2}:\d{2}:\d{2}(\.\d+)?$)", {"10:30:00", "10:30:00.250", "10h30"}},
+      {"ipv4", R"(^(\d{1,3}\.){3}\d{1,3}$)", {"192.168.1.20", "10.0.0.1", "1.2.3"}},
+      {"uri", R"(^(https?|ftp|mailto|file|data)://[^\s]+$)", {"https://example.com/a/b?c=d", "hello world"}},
+      {"hostname",
+       R"(^[a-zA-Z0-9]([a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?(\.[a-zA-Z0-9]([a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?)*$)",
+       {"api.example.com", "my-service-01.internal.example.net", "bad_host"}},
+  };
+
+  const int iterations = 20000;
+  for (const auto& c : cases) {
+    std::regex re(c.regex);
+    double regex_us = time_per_call_us(iterations, [&] {
+      for (const auto& s : c.inputs) g_sink = g_sink + (std::regex_match(s, re) ? 1 : 0);
+    });
+    double fast_us = time_per_call_us(iterations, [&] {
+      for (const auto& s : c.inputs) g_sink = g_sink + (matches_string_format(c.format, s) ? 1 : 0);
+    });
+    std::string name = std::string("format/") + c.format;
+    report((name + " std::regex").c_str(), iterations, regex_us);
+    report((name + " validator").c_str(), iterations, fast_us);
+    std::printf("%-40s speedup=%.1fx\n", name.c_str(), regex_us / fast_us);
+  }
+}
+
+// ---------------- Schema patterns ----------------
+
+static void bench_pattern_matching() {
+  struct Case {
+    const char* name;
+    const char* pattern;
+    std::string input;
+    int iterations;
+  };
+  const std::vector<Case> cases = {
+      {"pattern/slug", "^[a-z0-9]+(-[a-z0-9]+)*$", "structured-output-parsing-for-large-language-models", 20000},
+      {"pattern/search_word", "\\berror\\b", std::string(2000, 'x') + " error", 2000},
+      {"pattern/nested_quantifier", "^(a+)+$", std::string(20, 'a') + "!", 5},
+  };
+  for (const auto& c : cases) {
+    std::regex re(c.pattern, std::regex::ECMAScript);
+    CompiledSchema schema(Json(JsonObject{{"pattern", c.pattern}}));
+    Json value(c.input);
+    double regex_us = time_per_call_us(c.iterations, [&] { g_sink = g_sink + (std::regex_search(c.input, re) ? 1 : 0); });
+    double nfa_us = time_per_call_us(c.iterations, [&] { g_sink = g_sink + validate_all(value, schema).size(); });
+    report((std::string(c.name) + " std::regex").c_str(), c.iterations, regex_us);
+    report((std::string(c.name) + " validate").c_str(), c.iterations, nfa_us);
+  }
+}
+
+// ---------------- Validation (python/benchmark payload) ----------------
+
+// Same shape as python/benchmark/benchmark_llm_structured.py: {"items":[{id,score,label}...],"meta":{count}}.
+static std::string make_items_payload(int n) {
+  std::string out = "```json\n{\"items\": [";
+  for (int i = 0; i < n; ++i) {
+    if (i) out += ", ";
+    out += "{\"id\": " + std::to_string(i) + ", \"score\": 0." + std::to_string(100 + (i * 37) % 900) +
+           ", \"label\": \"item-" + std::to_string(i) + "\"}";
+  }
+  out += "], \"meta\": {\"count\": " + std::to_string(n) + "}}\n```";
+  return out;
+}
+
+static Json item_schema() {
+  return Json(JsonObject{
+      {"type", "object"},
+      {"required", JsonArray{Json("id"), Json("score"), Json("label")}},
+      {"additionalProperties", Json(false)},
+      {"properties", Json(JsonObject{
+          {"id", Json(JsonObject{{"type", "integer"}, {"minimum", 0.0}})},
+          {"score", Json(JsonObject{{"type", "number"}, {"minimum", 0.0}, {"maximum", 1.0}})},
+          {"label", Json(JsonObject{{"type", "string"}, {"minLength", 1.0}})},
+      })},
+  });
+}
+
+static Json items_schema() {
+  const Json item = item_schema();
+  return Json(JsonObject{
+      {"type", "object"},
+      {"required", JsonArray{Json("items"), Json("meta")}},
+      {"additionalProperties", Json(false)},
+      {"properties", Json(JsonObject{
+          {"items", Json(JsonObject{{"type", "array"}, {"items", item}})},
+          {"meta", Json(JsonObject{
+              {"type", "object"},
+              {"required", JsonArray{Json("count")}},
+              {"additionalProperties", Json(false)},
+              {"properties", Json(JsonObject{{"count", Json(JsonObject{{"type", "integer"}, {"minimum", 0.0}})}})},
+          })},
+      })},
+  });
+}
+
+static void bench_validate_payload() {
+  const Json schema = items_schema();
+  const CompiledSchema compiled(schema);
+  for (int n : {20, 1000}) {
+    const std::string payload = make_items_payload(n);
+    const Json value = loads_jsonish(payload);
+    const int iterations = n == 20 ? 20000 : 500;
+    const std::string suffix = " items=" + std::to_string(n);
+
+    auto validate_json = [&] { validate(value, schema); };
+    auto validate_compiled = [&] { validate(value, compiled); };
+    auto parse_validate = [&] { g_sink = g_sink + parse_and_validate(payload, compiled).as_object().size(); };
+
+    report(("validate/json_schema" + suffix).c_str(), iterations, time_per_call_us(iterations, validate_json));
+    report(("validate/compiled" + suffix).c_str(), iterations, time_per_call_us(iterations, validate_compiled));
+    report(("parse_and_validate/compiled" + suffix).c_str(), iterations, time_per_call_us(iterations, parse_validate));
+    std::printf("%-40s allocations/call=%zu\n", ("validate/compiled" + suffix).c_str(), allocations_per_call(validate_compiled));
+    std::printf("%-40s allocations/call=%zu\n", ("parse_and_validate/compiled" + suffix).c_str(), allocations_per_call(parse_validate));
+  }
+}
+
+// ---------------- Schema combinators ----------------
+
+// A oneOf over tagged variants pinned by a "kind" const; each value matches exactly one branch.
+static Json tagged_union_schema(int variants) {
+  JsonArray branches;
+  for (int i = 0; i < variants; ++i) {
+    branches.push_back(Json(JsonObject{
+        {"type", "object"},
+        {"required", JsonArray{Json("kind"), Json("value")}},
+        {"properties", Json(JsonObject{
+            {"kind", Json(JsonObject{{"const", "variant_" + std::to_string(i)}})},
+            {"value", Json(JsonObject{{"type", "number"}})},
+        })},
+    }));
+  }
+  return Json(JsonObject{{"type", "array"}, {"items", Json(JsonObject{{"oneOf", branches}})}});
+}
+
+static Json tagged_union_values(int variants, int count) {
+  JsonArray values;
+  for (int i = 0; i < count; ++i) {
+    values.push_back(Json(JsonObject{{"kind", "variant_" + std::to_string(i % variants)}, {"value", Json(1.5)}}));
+  }
+  return Json(values);
+}
+
+static void bench_schema_combinators() {
+  const int iterations = 500;
+  for (int variants : {8, 32}) {
+    const CompiledSchema one_of(tagged_union_schema(variants));
+    const Json values = tagged_union_values(variants, 100);
+    const std::string name = "oneOf/" + std::to_string(variants) + "_branches x100";
+    report(name.c_str(), iterations, time_per_call_us(iterations, [&] { validate(values, one_of); }));
+  }
+
+  const CompiledSchema contains(Json(JsonObject{
+      {"type", "array"}, {"contains", Json(JsonObject{{"type", "string"}})}, {"minContains", 1.0}}));
+  JsonArray numbers(100, Json(1.0));
+  numbers.push_back(Json("x"));
+  const Json contains_values(numbers);
+  report("contains/100_misses", iterations, time_per_call_us(iterations, [&] { validate(contains_values, contains); }));
+}
+
+// ---------------- Parsing ----------------
+
+static void bench_parse_jsonish() {
+  RepairConfig repair_only;
+  repair_only.strict_fast_path = false;
+  const std::string clean = make_items_payload(20);
+  const std::string messy = "```json\n{items: [{id: 1, score: 0.5, label: 'a',}], meta: {count: 1},}\n```";
+  const int iterations = 20000;
+  for (const auto& c : {std::make_pair("clean", &clean), std::make_pair("repaired", &messy)}) {
+    const std::string name = std::string("loads_jsonish/") + c.first;
+    double fast_us = time_per_call_us(iterations, [&] { g_sink = g_sink + loads_jsonish_ex(*c.second).fixed.size(); });
+    double slow_us =
+        time_per_call_us(iterations, [&] { g_sink = g_sink + loads_jsonish_ex(*c.second, repair_only).fixed.size(); });
+    report((name + " strict_fast_path").c_str(), iterations, fast_us);
+    report((name + " repair_only").c_str(), iterations, slow_us);
+  }
+}
+
+// A long LLM-style answer that needs every text repair: comments, Python literals, unquoted keys,
+// single and smart quotes and trailing commas.
+static std::string make_messy_payload(int n) {
+  std::string out = "Sure! Here is the data:\n```json\n{\n  // generated\n  items: [\n";
+  for (int i = 0; i < n; ++i) {
+    out += "    {id: " + std::to_string(i) + ", label: \xE2\x80\x9Citem-" + std::to_string(i) +
+           "\xE2\x80\x9D, ok: True, note: None, tags: ['a', 'b',], /* row */},\n";
+  }
+  out += "  ],\n}\n```\nLet me know if you need anything else.";
+  return out;
+}
+
+static void bench_repair_jsonish() {
+  for (int n : {20, 1000}) {
+    const std::string payload = make_messy_payload(n);
+    const int iterations = n == 20 ? 5000 : 100;
+    const std::string name = "loads_jsonish/messy items=" + std::to_string(n);
+    report(name.c_str(), iterations, time_per_call_us(iterations, [&] { g_sink = g_sink + loads_jsonish_ex(payload).fixed.size(); }));
+  }
+}
+
+// An embedding-style payload: one long array of floats plus an array of integer ids.
+static std::string make_numeric_payload(int n) {
+  std::string out = "{\"embedding\": [";
+  for (int i = 0; i < n; ++i) {
+    if (i) out += ", ";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", std::sin(i * 0.37) * 0.125);
+    out += buf;
+  }
+  out += "], \"ids\": [";
+  for (int i = 0; i < n; ++i) {
+    if (i) out += ", ";
+    out += std::to_string(1000003 * i);
+  }
+  out += "]}";
+  return out;
+}
+
+static void bench_parse_numbers() {
+  const std::string payload = make_numeric_payload(1536);
+  const int iterations = 2000;
+  report("loads_jsonish/numeric x1536", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + loads_jsonish(payload).as_object().size(); }));
+}
+
+static void bench_parse_document() {
+  JsonDocument doc;
+  for (int n : {20, 1000}) {
+    const std::string payload = make_items_payload(n);
+    const int iterations = n == 20 ? 20000 : 500;
+    const std::string suffix = " items=" + std::to_string(n);
+    auto parse_json = [&] { g_sink = g_sink + loads_jsonish(payload).as_object().size(); };
+    auto parse_doc = [&] {
+      loads_jsonish_into(doc, payload);
+      g_sink = g_sink + doc.root().size();
+    };
+    report(("loads_jsonish" + suffix).c_str(), iterations, time_per_call_us(iterations, parse_json));
+    report(("loads_jsonish_into" + suffix).c_str(), iterations, time_per_call_us(iterations, parse_doc));
+    std::printf("%-40s allocations/call=%zu\n", ("loads_jsonish" + suffix).c_str(), allocations_per_call(parse_json));
+    std::printf("%-40s allocations/call=%zu\n", ("loads_jsonish_into" + suffix).c_str(), allocations_per_call(parse_doc));
+  }
+}
+
+// Routing reads two fields from a large answer; the rest of the payload is never decoded.
+static void bench_json_view() {
+  const std::string payload = "{\"route\": \"search\", \"confidence\": 0.92, \"data\": " +
+                              make_items_payload(1000).substr(8, std::string::npos) + "}";
+  const std::string json = payload.substr(0, payload.size() - 4) + "}";
+  const int iterations = 500;
+  auto with_json = [&] {
+    Json v = loads_jsonish(json);
+    g_sink = g_sink + v.as_object().at("route").as_string().size() +
+             static_cast<size_t>(v.as_object().at("confidence").as_number());
+  };
+  auto with_tape = [&] {
+    JsonTape tape = parse_json_tape(json);
+    g_sink = g_sink + tape.root().find("route")->raw_string().size() +
+             static_cast<size_t>(tape.root().find("confidence")->as_number());
+  };
+  report("route/loads_jsonish", iterations, time_per_call_us(iterations, with_json));
+  report("route/parse_json_tape", iterations, time_per_call_us(iterations, with_tape));
+  std::printf("%-40s allocations/call=%zu\n", "route/loads_jsonish", allocations_per_call(with_json));
+  std::printf("%-40s allocations/call=%zu\n", "route/parse_json_tape", allocations_per_call(with_tape));
+}
+
+// Counts scalars and sums numbers: the kind of single pass that doesn't need a tree.
+struct SaxTally : JsonSaxHandler {
+  size_t scalars{0};
+  double sum{0};
+  bool on_number(double v) override {
+    ++scalars;
+    sum += v;
+    return true;
+  }
+  bool on_string(std::string_view) override {
+    ++scalars;
+    return true;
+  }
+};
+
+static void tally_json(const Json& v, SaxTally& t) {
+  if (v.is_number()) {
+    t.on_number(v.as_number());
+  } else if (v.is_string()) {
+    t.on_string(v.as_string());
+  } else if (v.is_array()) {
+    for (const auto& x : v.as_array()) tally_json(x, t);
+  } else if (v.is_object()) {
+    for (const auto& kv : v.as_object()) tally_json(kv.second, t);
+  }
+}
+
+static void bench_sax() {
+  const std::string payload = make_items_payload(1000);
+  const int iterations = 500;
+  auto with_json = [&] {
+    SaxTally t;
+    tally_json(loads_jsonish(payload), t);
+    g_sink = g_sink + t.scalars + static_cast<size_t>(t.sum);
+  };
+  auto with_sax = [&] {
+    SaxTally t;
+    parse_jsonish_sax(payload, t);
+    g_sink = g_sink + t.scalars + static_cast<size_t>(t.sum);
+  };
+  report("tally/loads_jsonish", iterations, time_per_call_us(iterations, with_json));
+  report("tally/parse_jsonish_sax", iterations, time_per_call_us(iterations, with_sax));
+  std::printf("%-40s allocations/call=%zu\n", "tally/loads_jsonish", allocations_per_call(with_json));
+  std::printf("%-40s allocations/call=%zu\n", "tally/parse_jsonish_sax", allocations_per_call(with_sax));
+}
+
+static void bench_fused_validate() {
+  const CompiledSchema compiled(items_schema());
+  const std::string valid = make_items_payload(1000);
+  // A wrong-typed member near the start of an otherwise large output.
+  const std::string invalid = [&] {
+    std::string out = valid;
+    out.replace(out.find("\"id\": 1,"), 8, "\"id\": \"1\",");
+    return out;
+  }();
+  const int iterations = 500;
+  for (const auto& c : {std::make_pair("valid", &valid), std::make_pair("invalid", &invalid)}) {
+    auto two_pass = [&] {
+      try {
+        g_sink = g_sink + parse_and_validate_ex(*c.second, compiled).fixed.size();
+      } catch (const ValidationError& e) {
+        g_sink = g_sink + e.path.size();
+      }
+    };
+    auto fused = [&] {
+      try {
+        g_sink = g_sink + parse_and_validate_fused(*c.second, compiled).fixed.size();
+      } catch (const ValidationError& e) {
+        g_sink = g_sink + e.path.size();
+      }
+    };
+    const std::string name = std::string(c.first) + " items=1000";
+    report(("parse_and_validate_ex/" + name).c_str(), iterations, time_per_call_us(iterations, two_pass));
+    report(("parse_and_validate_fused/" + name).c_str(), iterations, time_per_call_us(iterations, fused));
+  }
+}
+
+static void bench_enum_validation() {
+  JsonArray values;
+  for (int i = 0; i < 200; ++i) values.push_back(Json("value-" + std::to_string(i)));
+  const Json schema(JsonObject{{"type", "string"}, {"enum", Json(values)}});
+  const CompiledSchema compiled(schema);
+  const Json hit("value-150");
+  const Json miss("value-999");
+  const int iterations = 200000;
+  report("enum200/json_schema", 2000, time_per_call_us(2000, [&] { validate(hit, schema); }));
+  report("enum200/hit", iterations, time_per_call_us(iterations, [&] { validate(hit, compiled); }));
+  report("enum200/miss", iterations, time_per_call_us(iterations, [&] { g_sink = g_sink + validate_all(miss, compiled).size(); }));
+}
+
+static void bench_dumps_json() {
+  const Json value = loads_jsonish(make_numeric_payload(500));
+  const Json items = loads_jsonish(make_items_payload(1000));
+  const int iterations = 500;
+  for (const auto& c : {std::make_pair("numeric", &value), std::make_pair("items", &items)}) {
+    const std::string name = std::string("dumps_json/") + c.first;
+    report(name.c_str(), iterations, time_per_call_us(iterations, [&] { g_sink = g_sink + dumps_json(*c.second).size(); }));
+    std::printf("%-40s allocations/call=%zu\n", name.c_str(),
+                allocations_per_call([&] { g_sink = g_sink + dumps_json(*c.second).size(); }));
+    JsonWriter writer;
+    auto reuse = [&] {
+      writer.clear();
+      g_sink = g_sink + writer.write(*c.second).str().size();
+    };
+    const std::string wname = std::string("JsonWriter(reused)/") + c.first;
+    report(wname.c_str(), iterations, time_per_call_us(iterations, reuse));
+    std::printf("%-40s allocations/call=%zu\n", wname.c_str(), allocations_per_call(reuse));
+  }
+}
+
+static void bench_output_sink() {
+  // Emitting a large document to a consumer: materialize then hand over, vs stream through a 4 KiB sink.
+  const Json items = loads_jsonish(make_items_payload(5000));
+  const int iterations = 100;
+  auto consume = [](std::string_view chunk) { g_sink = g_sink + chunk.size(); };
+  auto whole = [&] { consume(dumps_json(items)); };
+  auto streamed = [&] {
+    OutputSink sink(consume, 4096);
+    dump_json(items, sink);
+  };
+  auto whole_yaml = [&] { consume(dumps_yaml(items)); };
+  auto streamed_yaml = [&] {
+    OutputSink sink(consume, 4096);
+    dump_yaml(items, sink);
+  };
+  const std::pair<const char*, std::function<void()>> cases[] = {
+      {"output_sink/dumps_json", whole},
+      {"output_sink/dump_json(4KiB)", streamed},
+      {"output_sink/dumps_yaml", whole_yaml},
+      {"output_sink/dump_yaml(4KiB)", streamed_yaml},
+  };
+  for (const auto& c : cases) {
+    report(c.first, iterations, time_per_call_us(iterations, c.second));
+    std::printf("%-40s allocations/call=%zu\n", c.first, allocations_per_call(c.second));
+  }
+}
+
+static void bench_try_api() {
+  // A mostly-invalid stream of short outputs: one in ten passes.
+  const CompiledSchema compiled(item_schema());
+  const std::vector<std::string> corpus = {
+      R"({"id": 3, "score": 0.5, "label": "ok"})",
+      R"({"id": 3, "score": 0.5})",
+      R"({"id": "3", "score": 0.5, "label": "x"})",
+      R"({"id": 3, "score": 1.5, "label": "x"})",
+      R"({"id": 3, "score": 0.5, "label": "x", "note": "extra"})",
+      R"(Here you go: {"id": 3, "score": 0.5 "label": })",
+      R"({"id": 3, "score": 0.5, "label": "x)",
+      R"([{"id": 3}, {"id": ])",
+      "I'm sorry, I can't produce that.",
+      R"({"id": -1, "score": 0.5, "label": ""})",
+  };
+  const int iterations = 2000;
+  auto throwing = [&] {
+    for (const auto& text : corpus) {
+      try {
+        g_sink = g_sink + parse_and_validate(text, compiled).is_object();
+      } catch (const std::exception& e) {
+        g_sink = g_sink + std::strlen(e.what());
+      }
+    }
+  };
+  auto non_throwing = [&] {
+    for (const auto& text : corpus) {
+      auto r = try_parse_and_validate(text, compiled);
+      g_sink = g_sink + (r.ok() ? 1 : r.message.size());
+    }
+  };
+  report("parse_and_validate+catch/10 outputs", iterations, time_per_call_us(iterations, throwing));
+  report("try_parse_and_validate/10 outputs", iterations, time_per_call_us(iterations, non_throwing));
+  std::printf("%-40s allocations/call=%zu\n", "parse_and_validate+catch/10 outputs", allocations_per_call(throwing));
+  std::printf("%-40s allocations/call=%zu\n", "try_parse_and_validate/10 outputs", allocations_per_call(non_throwing));
+}
+
+static void bench_multi_candidate() {
+  // 1,000 objects embedded in prose; in the second text every line also has a bracket that never closes.
+  std::string prose, stray;
+  for (int i = 0; i < 1000; ++i) {
+    const std::string obj = "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a\", \"b\"]}";
+    prose += "Item " + std::to_string(i) + ": " + obj + " done.\n";
+    stray += "Item " + std::to_string(i) + " {note: " + obj + " done.\n";
+  }
+  const int iterations = 50;
+  for (const auto& c : {std::make_pair("prose", &prose), std::make_pair("stray", &stray)}) {
+    const std::string& text = *c.second;
+    const std::string suffix = std::string("/1000 ") + c.first;
+    report(("extract_json_candidates" + suffix).c_str(), iterations,
+           time_per_call_us(iterations, [&] { g_sink = g_sink + extract_json_candidates(text).size(); }));
+    report(("loads_jsonish_all" + suffix).c_str(), iterations,
+           time_per_call_us(iterations, [&] { g_sink = g_sink + loads_jsonish_all(text).size(); }));
+  }
+  auto stream = [&] {
+    JsonStreamBatchCollector collector(Json(JsonObject{}));
+    collector.append(prose);
+    g_sink = g_sink + collector.poll().value->size();
+  };
+  report("JsonStreamBatchCollector/1000 prose", iterations, time_per_call_us(iterations, stream));
+}
+
+static void bench_structural_scan() {
+  // A long chat reply with the structured part after ~60 KB of prose.
+  std::string prose;
+  for (int i = 0; i < 600; ++i) prose += "This paragraph explains step " + std::to_string(i) + " of the plan in plain words, at some length.\n";
+  const std::string fenced_json = prose + "```json\n{\"ok\": true, \"items\": [1, 2, 3]}\n```\n";
+  const std::string bare_json = prose + "Result: {\"ok\": true, \"items\": [1, 2, 3]}\n";
+  const std::string fenced_yaml = prose + "```yaml\nok: true\nitems: [1, 2, 3]\n```\n";
+  const std::string sql = prose + "```sql\nSELECT id FROM users WHERE id = 1 LIMIT 5\n```\n";
+  const std::string xml = prose + "<result ok=\"true\"><item>1</item><item>2</item></result>\n";
+  const int iterations = 200;
+  report("extract_json_candidate/fenced 60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_json_candidate(fenced_json).size(); }));
+  report("extract_json_candidate/bare 60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_json_candidate(bare_json).size(); }));
+  report("extract_json_candidates/fenced 60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_json_candidates(fenced_json).size(); }));
+  report("extract_yaml_candidate/fenced 60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_yaml_candidate(fenced_yaml).size(); }));
+  report("extract_sql_candidate/fenced 60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_sql_candidate(sql).size(); }));
+  report("extract_xml_candidate/60KB", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_xml_candidate(xml).size(); }));
+}
+
+static void bench_structured_blocks() {
+  // An agent reply mixing prose with json, yaml, toml, xml and sql blocks, 40 of each.
+  std::string reply;
+  for (int i = 0; i < 40; ++i) {
+    const std::string n = std::to_string(i);
+    reply += "Step " + n + " sets things up as described below, with a short explanation of why.\n";
+    reply += "```json\n{\"id\": " + n + ", \"tags\": [\"a\", \"b\"]}\n```\n";
+    reply += "```yaml\nname: svc" + n + "\nreplicas: 3\n```\n";
+    reply += "```toml\n[server]\nport = 80" + n + "\n```\n";
+    reply += "```xml\n<item id=\"" + n + "\"><name>x</name></item>\n```\n";
+    reply += "```sql\nSELECT id FROM t" + n + " WHERE id = 1 LIMIT 5\n```\n";
+  }
+  const int iterations = 50;
+  report("extract_structured_blocks/200 blocks", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + extract_structured_blocks(reply).size(); }));
+  report("five extract_*_candidates/200 blocks", iterations, time_per_call_us(iterations, [&] {
+           g_sink = g_sink + extract_json_candidates(reply).size() + extract_yaml_candidates(reply).size() +
+                    extract_toml_candidates(reply).size() + extract_xml_candidates(reply).size() +
+                    extract_sql_candidate(reply).size();
+         }));
+  report("parse_structured_blocks/200 blocks", iterations,
+         time_per_call_us(iterations, [&] { g_sink = g_sink + parse_structured_blocks(reply).size(); }));
+}
+
+static void bench_json_stream_tokens() {
+  // A ~20 KB answer streamed a few bytes per token, polled after every token.
+  std::string answer = "{";
+  for (int i = 0; i < 400; ++i) {
+    if (i) answer += ", ";
+    answer += "\"item" + std::to_string(i) + "\": {\"id\": " + std::to_string(i) + ", \"text\": \"some generated words\"}";
+  }
+  answer += "}";
+  const int iterations = 20;
+  for (size_t token : {4, 16}) {
+    report(("JsonStreamParser poll per token/" + std::to_string(answer.size() / 1024) + "KB, " + std::to_string(token) + "B tokens").c_str(),
+           iterations, time_per_call_us(iterations, [&] {
+             JsonStreamParser parser(Json(JsonObject{}));
+             for (size_t i = 0; i < answer.size(); i += token) {
+               parser.append(answer.substr(i, token));
+               if (parser.poll().done) break;
+             }
+             g_sink = g_sink + parser.poll().ok;
+           }));
+  }
+  report(("JsonStreamParser poll_partial per token/" + std::to_string(answer.size() / 1024) + "KB, 4B tokens").c_str(),
+         iterations, time_per_call_us(iterations, [&] {
+           JsonStreamParser parser(Json(JsonObject{}));
+           for (size_t i = 0; i < answer.size(); i += 4) {
+             parser.append(answer.substr(i, 4));
+             g_sink = g_sink + parser.poll_partial().incomplete.size();
+           }
+         }));
+}
+
+int main(int argc, char** argv) {
+  // Optional argument: only run benchmarks whose name contains it.
+  const char* filter = argc > 1 ? argv[1] : "";
+  auto run = [&](const char* name, void (*fn)()) {
+    if (std::strstr(name, filter) == nullptr) return;
+    std::cout << "== " << name << "\n";
+    fn();
+  };
+
+  run("string_formats", bench_string_formats);
+  run("pattern_matching", bench_pattern_matching);
+  run("validate_payload", bench_validate_payload);
+  run("schema_combinators", bench_schema_combinators);
+  run("parse_jsonish", bench_parse_jsonish);
+  run("repair_jsonish", bench_repair_jsonish);
+  run("parse_numbers", bench_parse_numbers);
+  run("parse_document", bench_parse_document);
+  run("json_view", bench_json_view);
+  run("sax", bench_sax);
+  run("fused_validate", bench_fused_validate);
+  run("enum_validation", bench_enum_validation);
+  run("dumps_json", bench_dumps_json);
+  run("output_sink", bench_output_sink);
+  run("try_api", bench_try_api);
+  run("multi_candidate", bench_multi_candidate);
+  run("structural_scan", bench_structural_scan);
+  run("structured_blocks", bench_structured_blocks);
+  run("json_stream_tokens", bench_json_stream_tokens);
+  return 0;
+}
@@ -2,10 +2,18 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <iosfwd>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -22,23 +30,180 @@ struct ValidationError : public std::runtime_error {
   const char* what() const noexcept override { return message.c_str(); }
 };
 
+// Failure categories of the non-throwing try_* entry points. Parse, Schema, Type and Limit match the
+// `kind` of the ValidationError the throwing counterpart raises; NotFound is its "no JSON found".
+enum class ErrorCode { Ok, NotFound, Parse, DuplicateKey, Schema, Type, Limit, Internal };
+
+// Outcome of a try_* call. On failure, path and message are what the throwing counterpart would report.
+struct TryStatus {
+  ErrorCode code{ErrorCode::Ok};
+  std::string path;
+  std::string message;
+
+  bool ok() const { return code == ErrorCode::Ok; }
+  explicit operator bool() const { return ok(); }
+};
+
+template <typename T>
+struct TryResult : TryStatus {
+  T value{};  // default-constructed on failure
+};
+
 // Best-effort conversion from a JSONPath-ish string like "$.a[0].b" to a JSON Pointer like "/a/0/b".
 // Non-standard segments (e.g. "$.headings[Intro]") are preserved as a pointer segment ("/headings/Intro").
 std::string json_pointer_from_path(const std::string& json_path);
 
 struct Json;
-using JsonObject = std::map<std::string, Json>;
 using JsonArray = std::vector<Json>;
 
+// JSON object that keeps its keys in insertion order in one contiguous vector. Small objects are searched
+// linearly; past kIndexThreshold keys a hash index over entry positions is kept up to date. The API mirrors
+// the std::map subset the library uses (find/at/count/operator[]/emplace/insert/erase), but iteration
+// follows insertion order. As with std::map, iterators hand out keys as const.
+class JsonObject {
+ public:
+  using key_type = std::string;
+  using mapped_type = Json;
+  using value_type = std::pair<std::string, Json>;
+  using size_type = size_t;
+
+  // Random-access iterator over the entries whose reference is a {const key, value} pair of references, so
+  // a key can't be reassigned behind the index's back.
+  template <bool Const>
+  class Iter {
+    using Entries = std::vector<JsonObject::value_type>;
+    using Base = std::conditional_t<Const, Entries::const_iterator, Entries::iterator>;
+
+   public:
+    struct reference {
+      const std::string& first;
+      std::conditional_t<Const, const Json&, Json&> second;
+    };
+    struct pointer {
+      reference ref;
+      const reference* operator->() const { return &ref; }
+    };
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = JsonObject::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    Iter() = default;
+    template <bool C = Const, typename = std::enable_if_t<C>>
+    Iter(const Iter<false>& other) : it_(other.it_) {}
+
+    reference operator*() const { return reference{it_->first, it_->second}; }
+    pointer operator->() const { return pointer{**this}; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    Iter& operator++() {
+      ++it_;
+      return *this;
+    }
+    Iter operator++(int) { return Iter(it_++); }
+    Iter& operator--() {
+      --it_;
+      return *this;
+    }
+    Iter operator--(int) { return Iter(it_--); }
+    Iter& operator+=(difference_type n) {
+      it_ += n;
+      return *this;
+    }
+    Iter& operator-=(difference_type n) {
+      it_ -= n;
+      return *this;
+    }
+    friend Iter operator+(Iter a, difference_type n) { return a += n; }
+    friend Iter operator+(difference_type n, Iter a) { return a += n; }
+    friend Iter operator-(Iter a, difference_type n) { return a -= n; }
+    friend difference_type operator-(const Iter& a, const Iter& b) { return a.it_ - b.it_; }
+    friend bool operator==(const Iter& a, const Iter& b) { return a.it_ == b.it_; }
+    friend bool operator!=(const Iter& a, const Iter& b) { return a.it_ != b.it_; }
+    friend bool operator<(const Iter& a, const Iter& b) { return a.it_ < b.it_; }
+    friend bool operator>(const Iter& a, const Iter& b) { return a.it_ > b.it_; }
+    friend bool operator<=(const Iter& a, const Iter& b) { return a.it_ <= b.it_; }
+    friend bool operator>=(const Iter& a, const Iter& b) { return a.it_ >= b.it_; }
+
+   private:
+    friend class JsonObject;
+    friend class Iter<!Const>;
+    explicit Iter(Base it) : it_(it) {}
+    Base it_;
+  };
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+
+  static constexpr size_t kIndexThreshold = 16;
+
+  JsonObject() = default;
+  // Declared here and defaulted once Json is complete, so Json's variant can use them.
+  JsonObject(const JsonObject& other);
+  JsonObject(JsonObject&& other) noexcept;
+  JsonObject& operator=(const JsonObject& other);
+  JsonObject& operator=(JsonObject&& other) noexcept;
+  ~JsonObject();
+  JsonObject(std::initializer_list<value_type> init);
+  template <typename It>
+  JsonObject(It first, It last) {
+    insert(first, last);
+  }
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void reserve(size_t n) { entries_.reserve(n); }
+  void clear();
+
+  iterator begin() { return iterator(entries_.begin()); }
+  iterator end() { return iterator(entries_.end()); }
+  const_iterator begin() const { return const_iterator(entries_.begin()); }
+  const_iterator end() const { return const_iterator(entries_.end()); }
+  const_iterator cbegin() const { return const_iterator(entries_.cbegin()); }
+  const_iterator cend() const { return const_iterator(entries_.cend()); }
+
+  iterator find(std::string_view key);
+  const_iterator find(std::string_view key) const;
+  size_t count(std::string_view key) const { return position(key) != npos ? 1 : 0; }
+  bool contains(std::string_view key) const { return position(key) != npos; }
+  Json& at(std::string_view key);
+  const Json& at(std::string_view key) const;
+  Json& operator[](std::string_view key);
+
+  // Inserts when the key is absent; otherwise leaves the object (and the arguments) untouched.
+  template <typename K, typename V>
+  std::pair<iterator, bool> emplace(K&& key, V&& value);
+  std::pair<iterator, bool> insert(value_type entry);
+  template <typename It>
+  void insert(It first, It last) {
+    for (; first != last; ++first) insert(value_type(first->first, first->second));
+  }
+
+  // Erasing is O(n): later entries shift down to keep insertion order and the index is patched in place.
+  size_t erase(std::string_view key);
+  iterator erase(const_iterator pos);
+
+ private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+  size_t position(std::string_view key) const;
+  iterator append(value_type&& entry);
+  void index_slot(size_t pos);
+  void unindex_slot(size_t pos);
+  void rebuild_index();
+
+  std::vector<value_type> entries_;
+  std::vector<uint32_t> index_;  // open addressing over entries_, slot value = position + 1; empty when small
+};
+
 struct Json {
-  using Value = std::variant<std::nullptr_t, bool, double, std::string, JsonArray, JsonObject>;
+  // Integers that fit in int64_t are kept exact; every other number is a double.
+  using Value = std::variant<std::nullptr_t, bool, double, int64_t, std::string, JsonArray, JsonObject>;
   Value value;
 
   Json() : value(nullptr) {}
   Json(std::nullptr_t) : value(nullptr) {}
   Json(bool b) : value(b) {}
   Json(double n) : value(n) {}
-  Json(int64_t n) : value(static_cast<double>(n)) {}
+  Json(int n) : value(static_cast<int64_t>(n)) {}
+  Json(int64_t n) : value(n) {}
   Json(std::string s) : value(std::move(s)) {}
   Json(const char* s) : value(std::string(s)) {}
   Json(JsonArray a) : value(std::move(a)) {}
@@ -46,13 +211,15 @@ struct Json {
 
   bool is_null() const;
   bool is_bool() const;
-  bool is_number() const;
+  bool is_number() const;  // double or int64
+  bool is_int64() const;
   bool is_string() const;
   bool is_array() const;
   bool is_object() const;
 
   const bool& as_bool() const;
-  const double& as_number() const;
+  double as_number() const;  // int64 values are converted
+  int64_t as_int64() const;
   const std::string& as_string() const;
   const JsonArray& as_array() const;
   const JsonObject& as_object() const;
@@ -61,6 +228,140 @@ struct Json {
   JsonObject& as_object();
 };
 
+inline JsonObject::JsonObject(const JsonObject& other) = default;
+inline JsonObject::JsonObject(JsonObject&& other) noexcept = default;
+inline JsonObject& JsonObject::operator=(const JsonObject& other) = default;
+inline JsonObject& JsonObject::operator=(JsonObject&& other) noexcept = default;
+inline JsonObject::~JsonObject() = default;
+
+inline JsonObject::JsonObject(std::initializer_list<value_type> init) {
+  entries_.reserve(init.size());
+  for (const auto& e : init) insert(e);
+}
+
+inline void JsonObject::clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+inline size_t JsonObject::position(std::string_view key) const {
+  if (index_.empty()) {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].first == key) return i;
+    }
+    return npos;
+  }
+  const size_t mask = index_.size() - 1;
+  for (size_t h = std::hash<std::string_view>{}(key) & mask; index_[h] != 0; h = (h + 1) & mask) {
+    if (entries_[index_[h] - 1].first == key) return index_[h] - 1;
+  }
+  return npos;
+}
+
+inline JsonObject::iterator JsonObject::find(std::string_view key) {
+  size_t pos = position(key);
+  return pos == npos ? end() : begin() + static_cast<std::ptrdiff_t>(pos);
+}
+
+inline JsonObject::const_iterator JsonObject::find(std::string_view key) const {
+  size_t pos = position(key);
+  return pos == npos ? end() : begin() + static_cast<std::ptrdiff_t>(pos);
+}
+
+inline Json& JsonObject::at(std::string_view key) {
+  size_t pos = position(key);
+  if (pos == npos) throw std::out_of_range("JsonObject::at: missing key");
+  return entries_[pos].second;
+}
+
+inline const Json& JsonObject::at(std::string_view key) const {
+  size_t pos = position(key);
+  if (pos == npos) throw std::out_of_range("JsonObject::at: missing key");
+  return entries_[pos].second;
+}
+
+inline Json& JsonObject::operator[](std::string_view key) {
+  size_t pos = position(key);
+  if (pos != npos) return entries_[pos].second;
+  return append(value_type(std::string(key), Json()))->second;
+}
+
+template <typename K, typename V>
+std::pair<JsonObject::iterator, bool> JsonObject::emplace(K&& key, V&& value) {
+  size_t pos = position(key);
+  if (pos != npos) return {begin() + static_cast<std::ptrdiff_t>(pos), false};
+  return {append(value_type(std::forward<K>(key), std::forward<V>(value))), true};
+}
+
+inline std::pair<JsonObject::iterator, bool> JsonObject::insert(value_type entry) {
+  size_t pos = position(entry.first);
+  if (pos != npos) return {begin() + static_cast<std::ptrdiff_t>(pos), false};
+  return {append(std::move(entry)), true};
+}
+
+inline size_t JsonObject::erase(std::string_view key) {
+  size_t pos = position(key);
+  if (pos == npos) return 0;
+  erase(begin() + static_cast<std::ptrdiff_t>(pos));
+  return 1;
+}
+
+inline JsonObject::iterator JsonObject::erase(const_iterator pos) {
+  const size_t p = static_cast<size_t>(pos - cbegin());
+  if (entries_.size() - 1 <= kIndexThreshold) {
+    index_.clear();
+  } else if (!index_.empty()) {
+    unindex_slot(p);
+    // Positions after the erased entry move down by one; branch-free so the sweep vectorizes.
+    const uint32_t erased = static_cast<uint32_t>(p + 1);
+    for (auto& slot : index_) slot -= static_cast<uint32_t>(slot > erased);
+  }
+  return iterator(entries_.erase(pos.it_));
+}
+
+inline JsonObject::iterator JsonObject::append(value_type&& entry) {
+  if (entries_.capacity() == 0) entries_.reserve(4);  // skip the 1 -> 2 -> 4 growth steps of small objects
+  entries_.push_back(std::move(entry));
+  if (!index_.empty() && entries_.size() * 2 <= index_.size()) {
+    index_slot(entries_.size() - 1);
+  } else if (entries_.size() > kIndexThreshold) {
+    rebuild_index();
+  }
+  return end() - 1;
+}
+
+inline void JsonObject::index_slot(size_t pos) {
+  const size_t mask = index_.size() - 1;
+  size_t h = std::hash<std::string_view>{}(entries_[pos].first) & mask;
+  while (index_[h] != 0) h = (h + 1) & mask;
+  index_[h] = static_cast<uint32_t>(pos + 1);
+}
+
+// Backward-shift deletion, so probe chains stay intact without tombstones. Must run before entries_ changes.
+inline void JsonObject::unindex_slot(size_t pos) {
+  const size_t mask = index_.size() - 1;
+  size_t hole = std::hash<std::string_view>{}(entries_[pos].first) & mask;
+  while (index_[hole] != pos + 1) hole = (hole + 1) & mask;
+  for (size_t j = (hole + 1) & mask; index_[j] != 0; j = (j + 1) & mask) {
+    size_t home = std::hash<std::string_view>{}(entries_[index_[j] - 1].first) & mask;
+    // Move the entry into the hole unless its home slot lies cyclically in (hole, j].
+    if (((j - home) & mask) >= ((j - hole) & mask)) {
+      index_[hole] = index_[j];
+      hole = j;
+    }
+  }
+  index_[hole] = 0;
+}
+
+inline void JsonObject::rebuild_index() {
+  index_.clear();
+  if (entries_.size() <= kIndexThreshold) return;
+  size_t slots = 64;
+  while (slots < entries_.size() * 4) slots *= 2;
+  index_.assign(slots, 0);
+  for (size_t i = 0; i < entries_.size(); ++i) index_slot(i);
+}
+
 // ---------------- JSON-ish ----------------
 
 // Extracts a JSON candidate from LLM text (```json fenced block or first balanced {...} / [...] )
@@ -81,6 +382,8 @@ struct RepairConfig {
   bool drop_trailing_commas{true};
   // Strictness toggle: the underlying parser supports single quotes; you can forbid them.
   bool allow_single_quotes{true};
+  // Parse the candidate as-is first and run the repair passes above only if that fails.
+  bool strict_fast_path{true};
 
   enum class DuplicateKeyPolicy {
     Error,
@@ -102,6 +405,9 @@ struct RepairMetadata {
   bool quoted_unquoted_keys{false};
   bool dropped_trailing_commas{false};
 
+  // True when the candidate parsed as-is (RepairConfig::strict_fast_path) and no repair pass ran.
+  bool used_strict_fast_path{false};
+
   // Number of duplicate keys encountered while parsing objects.
   int duplicateKeyCount{0};
 
@@ -159,6 +465,405 @@ JsonishParseResult parse_and_validate_with_defaults_ex(const std::string& text,
 
 std::string dumps_json(const Json& value);
 
+// ---------------- Output sinks ----------------
+
+// Destination for the dump_* serializers. Output is staged in a buffer of bounded size and handed on
+// whenever it fills, so large outputs never sit in memory whole. A string target is appended to
+// directly instead. Write failures throw std::runtime_error; the destructor flushes but swallows them.
+class OutputSink {
+ public:
+  using FlushFn = std::function<void(std::string_view chunk)>;
+  static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+  explicit OutputSink(std::string& out);
+  explicit OutputSink(std::ostream& os, size_t buffer_size = kDefaultBufferSize);
+  explicit OutputSink(std::FILE* file, size_t buffer_size = kDefaultBufferSize);
+  // Hands each full buffer (and the remainder on flush()) to `flush`.
+  explicit OutputSink(FlushFn flush, size_t buffer_size = kDefaultBufferSize);
+  ~OutputSink();
+  OutputSink(const OutputSink&) = delete;
+  OutputSink& operator=(const OutputSink&) = delete;
+
+  OutputSink& operator+=(std::string_view s) {
+    buf_->append(s.data(), s.size());
+    if (buf_->size() >= limit_) flush();
+    return *this;
+  }
+  OutputSink& operator+=(char c) {
+    buf_->push_back(c);
+    if (buf_->size() >= limit_) flush();
+    return *this;
+  }
+
+  void flush();
+  // Bytes written through this sink so far, flushed or not.
+  size_t size() const { return flushed_ + buf_->size() - base_; }
+
+ private:
+  friend class JsonWriter;
+
+  std::string own_;
+  std::string* buf_;
+  size_t base_{0};  // length of a string target before this sink appended to it
+  size_t limit_;
+  size_t flushed_{0};
+  FlushFn flush_;
+};
+
+// Compact JSON serializer (same output as dumps_json) that appends to one buffer: its own, a
+// caller-supplied string, or a sink's. Reusing a writer keeps the buffer's capacity, so repeated writes
+// don't allocate. Doubles are written with the shortest text that parses back to the same value. With
+// indent > 0, containers are spread over lines indented by that many spaces per level.
+class JsonWriter {
+ public:
+  JsonWriter() : out_(&own_) {}
+  explicit JsonWriter(std::string& out, int indent = 0) : out_(&out), indent_(indent) {}
+  explicit JsonWriter(OutputSink& sink, int indent = 0) : out_(sink.buf_), sink_(&sink), indent_(indent) {}
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  // Appends `value`.
+  JsonWriter& write(const Json& value);
+  // Appends a quoted, escaped string or a number token.
+  JsonWriter& write_string(std::string_view s);
+  JsonWriter& write_number(double n);
+  JsonWriter& write_number(int64_t n);
+
+  const std::string& str() const { return *out_; }
+  void clear() { out_->clear(); }
+
+ private:
+  void write_value(const Json& value, int depth);
+  void newline(int depth);
+
+  std::string own_;
+  std::string* out_;
+  OutputSink* sink_{nullptr};
+  int indent_{0};
+};
+
+// Streams `value` into `sink` (compact when indent is 0) and flushes it.
+void dump_json(const Json& value, OutputSink& sink, int indent = 0);
+
+// Structural equality: numbers compare by value (1 == 1.0) and objects ignore member order.
+bool operator==(const Json& a, const Json& b);
+inline bool operator!=(const Json& a, const Json& b) { return !(a == b); }
+
+// Hash consistent with operator== (equal values hash equal whatever their member order or number
+// representation). Deterministic across runs and platforms.
+size_t hash(const Json& value);
+
+// ---------------- Arena documents ----------------
+
+// Read-only JSON node owned by a JsonDocument. Nodes, their children and their strings live in the
+// document's arena and stay valid until the document is cleared, reparsed or destroyed.
+// Accessors throw std::bad_variant_access on a kind mismatch, like Json's.
+class JsonNode {
+ public:
+  enum class Kind : uint8_t { Null, Bool, Int64, Double, String, Array, Object };
+  struct Member;
+
+  JsonNode() : kind_(Kind::Null), size_(0), u_{} {}
+
+  Kind kind() const { return kind_; }
+  bool is_null() const { return kind_ == Kind::Null; }
+  bool is_bool() const { return kind_ == Kind::Bool; }
+  bool is_number() const { return kind_ == Kind::Int64 || kind_ == Kind::Double; }
+  bool is_int64() const { return kind_ == Kind::Int64; }
+  bool is_string() const { return kind_ == Kind::String; }
+  bool is_array() const { return kind_ == Kind::Array; }
+  bool is_object() const { return kind_ == Kind::Object; }
+
+  bool as_bool() const;
+  double as_number() const;
+  int64_t as_int64() const;
+  std::string_view as_string() const;
+
+  // Number of array elements or object members.
+  size_t size() const;
+  const JsonNode& operator[](size_t index) const;
+  // Object members in source order.
+  const Member& member(size_t index) const;
+  // Object lookup by key (linear scan); nullptr when absent.
+  const JsonNode* find(std::string_view key) const;
+
+  Json to_json() const;
+
+ private:
+  friend struct JsonDocumentBuilder;
+  Kind kind_;
+  uint32_t size_;
+  union {
+    bool b;
+    int64_t i;
+    double d;
+    const char* str;
+    const JsonNode* items;
+    const Member* members;
+  } u_;
+};
+
+struct JsonNode::Member {
+  std::string_view key;
+  JsonNode value;
+};
+
+// Owns a parsed JSON tree and the arena it is allocated from. The whole tree is released at once;
+// reparsing into the same document reuses the arena memory instead of going back to the heap.
+class JsonDocument {
+ public:
+  JsonDocument();
+  ~JsonDocument();
+  JsonDocument(JsonDocument&&) noexcept;
+  JsonDocument& operator=(JsonDocument&&) noexcept;
+  JsonDocument(const JsonDocument&) = delete;
+  JsonDocument& operator=(const JsonDocument&) = delete;
+
+  const JsonNode& root() const;
+  Json to_json() const { return root().to_json(); }
+
+  // Drops the tree; the arena keeps a single block big enough for it.
+  void clear();
+  // Bytes currently reserved by the arena.
+  size_t arena_bytes() const;
+
+ private:
+  friend struct JsonDocumentBuilder;
+  struct Arena;
+  std::unique_ptr<Arena> arena_;
+  const JsonNode* root_;
+};
+
+// Like loads_jsonish_ex(), but parses into `doc` (replacing its previous tree) instead of building Json.
+RepairMetadata loads_jsonish_into(JsonDocument& doc, const std::string& text, const RepairConfig& repair = RepairConfig{});
+
+// ---------------- Zero-copy views ----------------
+
+class JsonTape;
+
+// Read-only view of one value on a JsonTape. Strings and numbers point into the tape's text and are only
+// decoded when read. A view is a small handle; the tape (and for parse_json_tape, the input buffer) must
+// outlive it. Accessors throw std::bad_variant_access on a kind mismatch.
+class JsonView {
+ public:
+  enum class Kind : uint8_t { Null, Bool, Number, String, Array, Object };
+  class Iterator;
+
+  Kind kind() const;
+  bool is_null() const { return kind() == Kind::Null; }
+  bool is_bool() const { return kind() == Kind::Bool; }
+  bool is_number() const { return kind() == Kind::Number; }
+  bool is_string() const { return kind() == Kind::String; }
+  bool is_array() const { return kind() == Kind::Array; }
+  bool is_object() const { return kind() == Kind::Object; }
+
+  bool as_bool() const;
+  double as_number() const;
+  // Integer literals that fit in int64 (same rule as the Json parser).
+  bool is_int64() const;
+  int64_t as_int64() const;
+  // String contents as written, escapes intact.
+  std::string_view raw_string() const;
+  std::string as_string() const;
+
+  // Array elements or object members.
+  size_t size() const;
+  // Array element; O(index) since siblings are skipped, not indexed.
+  JsonView operator[](size_t index) const;
+  // First object member with this key.
+  std::optional<JsonView> find(std::string_view key) const;
+  // Follows a path like "$.a.b[0]" or "a.b[0]"; nullopt when any step is missing.
+  std::optional<JsonView> at_path(std::string_view path) const;
+  // For values reached through an object, the member key as written; empty otherwise.
+  std::string_view key() const;
+
+  // Array elements or object values in order (use key() for member keys).
+  Iterator begin() const;
+  Iterator end() const;
+
+  Json to_json() const;
+
+ private:
+  friend class JsonTape;
+  JsonView(const JsonTape* tape, uint32_t index, uint32_t key_index) : tape_(tape), index_(index), key_index_(key_index) {}
+  uint32_t next_sibling() const;
+
+  const JsonTape* tape_;
+  uint32_t index_;
+  uint32_t key_index_;  // tape index of the member key + 1, or 0
+};
+
+class JsonView::Iterator {
+ public:
+  JsonView operator*() const;
+  Iterator& operator++();
+  bool operator==(const Iterator& o) const { return index_ == o.index_; }
+  bool operator!=(const Iterator& o) const { return index_ != o.index_; }
+
+ private:
+  friend class JsonView;
+  Iterator(const JsonTape* tape, uint32_t index, uint32_t end, bool object);
+  void skip_shadowed();
+  const JsonTape* tape_;
+  uint32_t index_;  // next child (for objects: its key)
+  uint32_t end_;
+  bool object_;
+};
+
+// Flat parse of one JSON value: one entry per value with offsets into the text, no decoded strings and no
+// tree. parse_json_tape() keeps duplicate keys (find() returns the first); loads_jsonish_tape() applies
+// RepairConfig::duplicate_key_policy, and members that lose are skipped by size(), find() and iteration.
+// Under LastWins the winning member is reported at the first occurrence's position, as loads_jsonish_ex()
+// orders it.
+class JsonTape {
+ public:
+  JsonView root() const { return JsonView(this, 0, 0); }
+  // The buffer the views point into.
+  std::string_view text() const { return owns_text_ ? std::string_view(owned_) : external_; }
+  const RepairMetadata& metadata() const { return metadata_; }
+
+ private:
+  friend class JsonView;
+  friend struct JsonTapeBuilder;
+  friend struct JsonSaxReplay;
+  friend JsonTape parse_json_tape(std::string_view json, bool allow_single_quotes);
+  friend JsonTape loads_jsonish_tape(const std::string& text, const RepairConfig& repair);
+
+  struct Entry {
+    JsonView::Kind kind;
+    uint8_t flags;  // String: has escapes; Number: integer literal; Bool: value
+    uint32_t a;     // String/Number: offset in text; Array/Object: child count
+    uint32_t b;     // String/Number: length; Array/Object: index one past the last descendant
+  };
+
+  std::vector<Entry> entries_;
+  std::string owned_;
+  std::string_view external_;
+  bool owns_text_{false};
+  RepairMetadata metadata_;
+};
+
+// Builds a tape over `json` in place (must be a single JSON value; single quotes allowed unless disabled).
+// Nothing is copied, so `json` must outlive the tape.
+JsonTape parse_json_tape(std::string_view json, bool allow_single_quotes = true);
+
+// Like loads_jsonish_ex(): extracts and (if needed) repairs the candidate, which the tape then owns.
+JsonTape loads_jsonish_tape(const std::string& text, const RepairConfig& repair = RepairConfig{});
+
+// ---------------- SAX parsing ----------------
+
+// Receives the values of a parse as events. Each callback returns true to continue or false to stop the
+// events early. String and key views are only valid during the call. Defaults accept and ignore everything.
+class JsonSaxHandler {
+ public:
+  virtual ~JsonSaxHandler() = default;
+
+  virtual bool on_null() { return true; }
+  virtual bool on_bool(bool) { return true; }
+  // Integer literals that fit in int64 (same rule as the Json parser); forwards to on_number by default.
+  virtual bool on_integer(int64_t value) { return on_number(static_cast<double>(value)); }
+  virtual bool on_number(double) { return true; }
+  virtual bool on_string(std::string_view) { return true; }
+  virtual bool on_array_start() { return true; }
+  virtual bool on_array_end() { return true; }
+  virtual bool on_object_start() { return true; }
+  virtual bool on_key(std::string_view) { return true; }
+  virtual bool on_object_end() { return true; }
+};
+
+// Extracts and repairs like loads_jsonish_ex(), then reports the value to `handler` as it is scanned,
+// without building a Json or a tape. The candidate's syntax is checked first (nothing is decoded or kept),
+// so text that needs repair is repaired before the first event and a malformed candidate emits none; a
+// handler that returns false stops the scan. Members that lose under duplicate_key_policy are not reported,
+// and duplicateKeyCount counts the duplicates met before a stop. Under LastWins a member's winner is only
+// known once its object closes, so that policy scans the candidate into a JsonTape and replays it.
+RepairMetadata parse_jsonish_sax(const std::string& text, JsonSaxHandler& handler, const RepairConfig& repair = RepairConfig{});
+
+// ---------------- Compiled schemas ----------------
+
+struct CompiledSchemaAccess;
+
+// A JSON schema compiled once into typed validation nodes (pre-parsed bounds, resolved
+// properties/required lists, enum tables). Reuse it to validate many values against the same schema.
+// Copies share the same immutable compiled form, so a CompiledSchema can be used from multiple threads.
+class CompiledSchema {
+ public:
+  // Compiles the empty schema {} (accepts every value).
+  CompiledSchema();
+  explicit CompiledSchema(Json schema);
+
+  // The source schema this was compiled from.
+  const Json& schema() const;
+
+ private:
+  struct Impl;
+  std::shared_ptr<const Impl> impl_;
+  friend struct CompiledSchemaAccess;
+};
+
+CompiledSchema compile_schema(const Json& schema);
+
+void validate(const Json& value, const CompiledSchema& schema, const std::string& path = "$");
+std::vector<ValidationError> validate_all(const Json& value, const CompiledSchema& schema, const std::string& path = "$");
+
+Json parse_and_validate(const std::string& text, const CompiledSchema& schema);
+JsonishParseResult parse_and_validate_ex(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair = RepairConfig{});
+JsonArray parse_and_validate_all(const std::string& text, const CompiledSchema& schema);
+JsonishParseAllResult parse_and_validate_all_ex(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair = RepairConfig{});
+Json parse_and_validate_with_defaults(const std::string& text, const CompiledSchema& schema);
+JsonishParseResult parse_and_validate_with_defaults_ex(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair = RepairConfig{});
+
+struct FusedValidateConfig {
+  // Skip, without building, members no keyword looks at: not in properties, not named by required or
+  // dependentRequired, additionalProperties allowed, and no combinator/const/enum/if on the object or
+  // above it. They are left out of the returned value.
+  bool drop_unconstrained_properties{false};
+};
+
+// Single-pass parse_and_validate_ex(): the compiled schema drives the parser, so each value is checked as
+// soon as it is complete and the parse stops at the first violation (with several, possibly not the one
+// validate() reports). Wrong-typed objects, arrays and strings and forbidden members are rejected before
+// they are parsed. Repairs apply as usual; a violation seen before a failed strict parse is still reported.
+// Under DuplicateKeyPolicy::LastWins a later duplicate may replace a member, so an object's members are
+// only checked once the object closes.
+JsonishParseResult parse_and_validate_fused(const std::string& text,
+                                            const CompiledSchema& schema,
+                                            const RepairConfig& repair = RepairConfig{},
+                                            const FusedValidateConfig& config = FusedValidateConfig{});
+
+// Non-throwing forms of loads_jsonish_ex()/validate()/parse_and_validate_ex(). Malformed text is detected
+// before anything is built and schema checks stop at the first violation, so a failure costs no stack
+// unwinding; use these when most inputs are expected to be rejected.
+TryResult<Json> try_loads_jsonish(const std::string& text, const RepairConfig& repair = RepairConfig{});
+TryStatus try_validate(const Json& value, const Json& schema, const std::string& path = "$");
+TryStatus try_validate(const Json& value, const CompiledSchema& schema, const std::string& path = "$");
+TryResult<Json> try_parse_and_validate(const std::string& text, const Json& schema, const RepairConfig& repair = RepairConfig{});
+TryResult<Json> try_parse_and_validate(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair = RepairConfig{});
+
+// Schema `pattern` regexes are compiled once per distinct pattern text and shared process-wide.
+// A CompiledSchema resolves its patterns at compile time; Json-schema validation looks them up per call.
+struct RegexCacheStats {
+  size_t hits{0};
+  size_t misses{0};
+  // Patterns compiled with std::regex because the linear-time matcher does not support them.
+  size_t fallbacks{0};
+  size_t size{0};
+};
+
+RegexCacheStats regex_cache_stats();
+void clear_regex_cache();
+
+// Patterns run on a bundled linear-time (Thompson NFA) matcher. Patterns it cannot handle, such as
+// backreferences or lookaround, fall back to backtracking std::regex. Disable the fallback to report
+// them as unsupported instead. Changing the setting clears the regex cache; existing CompiledSchemas keep
+// the matchers they were compiled with.
+void set_pattern_regex_fallback(bool enabled);
+bool pattern_regex_fallback();
+
+// Checks s against a schema "format": email, uuid, date-time, date, time, ipv4, uri or hostname.
+// The same checks back validation and schema inference. Unknown formats always match.
+bool matches_string_format(const std::string& format, const std::string& s);
+
 // ---------------- Validation Repair Suggestions ----------------
 
 // Represents a single repair suggestion for a validation error
@@ -412,8 +1117,14 @@ JsonArray parse_and_validate_yaml_all(const std::string& text, const Json& schem
 // Like parse_and_validate_yaml_all(), but returns per-item fixed text and repair metadata.
 YamlishParseAllResult parse_and_validate_yaml_all_ex(const std::string& text, const Json& schema, const YamlRepairConfig& repair = YamlRepairConfig{});
 
+// Non-throwing forms of loads_yamlish_ex() and parse_and_validate_yaml_ex().
+TryResult<Json> try_loads_yamlish(const std::string& text, const YamlRepairConfig& repair = YamlRepairConfig{});
+TryResult<Json> try_parse_and_validate_yaml(const std::string& text, const Json& schema, const YamlRepairConfig& repair = YamlRepairConfig{});
+
 // Serialize Json value to YAML string.
 std::string dumps_yaml(const Json& value, int indent = 2);
+// Same output, streamed into `sink` (which is flushed at the end).
+void dump_yaml(const Json& value, OutputSink& sink, int indent = 2);
 
 // ---------------- TOML-ish ----------------
 
@@ -482,8 +1193,14 @@ JsonArray parse_and_validate_toml_all(const std::string& text, const Json& schem
 // Like parse_and_validate_toml_all(), but returns per-item fixed text and repair metadata.
 TomlishParseAllResult parse_and_validate_toml_all_ex(const std::string& text, const Json& schema, const TomlRepairConfig& repair = TomlRepairConfig{});
 
+// Non-throwing forms of loads_tomlish_ex() and parse_and_validate_toml_ex().
+TryResult<Json> try_loads_tomlish(const std::string& text, const TomlRepairConfig& repair = TomlRepairConfig{});
+TryResult<Json> try_parse_and_validate_toml(const std::string& text, const Json& schema, const TomlRepairConfig& repair = TomlRepairConfig{});
+
 // Serialize Json value to TOML string.
 std::string dumps_toml(const Json& value);
+// Same output, streamed into `sink` (which is flushed at the end).
+void dump_toml(const Json& value, OutputSink& sink);
 
 // ---------------- XML/HTML-ish ----------------
 
@@ -564,6 +1281,9 @@ Json loads_html_as_json(const std::string& text);
 // Serialize XmlNode tree back to XML/HTML string.
 std::string dumps_xml(const XmlNode& node, int indent = 2);
 std::string dumps_html(const XmlNode& node, int indent = 2);
+// Same output, streamed into `sink` (which is flushed at the end).
+void dump_xml(const XmlNode& node, OutputSink& sink, int indent = 2);
+void dump_html(const XmlNode& node, OutputSink& sink, int indent = 2);
 
 // Query XML nodes using simple XPath-like expressions.
 std::vector<XmlNode*> query_xml(XmlNode& root, const std::string& selector);
@@ -582,6 +1302,11 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
 XmlNode parse_and_validate_xml(const std::string& text, const Json& schema);
 XmlParseResult parse_and_validate_xml_ex(const std::string& text, const Json& schema, const XmlRepairConfig& repair = XmlRepairConfig{});
 
+// Non-throwing forms of loads_xml_ex(), validate_xml() and parse_and_validate_xml_ex().
+TryResult<XmlNode> try_loads_xml(const std::string& text, const XmlRepairConfig& repair = XmlRepairConfig{});
+TryStatus try_validate_xml(const XmlNode& node, const Json& schema, const std::string& path = "$");
+TryResult<XmlNode> try_parse_and_validate_xml(const std::string& text, const Json& schema, const XmlRepairConfig& repair = XmlRepairConfig{});
+
 // ---------------- SQL safety (heuristic) ----------------
 
 struct SqlParsed {
@@ -602,6 +1327,39 @@ SqlParsed parse_sql(const std::string& text);
 void validate_sql(const SqlParsed& parsed, const Json& schema);
 SqlParsed parse_and_validate_sql(const std::string& text, const Json& schema);
 
+// ---------------- Mixed-format blocks ----------------
+
+enum class BlockFormat { Json, Yaml, Toml, Xml, Html, Sql };
+
+// A structured block in an LLM response: text[start, end) is its content (for a fenced block, the body
+// without the fence lines and the line break before the closing fence).
+struct StructuredBlock {
+  BlockFormat format{BlockFormat::Json};
+  std::string lang;  // fence tag as written ("json", "yml", "HTML", ...); empty for bare blocks
+  size_t start{0};
+  size_t end{0};
+  bool fenced{false};
+};
+
+// Every ```json/yaml/yml/toml/xml/html/sql block (jsonc and json5 count as JSON) and every bare {...} / [...]
+// JSON run outside fences, in text order, found in one scan. An untagged ``` fence is searched for bare runs,
+// as extract_json_candidates() does; fences with any other tag are skipped whole. A fence that never closes
+// runs to the end of the text.
+std::vector<StructuredBlock> extract_structured_blocks(const std::string& text);
+
+// A block from parse_structured_blocks(), parsed by its format's parser. JSON, YAML and TOML land in `value`,
+// XML and HTML in `xml`, SQL in `sql`. A block that fails to parse carries the error in its status.
+struct ParsedBlock : TryStatus {
+  StructuredBlock block;
+  Json value;
+  XmlNode xml;
+  SqlParsed sql;
+};
+
+// extract_structured_blocks() followed by each block's parser, without re-extracting from the block text.
+// Never throws for a block that fails to parse.
+std::vector<ParsedBlock> parse_structured_blocks(const std::string& text);
+
 // ---------------- Streaming incremental parsing ----------------
 
 template <typename T>
@@ -618,23 +1376,67 @@ struct StreamLocation {
   int col{1};        // 1-based
 };
 
+// Best-effort view of a JSON document that is still streaming in. Open strings, arrays and objects hold what has
+// arrived so far; a member whose value has not started, or a number or literal still being written, is left out.
+struct PartialJson {
+  Json value;                           // null until the document's opening bracket arrives
+  std::vector<std::string> incomplete;  // paths of the values still open, outermost first ("$", "$.items", "$.items[2]")
+  bool complete{false};                 // the document has closed
+};
+
 class JsonStreamParser {
  public:
   explicit JsonStreamParser(Json schema);
   JsonStreamParser(Json schema, size_t max_buffer_bytes);
+  explicit JsonStreamParser(CompiledSchema schema);
+  JsonStreamParser(CompiledSchema schema, size_t max_buffer_bytes);
+  JsonStreamParser(JsonStreamParser&&) noexcept;
+  JsonStreamParser& operator=(JsonStreamParser&&) noexcept;
+  ~JsonStreamParser();
   void reset();
   void finish();
   void append(const std::string& chunk);
   StreamOutcome<Json> poll();
   StreamLocation location() const;
 
+  // The document poll() is waiting for, as far as it has arrived. Only the bytes appended since the last call
+  // are parsed; the view is neither repaired nor validated until poll() completes, after which it holds poll()'s
+  // value. The reference stays valid until the next poll_partial() or reset().
+  const PartialJson& poll_partial();
+
  private:
-  Json schema_;
+  // Where the scan of buf_ stands between polls, so each poll only looks at bytes appended since the last one.
+  struct Scan {
+    size_t pos{0};         // bytes of buf_ scanned so far
+    size_t line_start{0};  // start of the line holding `pos`
+    int line_match{0};     // chars of the fence marker matched on this line; -1 once the line cannot be one
+    int fence{0};          // 0 none seen, 1 ```json line open, 2 in its body, 3 closed
+    size_t fence_body{0};
+    size_t fence_close{0};
+    size_t fence_root{0};  // the first '{' or '[' in the fence body, or 0 while none has arrived
+    char quote{0};
+    bool escape{false};
+    int obj_depth{0};
+    int arr_depth{0};
+    size_t obj_start{0};
+    size_t obj_end{0};  // one past the first balanced {...}, or 0 while none has closed
+    size_t arr_start{0};
+    size_t arr_end{0};
+  };
+
+  void scan_appended();
+  std::optional<std::string> scanned_candidate() const;
+
+  CompiledSchema schema_;
   std::string buf_;
   size_t max_buffer_bytes_{0};
   bool finished_{false};
   bool done_{false};
+  Scan scan_{};
+  StreamLocation loc_{};
   StreamOutcome<Json> last_{};
+  struct PartialBuilder;
+  std::unique_ptr<PartialBuilder> partial_;  // created by the first poll_partial()
 };
 
 // Collects multiple JSON objects/arrays from a stream.
@@ -646,6 +1448,8 @@ class JsonStreamCollector {
  public:
   explicit JsonStreamCollector(Json item_schema);
   JsonStreamCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items);
+  explicit JsonStreamCollector(CompiledSchema item_schema);
+  JsonStreamCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items);
   void reset();
   void append(const std::string& chunk);
   void close();
@@ -653,7 +1457,7 @@ class JsonStreamCollector {
   StreamLocation location() const;
 
  private:
-  Json schema_;
+  CompiledSchema schema_;
   std::string buf_;
   size_t max_buffer_bytes_{0};
   size_t max_items_{0};
@@ -673,6 +1477,8 @@ class JsonStreamBatchCollector {
  public:
   explicit JsonStreamBatchCollector(Json item_schema);
   JsonStreamBatchCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items);
+  explicit JsonStreamBatchCollector(CompiledSchema item_schema);
+  JsonStreamBatchCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items);
   void reset();
   void append(const std::string& chunk);
   void close();
@@ -680,7 +1486,7 @@ class JsonStreamBatchCollector {
   StreamLocation location() const;
 
  private:
-  Json schema_;
+  CompiledSchema schema_;
   std::string buf_;
   size_t max_buffer_bytes_{0};
   size_t max_items_{0};
@@ -695,6 +1501,8 @@ class JsonStreamValidatedBatchCollector {
  public:
   explicit JsonStreamValidatedBatchCollector(Json item_schema);
   JsonStreamValidatedBatchCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items);
+  explicit JsonStreamValidatedBatchCollector(CompiledSchema item_schema);
+  JsonStreamValidatedBatchCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items);
   void reset();
   void append(const std::string& chunk);
   void close();
@@ -702,7 +1510,7 @@ class JsonStreamValidatedBatchCollector {
   StreamLocation location() const;
 
  private:
-  Json schema_;
+  CompiledSchema schema_;
   std::string buf_;
   size_t max_buffer_bytes_{0};
   size_t max_items_{0};
@@ -789,3 +1597,8 @@ class SqlStreamParser {
 };
 
 }  // namespace llm_structured
+
+template <>
+struct std::hash<llm_structured::Json> {
+  size_t operator()(const llm_structured::Json& value) const { return llm_structured::hash(value); }
+};
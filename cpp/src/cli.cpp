@@ -26,6 +26,14 @@ static Json load_json_file(const std::string& path) {
   return loads_jsonish(text);
 }
 
+// Streams straight to stdout instead of building the whole document first.
+static void print_json(const Json& value) {
+  OutputSink out(std::cout);
+  dump_json(value, out);
+  out += '\n';
+  out.flush();
+}
+
 static void usage() {
   std::cerr
       << "llm_structured_cli <json|markdown|kv|sql> [--schema <schema.json>] [--input <file>]\n"
@@ -62,7 +70,7 @@ int main(int argc, char** argv) {
 
     if (mode == "json") {
       Json v = has_schema ? parse_and_validate(input, schema) : loads_jsonish(input);
-      std::cout << dumps_json(v) << "\n";
+      print_json(v);
       return 0;
     }
 
@@ -75,13 +83,13 @@ int main(int argc, char** argv) {
         o["codeBlockCount"] = static_cast<int64_t>(p.codeBlocks.size());
         o["tableCount"] = static_cast<int64_t>(p.tables.size());
         o["taskCount"] = static_cast<int64_t>(p.taskLineNumbers.size());
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       } else {
         auto p = parse_and_validate_markdown(input, schema);
         JsonObject o;
         o["ok"] = true;
         o["headingCount"] = static_cast<int64_t>(p.headings.size());
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       }
       return 0;
     }
@@ -91,13 +99,13 @@ int main(int argc, char** argv) {
         auto kv = loads_kv(input);
         JsonObject o;
         for (const auto& it : kv) o[it.first] = it.second;
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       } else {
         auto kv = parse_and_validate_kv(input, schema);
         JsonObject o;
         o["ok"] = true;
         o["keys"] = static_cast<int64_t>(kv.size());
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       }
       return 0;
     }
@@ -113,13 +121,13 @@ int main(int argc, char** argv) {
         JsonArray tables;
         for (const auto& t : p.tables) tables.push_back(t);
         o["tables"] = tables;
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       } else {
         auto p = parse_and_validate_sql(input, schema);
         JsonObject o;
         o["ok"] = true;
         o["statementType"] = p.statementType;
-        std::cout << dumps_json(Json(o)) << "\n";
+        print_json(Json(o));
       }
       return 0;
     }
@@ -130,7 +138,7 @@ int main(int argc, char** argv) {
     JsonObject o;
     o["error"] = std::string(e.what());
     o["path"] = e.path;
-    std::cout << dumps_json(Json(o)) << "\n";
+    print_json(Json(o));
     return 1;
   } catch (const std::exception& e) {
     std::cerr << "error: " << e.what() << "\n";
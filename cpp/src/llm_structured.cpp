@@ -1,14 +1,35 @@
 #include "llm_structured.hpp"
 
 #include <algorithm>
+#include <bitset>
 #include <cctype>
+#include <cerrno>
 #include <charconv>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <regex>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+// SIMD kernels for ByteScanner; define LLM_STRUCTURED_NO_SIMD to build with the portable table lookup only.
+#if !defined(LLM_STRUCTURED_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define LLM_STRUCTURED_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LLM_STRUCTURED_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 namespace llm_structured {
 
@@ -16,13 +37,18 @@ namespace llm_structured {
 
 bool Json::is_null() const { return std::holds_alternative<std::nullptr_t>(value); }
 bool Json::is_bool() const { return std::holds_alternative<bool>(value); }
-bool Json::is_number() const { return std::holds_alternative<double>(value); }
+bool Json::is_number() const { return std::holds_alternative<double>(value) || std::holds_alternative<int64_t>(value); }
+bool Json::is_int64() const { return std::holds_alternative<int64_t>(value); }
 bool Json::is_string() const { return std::holds_alternative<std::string>(value); }
 bool Json::is_array() const { return std::holds_alternative<JsonArray>(value); }
 bool Json::is_object() const { return std::holds_alternative<JsonObject>(value); }
 
 const bool& Json::as_bool() const { return std::get<bool>(value); }
-const double& Json::as_number() const { return std::get<double>(value); }
+double Json::as_number() const {
+  if (const auto* i = std::get_if<int64_t>(&value)) return static_cast<double>(*i);
+  return std::get<double>(value);
+}
+int64_t Json::as_int64() const { return std::get<int64_t>(value); }
 const std::string& Json::as_string() const { return std::get<std::string>(value); }
 const JsonArray& Json::as_array() const { return std::get<JsonArray>(value); }
 const JsonObject& Json::as_object() const { return std::get<JsonObject>(value); }
@@ -58,10 +84,140 @@ static std::vector<std::string> split_lines(const std::string& text) {
   return lines;
 }
 
-static std::string json_escape(const std::string& s) {
-  std::string out;
-  out.reserve(s.size() + 8);
-  for (char c : s) {
+// ---------------- Byte scanning ----------------
+
+// Extractors hop between the few bytes they care about (brackets, quotes, backticks, newlines) with a
+// ByteScanner instead of stepping through prose one character at a time. The search compares 64-byte blocks
+// with AVX2 or 16-byte blocks with SSE2, chosen once at runtime, and uses a lookup table elsewhere.
+
+using FindAnyFn = size_t (*)(const unsigned char* p, size_t n, const unsigned char* needles, size_t count,
+                             const bool* table);
+
+static size_t find_any_scalar(const unsigned char* p, size_t n, const unsigned char*, size_t, const bool* table) {
+  size_t i = 0;
+  while (i < n && !table[p[i]]) ++i;
+  return i;
+}
+
+#if defined(LLM_STRUCTURED_SSE2)
+static unsigned lowest_set_bit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long idx;
+  _BitScanForward(&idx, mask);
+  return static_cast<unsigned>(idx);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+static size_t find_any_sse2(const unsigned char* p, size_t n, const unsigned char* needles, size_t count,
+                            const bool* table) {
+  __m128i want[8];
+  for (size_t k = 0; k < count; ++k) want[k] = _mm_set1_epi8(static_cast<char>(needles[k]));
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    __m128i hit = _mm_cmpeq_epi8(block, want[0]);
+    for (size_t k = 1; k < count; ++k) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, want[k]));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+    if (mask != 0) return i + lowest_set_bit(mask);
+  }
+  return i + find_any_scalar(p + i, n - i, needles, count, table);
+}
+#endif
+
+#if defined(LLM_STRUCTURED_AVX2)
+__attribute__((target("avx2"))) static size_t find_any_avx2(const unsigned char* p, size_t n,
+                                                              const unsigned char* needles, size_t count,
+                                                              const bool* table) {
+  __m256i want[8];
+  for (size_t k = 0; k < count; ++k) want[k] = _mm256_set1_epi8(static_cast<char>(needles[k]));
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32));
+    __m256i hit_lo = _mm256_cmpeq_epi8(lo, want[0]);
+    __m256i hit_hi = _mm256_cmpeq_epi8(hi, want[0]);
+    for (size_t k = 1; k < count; ++k) {
+      hit_lo = _mm256_or_si256(hit_lo, _mm256_cmpeq_epi8(lo, want[k]));
+      hit_hi = _mm256_or_si256(hit_hi, _mm256_cmpeq_epi8(hi, want[k]));
+    }
+    const uint64_t mask = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit_lo))) |
+                          (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit_hi))) << 32);
+    if (mask != 0) return i + static_cast<size_t>(__builtin_ctzll(mask));
+  }
+  if (i + 32 <= n) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    __m256i hit = _mm256_cmpeq_epi8(block, want[0]);
+    for (size_t k = 1; k < count; ++k) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(block, want[k]));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+    if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+    i += 32;
+  }
+  // Not the SSE2 kernel: mixing legacy SSE encodings into AVX code costs more than the short tail.
+  return i + find_any_scalar(p + i, n - i, needles, count, table);
+}
+#endif
+
+#if defined(LLM_STRUCTURED_SSE2)
+static FindAnyFn select_find_any() {
+#if defined(LLM_STRUCTURED_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return find_any_avx2;
+#endif
+  return find_any_sse2;
+}
+#endif
+
+// A set of up to 8 bytes to search text for.
+class ByteScanner {
+ public:
+  static constexpr size_t npos = std::string::npos;
+
+  explicit ByteScanner(std::string_view bytes) : count_(std::min(bytes.size(), sizeof(needles_))) {
+    for (size_t k = 0; k < count_; ++k) {
+      needles_[k] = static_cast<unsigned char>(bytes[k]);
+      table_[needles_[k]] = true;
+    }
+  }
+
+  // Offset of the first byte from the set at or after `from`, or npos.
+  size_t find(std::string_view text, size_t from) const {
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t n = text.size();
+    // Structural bytes are often close together; only hand longer gaps to the block search.
+    for (const size_t stop = std::min(n, from + 8); from < stop; ++from) {
+      if (table_[p[from]]) return from;
+    }
+    if (from >= n) return npos;
+    if (count_ == 1) {
+      const void* hit = std::memchr(p + from, needles_[0], n - from);
+      return hit ? static_cast<size_t>(static_cast<const unsigned char*>(hit) - p) : npos;
+    }
+#if defined(LLM_STRUCTURED_SSE2)
+    static const FindAnyFn find_any = select_find_any();
+#else
+    constexpr FindAnyFn find_any = find_any_scalar;
+#endif
+    const size_t hit = from + find_any(p + from, n - from, needles_, count_, table_);
+    return hit < n ? hit : npos;
+  }
+
+ private:
+  unsigned char needles_[8]{};
+  size_t count_;
+  bool table_[256]{};
+};
+
+// Appends the JSON escape of `s`, copying runs that need no escaping in one go.
+static void append_json_escaped(std::string& out, std::string_view s) {
+  static const char kHex[] = "0123456789abcdef";
+  size_t run = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') continue;
+    out.append(s.data() + run, i - run);
+    run = i + 1;
     switch (c) {
       case '\\': out += "\\\\"; break;
       case '"': out += "\\\""; break;
@@ -70,21 +226,13 @@ static std::string json_escape(const std::string& s) {
       case '\n': out += "\\n"; break;
       case '\r': out += "\\r"; break;
       case '\t': out += "\\t"; break;
-      default:
-        if (static_cast<unsigned char>(c) < 0x20) {
-          std::ostringstream oss;
-          oss << "\\u";
-          oss.setf(std::ios::hex, std::ios::basefield);
-          oss.width(4);
-          oss.fill('0');
-          oss << (static_cast<int>(static_cast<unsigned char>(c)));
-          out += oss.str();
-        } else {
-          out.push_back(c);
-        }
+      default: {
+        const char u[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+        out.append(u, sizeof(u));
+      }
     }
   }
-  return out;
+  out.append(s.data() + run, s.size() - run);
 }
 
 static std::string json_pointer_escape(const std::string& seg) {
@@ -146,256 +294,225 @@ std::string json_pointer_from_path(const std::string& json_path) {
   return out;
 }
 
-std::string dumps_json(const Json& value) {
-  if (value.is_null()) return "null";
-  if (value.is_bool()) return value.as_bool() ? "true" : "false";
-  if (value.is_number()) {
-    double n = value.as_number();
-    if (std::isfinite(n)) {
-      // Prefer integer formatting when exact.
-      double intpart;
-      if (std::modf(n, &intpart) == 0.0) {
-        std::ostringstream oss;
-        oss.setf(std::ios::fixed);
-        oss.precision(0);
-        oss << n;
-        return oss.str();
-      }
-      std::ostringstream oss;
-      oss.precision(15);
-      oss << n;
-      return oss.str();
-    }
-    return "null";
-  }
-  if (value.is_string()) return "\"" + json_escape(value.as_string()) + "\"";
-  if (value.is_array()) {
-    std::string out = "[";
-    const auto& arr = value.as_array();
-    for (size_t i = 0; i < arr.size(); ++i) {
-      if (i) out += ",";
-      out += dumps_json(arr[i]);
-    }
-    out += "]";
-    return out;
-  }
-  const auto& obj = value.as_object();
-  std::string out = "{";
-  bool first = true;
-  for (const auto& kv : obj) {
-    if (!first) out += ",";
-    first = false;
-    out += "\"" + json_escape(kv.first) + "\":" + dumps_json(kv.second);
-  }
-  out += "}";
-  return out;
+JsonWriter& JsonWriter::write_string(std::string_view s) {
+  out_->push_back('"');
+  append_json_escaped(*out_, s);
+  out_->push_back('"');
+  return *this;
 }
 
-// ---------------- JSON parser (tolerant pre-fix + strict-ish parse) ----------------
-
-static std::string fix_smart_quotes(std::string s) {
-  // Replace common Unicode “ ” ‘ ’ with ASCII quotes.
-  auto rep = [&](const std::string& from, const std::string& to) {
-    size_t pos = 0;
-    while ((pos = s.find(from, pos)) != std::string::npos) {
-      s.replace(pos, from.size(), to);
-      pos += to.size();
-    }
-  };
-  rep("\xE2\x80\x9C", "\"");
-  rep("\xE2\x80\x9D", "\"");
-  rep("\xE2\x80\x98", "'");
-  rep("\xE2\x80\x99", "'");
-  return s;
+JsonWriter& JsonWriter::write_number(int64_t n) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), n);
+  out_->append(buf, res.ptr);
+  return *this;
 }
 
-static std::string strip_json_comments(const std::string& s) {
-  // Removes //... and /*...*/ outside string literals.
-  std::string out;
-  out.reserve(s.size());
-
-  bool in_str = false;
-  char quote = 0;
-  bool escape = false;
-  bool in_line = false;
-  bool in_block = false;
+JsonWriter& JsonWriter::write_number(double n) {
+  if (!std::isfinite(n)) {
+    out_->append("null");
+    return *this;
+  }
+  char buf[32];
+  // Whole numbers below 2^53 print in fixed notation ("1000000", not "1e+06"), as they always have; every other
+  // value takes the shortest round-trip form.
+  const bool whole = std::fabs(n) < 9007199254740992.0 && std::trunc(n) == n;
+  auto res = whole ? std::to_chars(buf, buf + sizeof(buf), n, std::chars_format::fixed)
+                   : std::to_chars(buf, buf + sizeof(buf), n);
+  out_->append(buf, res.ptr);
+  return *this;
+}
 
-  for (size_t i = 0; i < s.size(); ++i) {
-    char c = s[i];
-    char n = (i + 1 < s.size()) ? s[i + 1] : '\0';
+// ---------------- Output sinks ----------------
 
-    if (in_line) {
-      if (c == '\n') {
-        in_line = false;
-        out.push_back(c);
-      }
-      continue;
-    }
-    if (in_block) {
-      if (c == '*' && n == '/') {
-        in_block = false;
-        ++i;
-      }
-      continue;
-    }
+OutputSink::OutputSink(std::string& out) : buf_(&out), base_(out.size()), limit_(std::numeric_limits<size_t>::max()) {}
 
-    if (in_str) {
-      out.push_back(c);
-      if (escape) {
-        escape = false;
-      } else if (c == '\\') {
-        escape = true;
-      } else if (c == quote) {
-        in_str = false;
-        quote = 0;
-      }
-      continue;
-    }
+OutputSink::OutputSink(std::ostream& os, size_t buffer_size)
+    : OutputSink(
+          [&os](std::string_view chunk) {
+            os.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            if (!os) throw std::runtime_error("output stream write failed");
+          },
+          buffer_size) {}
 
-    if (c == '"' || c == '\'') {
-      in_str = true;
-      quote = c;
-      out.push_back(c);
-      continue;
-    }
+OutputSink::OutputSink(std::FILE* file, size_t buffer_size)
+    : OutputSink(
+          [file](std::string_view chunk) {
+            if (std::fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size()) throw std::runtime_error("fwrite failed");
+          },
+          buffer_size) {}
 
-    if (c == '/' && n == '/') {
-      in_line = true;
-      ++i;
-      continue;
-    }
-    if (c == '/' && n == '*') {
-      in_block = true;
-      ++i;
-      continue;
-    }
+OutputSink::OutputSink(FlushFn flush, size_t buffer_size)
+    : buf_(&own_), limit_(std::max<size_t>(buffer_size, 1)), flush_(std::move(flush)) {
+  own_.reserve(limit_);
+}
 
-    out.push_back(c);
+OutputSink::~OutputSink() {
+  try {
+    flush();
+  } catch (...) {
+    // Destructors can't report; callers who care call flush() themselves.
   }
-  return out;
 }
 
-static std::string replace_python_literals(const std::string& s) {
-  // Best-effort: True/False/None -> true/false/null outside strings.
-  std::string out;
-  out.reserve(s.size());
-  bool in_str = false;
-  char quote = 0;
-  bool escape = false;
+void OutputSink::flush() {
+  if (!flush_ || own_.empty()) return;
+  flush_(own_);
+  flushed_ += own_.size();
+  own_.clear();
+}
 
-  auto is_ident_char = [](char c) {
-    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
-  };
+void JsonWriter::newline(int depth) {
+  out_->push_back('\n');
+  out_->append(static_cast<size_t>(depth) * static_cast<size_t>(indent_), ' ');
+}
 
-  for (size_t i = 0; i < s.size();) {
-    char c = s[i];
-    if (in_str) {
-      out.push_back(c);
-      if (escape) {
-        escape = false;
-      } else if (c == '\\') {
-        escape = true;
-      } else if (c == quote) {
-        in_str = false;
-        quote = 0;
-      }
-      ++i;
-      continue;
-    }
+JsonWriter& JsonWriter::write(const Json& value) {
+  write_value(value, 0);
+  return *this;
+}
 
-    if (c == '"' || c == '\'') {
-      in_str = true;
-      quote = c;
-      out.push_back(c);
-      ++i;
-      continue;
+void JsonWriter::write_value(const Json& value, int depth) {
+  std::string& out = *out_;
+  // A sink's buffer is handed on between elements once full, so nesting never holds it past its limit.
+  auto element_done = [&] {
+    if (sink_ && out.size() >= sink_->limit_) sink_->flush();
+  };
+  if (value.is_null()) {
+    out.append("null");
+  } else if (value.is_bool()) {
+    out.append(value.as_bool() ? "true" : "false");
+  } else if (value.is_int64()) {
+    write_number(value.as_int64());
+  } else if (value.is_number()) {
+    write_number(value.as_number());
+  } else if (value.is_string()) {
+    write_string(value.as_string());
+  } else if (value.is_array()) {
+    const auto& arr = value.as_array();
+    out.push_back('[');
+    bool first = true;
+    for (const auto& v : arr) {
+      if (!first) out.push_back(',');
+      first = false;
+      if (indent_ > 0) newline(depth + 1);
+      write_value(v, depth + 1);
+      element_done();
     }
-
-    if ((c == 'T' || c == 'F' || c == 'N') && (i == 0 || !is_ident_char(s[i - 1]))) {
-      if (s.compare(i, 4, "True") == 0 && (i + 4 >= s.size() || !is_ident_char(s[i + 4]))) {
-        out += "true";
-        i += 4;
-        continue;
-      }
-      if (s.compare(i, 5, "False") == 0 && (i + 5 >= s.size() || !is_ident_char(s[i + 5]))) {
-        out += "false";
-        i += 5;
-        continue;
-      }
-      if (s.compare(i, 4, "None") == 0 && (i + 4 >= s.size() || !is_ident_char(s[i + 4]))) {
-        out += "null";
-        i += 4;
-        continue;
-      }
+    if (indent_ > 0 && !arr.empty()) newline(depth);
+    out.push_back(']');
+  } else {
+    const auto& obj = value.as_object();
+    out.push_back('{');
+    bool first = true;
+    for (const auto& kv : obj) {
+      if (!first) out.push_back(',');
+      first = false;
+      if (indent_ > 0) newline(depth + 1);
+      write_string(kv.first);
+      out.append(indent_ > 0 ? ": " : ":");
+      write_value(kv.second, depth + 1);
+      element_done();
     }
-
-    out.push_back(c);
-    ++i;
+    if (indent_ > 0 && !obj.empty()) newline(depth);
+    out.push_back('}');
   }
-  return out;
 }
 
-static std::string quote_unquoted_keys(const std::string& s) {
-  // Best-effort: { foo: 1 } -> {"foo": 1} (outside strings)
+std::string dumps_json(const Json& value) {
   std::string out;
-  out.reserve(s.size() + 8);
+  JsonWriter(out).write(value);
+  return out;
+}
 
-  bool in_str = false;
-  char quote = 0;
-  bool escape = false;
+void dump_json(const Json& value, OutputSink& sink, int indent) {
+  JsonWriter(sink, indent).write(value);
+  sink.flush();
+}
 
-  auto is_ident_start = [](char c) {
-    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
-  };
-  auto is_ident = [](char c) {
-    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
-  };
+// Exact comparison of two numbers: an int64 equals a double only if the double is that integer.
+static bool json_number_equals(const Json& a, const Json& b) {
+  if (a.is_int64() && b.is_int64()) return a.as_int64() == b.as_int64();
+  if (!a.is_int64() && !b.is_int64()) return a.as_number() == b.as_number();
+  const int64_t i = a.is_int64() ? a.as_int64() : b.as_int64();
+  const double d = a.is_int64() ? b.as_number() : a.as_number();
+  if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != std::trunc(d)) return false;
+  return static_cast<int64_t>(d) == i;
+}
 
-  for (size_t i = 0; i < s.size();) {
-    char c = s[i];
-    if (in_str) {
-      out.push_back(c);
-      if (escape) {
-        escape = false;
-      } else if (c == '\\') {
-        escape = true;
-      } else if (c == quote) {
-        in_str = false;
-        quote = 0;
-      }
-      ++i;
-      continue;
-    }
+bool operator==(const Json& a, const Json& b) {
+  if (a.is_number() && b.is_number()) return json_number_equals(a, b);
+  if (a.value.index() != b.value.index()) return false;
+  if (a.is_null()) return true;
+  if (a.is_bool()) return a.as_bool() == b.as_bool();
+  if (a.is_string()) return a.as_string() == b.as_string();
+  if (a.is_array()) return a.as_array() == b.as_array();
+  const auto& ao = a.as_object();
+  const auto& bo = b.as_object();
+  if (ao.size() != bo.size()) return false;
+  for (const auto& kv : ao) {
+    auto it = bo.find(kv.first);
+    if (it == bo.end() || it->second != kv.second) return false;
+  }
+  return true;
+}
 
-    if (c == '"' || c == '\'') {
-      in_str = true;
-      quote = c;
-      out.push_back(c);
-      ++i;
-      continue;
-    }
+// splitmix64 finalizer.
+static uint64_t hash_mix(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
 
-    if (is_ident_start(c)) {
-      size_t start = i;
-      size_t j = i;
-      while (j < s.size() && is_ident(s[j])) ++j;
-      size_t k = j;
-      while (k < s.size() && std::isspace(static_cast<unsigned char>(s[k]))) ++k;
-      if (k < s.size() && s[k] == ':') {
-        out.push_back('"');
-        out.append(s, start, j - start);
-        out.push_back('"');
-        i = j;
-        continue;
-      }
-    }
+static uint64_t hash_bytes(std::string_view s) {
+  uint64_t h = 0xcbf29ce484222325ULL;  // FNV-1a
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
 
-    out.push_back(c);
-    ++i;
+static uint64_t hash_json(const Json& value) {
+  if (value.is_null()) return hash_mix(1);
+  if (value.is_bool()) return hash_mix(value.as_bool() ? 2 : 3);
+  if (value.is_int64()) return hash_mix(4 ^ hash_mix(static_cast<uint64_t>(value.as_int64())));
+  if (value.is_number()) {
+    // Integral doubles hash like the int64 they equal (-0.0 included).
+    const double d = value.as_number();
+    if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == std::trunc(d)) {
+      return hash_mix(4 ^ hash_mix(static_cast<uint64_t>(static_cast<int64_t>(d))));
+    }
+    uint64_t bits = 0;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return hash_mix(5 ^ hash_mix(bits));
   }
-  return out;
+  if (value.is_string()) return hash_mix(6 ^ hash_bytes(value.as_string()));
+  if (value.is_array()) {
+    uint64_t h = hash_mix(7);
+    for (const auto& v : value.as_array()) h = hash_mix(h ^ hash_json(v));
+    return h;
+  }
+  // Members are summed so that member order doesn't matter.
+  uint64_t sum = 0;
+  for (const auto& kv : value.as_object()) sum += hash_mix(hash_bytes(kv.first) ^ hash_mix(hash_json(kv.second) + 1));
+  return hash_mix(8 ^ sum);
 }
 
+size_t hash(const Json& value) { return static_cast<size_t>(hash_json(value)); }
+
+// For sets of values held by pointer (e.g. into a schema).
+struct JsonPtrHash {
+  size_t operator()(const Json* v) const { return hash(*v); }
+};
+struct JsonPtrEqual {
+  bool operator()(const Json* a, const Json* b) const { return *a == *b; }
+};
+
+// ---------------- JSON parser (tolerant pre-fix + strict-ish parse) ----------------
+
 static std::optional<std::string> try_kv_object_to_json(const std::string& s) {
   // If the candidate looks like key=value lines (and not like JSON), convert to JSON object.
   if (s.find('{') != std::string::npos || s.find('[') != std::string::npos) return std::nullopt;
@@ -442,55 +559,283 @@ static std::optional<std::string> try_kv_object_to_json(const std::string& s) {
   return dumps_json(Json(obj));
 }
 
-static std::string drop_trailing_commas(const std::string& s) {
-  // Remove commas immediately before } or ] (ignoring whitespace), while skipping string literals.
+// Reads a candidate as the repair passes see it: smart quotes mapped to ASCII and comments outside
+// string literals removed. Characters are produced on demand so the scanner can peek ahead.
+class RepairSource {
+ public:
+  RepairSource(const std::string& s, bool smart_quotes, bool comments)
+      : s_(s), smart_quotes_(smart_quotes), comments_(comments) {}
+
+  // Character `k` positions past the cursor, or -1 past the end.
+  int peek(size_t k = 0) {
+    while (head_ + k >= buf_.size()) {
+      if (!produce()) return -1;
+    }
+    return static_cast<unsigned char>(buf_[head_ + k]);
+  }
+
+  // Consumes `n` characters that have already been peeked.
+  void skip(size_t n = 1) {
+    head_ += n;
+    if (head_ == buf_.size()) {
+      buf_.clear();
+      head_ = 0;
+    }
+  }
+
+  bool fixed_smart_quotes() const { return fixed_smart_quotes_; }
+  bool stripped_comments() const { return stripped_comments_; }
+
+ private:
+  static bool is_repair_special(char c) {
+    return c == '"' || c == '\'' || c == '\\' || c == '/' || static_cast<unsigned char>(c) == 0xE2;
+  }
+
+  char read(size_t at, size_t* width) {
+    *width = 1;
+    char c = s_[at];
+    if (smart_quotes_ && static_cast<unsigned char>(c) == 0xE2 && at + 2 < s_.size() &&
+        static_cast<unsigned char>(s_[at + 1]) == 0x80) {
+      unsigned char d = static_cast<unsigned char>(s_[at + 2]);
+      if (d == 0x9C || d == 0x9D || d == 0x98 || d == 0x99) {
+        *width = 3;
+        fixed_smart_quotes_ = true;
+        return (d == 0x9C || d == 0x9D) ? '"' : '\'';
+      }
+    }
+    return c;
+  }
+
+  bool produce() {
+    size_t w = 1;
+    while (i_ < s_.size()) {
+      char c = read(i_, &w);
+      if (in_str_) {
+        if (escape_) {
+          escape_ = false;
+        } else if (c == '\\') {
+          escape_ = true;
+        } else if (c == quote_) {
+          in_str_ = false;
+        }
+      } else if (c == '"' || c == '\'') {
+        in_str_ = true;
+        quote_ = c;
+      } else if (c == '/' && comments_ && i_ + 1 < s_.size() && (s_[i_ + 1] == '/' || s_[i_ + 1] == '*')) {
+        stripped_comments_ = true;
+        bool line = s_[i_ + 1] == '/';
+        i_ += 2;
+        // Skipped text still counts towards fixed_smart_quotes, as it did when quotes were fixed first.
+        while (i_ < s_.size()) {
+          if (line ? s_[i_] == '\n' : (s_[i_] == '*' && i_ + 1 < s_.size() && s_[i_ + 1] == '/')) break;
+          read(i_, &w);
+          i_ += w;
+        }
+        if (!line && i_ < s_.size()) i_ += 2;
+        continue;
+      }
+      buf_.push_back(c);
+      i_ += w;
+      // Characters that cannot change the string or comment state are copied as one run.
+      size_t run = i_;
+      while (!escape_ && run < s_.size() && !is_repair_special(s_[run])) ++run;
+      buf_.append(s_, i_, run - i_);
+      i_ = run;
+      return true;
+    }
+    return false;
+  }
+
+  const std::string& s_;
+  bool smart_quotes_;
+  bool comments_;
+  size_t i_{0};
+  bool in_str_{false};
+  char quote_{0};
+  bool escape_{false};
+  std::string buf_;
+  size_t head_{0};
+  bool fixed_smart_quotes_{false};
+  bool stripped_comments_{false};
+};
+
+// Applies the enabled text repairs in one left-to-right scan: smart quotes, comments, Python literals,
+// key=value lines, unquoted keys and trailing commas. The result matches running them one after another
+// in that order; `meta` records which of them changed the text.
+static std::string repair_jsonish_text(const std::string& s, const RepairConfig& repair, RepairMetadata& meta) {
+  RepairSource src(s, repair.fix_smart_quotes, repair.strip_json_comments);
   std::string out;
-  out.reserve(s.size());
+  out.reserve(s.size() + 8);
+
+  auto is_space = [](int c) { return c >= 0 && std::isspace(c); };
+  auto is_ident = [](int c) { return c >= 0 && (std::isalnum(c) || c == '_'); };
+  auto is_ident_start = [](int c) { return c >= 0 && (std::isalpha(c) || c == '_'); };
+  auto word_at = [&](const char* word, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+      if (src.peek(k) != word[k]) return false;
+    }
+    return !is_ident(src.peek(n));
+  };
+
   bool in_str = false;
   char quote = 0;
   bool escape = false;
+  int prev = -1;          // previous character of the comment-free text
+  size_t not_key = 0;     // rest of an identifier already known not to be followed by ':'
+  bool replaced_literals = false;
+  bool quoted_keys = false;
+  bool dropped_commas = false;
 
-  for (size_t i = 0; i < s.size(); ++i) {
-    char c = s[i];
+  for (int c; (c = src.peek()) >= 0;) {
     if (in_str) {
-      out.push_back(c);
+      out.push_back(static_cast<char>(c));
+      src.skip();
       if (escape) {
         escape = false;
       } else if (c == '\\') {
         escape = true;
       } else if (c == quote) {
         in_str = false;
-        quote = 0;
       }
+      prev = c;
       continue;
     }
 
     if (c == '"' || c == '\'') {
       in_str = true;
-      quote = c;
-      out.push_back(c);
+      quote = static_cast<char>(c);
+      out.push_back(quote);
+      src.skip();
+      prev = c;
       continue;
     }
 
-    if (c == ',') {
-      size_t j = i + 1;
-      while (j < s.size() && std::isspace(static_cast<unsigned char>(s[j]))) ++j;
-      if (j < s.size() && (s[j] == '}' || s[j] == ']')) {
-        continue;  // drop
+    if (c == ',' && repair.drop_trailing_commas) {
+      size_t k = 1;
+      while (is_space(src.peek(k))) ++k;
+      int n = src.peek(k);
+      if (n == '}' || n == ']') {
+        dropped_commas = true;
+        src.skip();
+        prev = c;
+        continue;
+      }
+    }
+
+    size_t key_len = 0;
+    if (not_key == 0 && repair.quote_unquoted_keys && is_ident_start(c)) {
+      size_t j = 1;
+      while (is_ident(src.peek(j))) ++j;
+      size_t k = j;
+      while (is_space(src.peek(k))) ++k;
+      if (src.peek(k) == ':') {
+        key_len = j;
+        quoted_keys = true;
+        out.push_back('"');
+      } else {
+        not_key = j;
       }
     }
 
-    out.push_back(c);
+    const char* literal = nullptr;
+    size_t consumed = 1;
+    if (repair.replace_python_literals && (c == 'T' || c == 'F' || c == 'N') && !is_ident(prev)) {
+      if (word_at("True", 4)) {
+        literal = "true";
+        consumed = 4;
+      } else if (word_at("False", 5)) {
+        literal = "false";
+        consumed = 5;
+      } else if (word_at("None", 4)) {
+        literal = "null";
+        consumed = 4;
+      }
+    }
+    if (literal) {
+      replaced_literals = true;
+      out.append(literal, consumed);
+      src.skip(consumed);
+      prev = 'e';
+    } else {
+      out.push_back(static_cast<char>(c));
+      src.skip();
+      prev = c;
+    }
+    not_key = not_key > consumed ? not_key - consumed : 0;
+
+    if (key_len) {
+      for (size_t k = consumed; k < key_len; ++k) {
+        prev = src.peek();
+        out.push_back(static_cast<char>(prev));
+        src.skip();
+      }
+      out.push_back('"');
+    }
+  }
+
+  meta.fixed_smart_quotes = src.fixed_smart_quotes();
+  meta.stripped_comments = src.stripped_comments();
+  meta.replaced_python_literals = replaced_literals;
+  meta.quoted_unquoted_keys = quoted_keys;
+  meta.dropped_trailing_commas = dropped_commas;
+
+  // key=value lines only apply to candidates without any JSON structure. The later repairs never add or
+  // remove '{', '[' or '=', so the check can use the final text.
+  if (repair.convert_kv_object_to_json && out.find('{') == std::string::npos && out.find('[') == std::string::npos &&
+      out.find('=') != std::string::npos) {
+    std::optional<std::string> converted;
+    if (quoted_keys || dropped_commas) {
+      RepairConfig before_kv = repair;
+      before_kv.quote_unquoted_keys = false;
+      before_kv.drop_trailing_commas = false;
+      before_kv.convert_kv_object_to_json = false;
+      RepairMetadata ignored;
+      converted = try_kv_object_to_json(repair_jsonish_text(s, before_kv, ignored));
+    } else {
+      converted = try_kv_object_to_json(out);
+    }
+    if (converted) {
+      meta.converted_kv_object = true;
+      meta.quoted_unquoted_keys = false;
+      meta.dropped_trailing_commas = false;
+      return *converted;
+    }
   }
   return out;
 }
 
+// Converts a number token scanned by Parser to the same double strtod would, without copying it.
+static double parse_number_token(const char* first, const char* last) {
+  double v = 0.0;
+  auto res = std::from_chars(first, last, v);
+  if (res.ec == std::errc::result_out_of_range) {
+    // from_chars reports overflow/underflow instead of returning +-inf or a denormal/zero like strtod.
+    return std::strtod(std::string(first, last).c_str(), nullptr);
+  }
+  return v;
+}
+
+// The character `\<e>` stands for inside a string literal. Unknown escapes keep the escaped character.
+static char unescape_json_char(char e) {
+  switch (e) {
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    default: return e;
+  }
+}
+
 struct Parser {
   const std::string& s;
   size_t i{0};
   bool allow_single_quotes{true};
   RepairConfig::DuplicateKeyPolicy duplicate_key_policy{RepairConfig::DuplicateKeyPolicy::FirstWins};
   int* duplicate_key_count{nullptr};
+  // When set under DuplicateKeyPolicy::Error, scan_value() also looks for duplicate keys and stops at the
+  // first, recording it here, where parse_value() would throw DuplicateKeyError.
+  std::optional<std::string>* first_duplicate_key{nullptr};
 
   explicit Parser(const std::string& in,
                   bool allow_single_quotes_,
@@ -534,7 +879,7 @@ struct Parser {
     if (c == 't') return parse_true();
     if (c == 'f') return parse_false();
     if (c == 'n') return parse_null();
-    if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) return Json(parse_number());
+    if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) return parse_number();
     fail(std::string("unexpected char '") + c + "'");
     return Json();
   }
@@ -571,7 +916,7 @@ struct Parser {
       if (consume('}')) break;
       if (!consume(',')) fail("expected , or }");
     }
-    return Json(obj);
+    return Json(std::move(obj));
   }
 
   Json parse_array() {
@@ -586,63 +931,152 @@ struct Parser {
       if (consume(']')) break;
       if (!consume(',')) fail("expected , or ]");
     }
-    return Json(arr);
+    return Json(std::move(arr));
   }
 
   std::string parse_string() {
-    skip_ws();
-    if (i >= s.size()) fail("expected string");
-    char q = s[i];
-    if (q != '"' && q != '\'') fail("expected quote");
-    if (q == '\'' && !allow_single_quotes) fail("single-quoted strings are forbidden");
-    ++i;
     std::string out;
+    parse_string_into(out);
+    return out;
+  }
+
+  // Checks the value at the cursor with parse_value()'s grammar without building it. Duplicate keys
+  // inside it are not looked for.
+  void skip_value() {
+    if (std::optional<std::string> error = scan_value()) fail(*error);
+  }
+
+  // skip_value() without throwing: returns the message parse_value() would fail with, if any.
+  std::optional<std::string> scan_value() {
+    skip_ws();
+    if (i >= s.size()) return std::string("unexpected end");
+    const char c = s[i];
+    if (c == '{') {
+      ++i;
+      if (consume('}')) return std::nullopt;
+      const bool check_duplicates =
+          first_duplicate_key && duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::Error;
+      std::vector<std::string> keys;
+      while (true) {
+        skip_ws();
+        if (i >= s.size()) return std::string("unterminated object");
+        if (!(s[i] == '"' || s[i] == '\'')) return std::string("expected string key");
+        const size_t key_start = i;
+        if (const char* error = scan_string()) return std::string(error);
+        if (check_duplicates) {
+          const size_t key_end = i;
+          i = key_start;
+          keys.emplace_back();
+          parse_string_into(keys.back());  // already scanned, so it can't fail
+          i = key_end;
+        }
+        if (!consume(':')) return std::string("expected :");
+        if (std::optional<std::string> error = scan_value()) return error;
+        if (check_duplicates && std::find(keys.begin(), keys.end() - 1, keys.back()) != keys.end() - 1) {
+          *first_duplicate_key = keys.back();
+          return std::string("duplicate key");
+        }
+        if (consume('}')) return std::nullopt;
+        if (!consume(',')) return std::string("expected , or }");
+      }
+    }
+    if (c == '[') {
+      ++i;
+      if (consume(']')) return std::nullopt;
+      while (true) {
+        if (std::optional<std::string> error = scan_value()) return error;
+        if (consume(']')) return std::nullopt;
+        if (!consume(',')) return std::string("expected , or ]");
+      }
+    }
+    if (c == '"' || c == '\'') {
+      if (const char* error = scan_string()) return std::string(error);
+      return std::nullopt;
+    }
+    const char* word = c == 't' ? "true" : c == 'f' ? "false" : c == 'n' ? "null" : nullptr;
+    if (word) {
+      const size_t n = std::strlen(word);
+      if (s.compare(i, n, word) != 0) return "expected " + std::string(word);
+      i += n;
+      return std::nullopt;
+    }
+    if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+      skip_number();
+      return std::nullopt;
+    }
+    return std::string("unexpected char '") + c + "'";
+  }
+
+  // Steps over the string literal at the cursor; returns the parse error, or nullptr.
+  const char* scan_string() {
+    const char q = s[i];
+    if (q == '\'' && !allow_single_quotes) return "single-quoted strings are forbidden";
+    ++i;
     while (i < s.size()) {
       char c = s[i++];
-      if (c == q) return out;
+      if (c == q) return nullptr;
       if (c == '\\') {
-        if (i >= s.size()) fail("bad escape");
-        char e = s[i++];
-        switch (e) {
-          case '"': out.push_back('"'); break;
-          case '\\': out.push_back('\\'); break;
-          case '/': out.push_back('/'); break;
-          case 'b': out.push_back('\b'); break;
-          case 'f': out.push_back('\f'); break;
-          case 'n': out.push_back('\n'); break;
-          case 'r': out.push_back('\r'); break;
-          case 't': out.push_back('\t'); break;
-          default:
-            // Minimal: keep unknown escapes as-is.
-            out.push_back(e);
-        }
-      } else {
-        out.push_back(c);
+        if (i >= s.size()) return "bad escape";
+        ++i;
       }
     }
-    fail("unterminated string");
-    return out;
+    return "unterminated string";
   }
 
-  double parse_number() {
-    skip_ws();
-    size_t start = i;
+  // Advances over a number token (which never fails to parse); returns whether it has no fraction/exponent.
+  bool skip_number() {
     if (s[i] == '-') ++i;
     while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
+    bool integral = true;
     if (i < s.size() && s[i] == '.') {
+      integral = false;
       ++i;
       while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
     }
     if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+      integral = false;
       ++i;
       if (i < s.size() && (s[i] == '+' || s[i] == '-')) ++i;
       while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
     }
-    std::string num = s.substr(start, i - start);
-    char* endp = nullptr;
-    double v = std::strtod(num.c_str(), &endp);
-    (void)endp;
-    return v;
+    return integral;
+  }
+
+  // Decodes the string literal at the cursor into `out`, replacing its contents.
+  void parse_string_into(std::string& out) {
+    skip_ws();
+    if (i >= s.size()) fail("expected string");
+    char q = s[i];
+    if (q != '"' && q != '\'') fail("expected quote");
+    if (q == '\'' && !allow_single_quotes) fail("single-quoted strings are forbidden");
+    ++i;
+    out.clear();
+    while (i < s.size()) {
+      char c = s[i++];
+      if (c == q) return;
+      if (c == '\\') {
+        if (i >= s.size()) fail("bad escape");
+        out.push_back(unescape_json_char(s[i++]));
+      } else {
+        out.push_back(c);
+      }
+    }
+    fail("unterminated string");
+  }
+
+  Json parse_number() {
+    skip_ws();
+    size_t start = i;
+    const bool integral = skip_number();
+    const char* first = s.data() + start;
+    const char* last = s.data() + i;
+    if (integral) {
+      // Integer literals stay exact unless they overflow int64; "-0" stays a double to keep its sign.
+      int64_t n = 0;
+      auto res = std::from_chars(first, last, n);
+      if (res.ec == std::errc() && res.ptr == last && !(n == 0 && *first == '-')) return Json(n);
+    }
+    return Json(parse_number_token(first, last));
   }
 
   Json parse_true() {
@@ -686,332 +1120,237 @@ static Json parse_json_strictish(const std::string& fixed,
   return v;
 }
 
-static std::optional<std::string> try_extract_json_candidate(const std::string& text) {
-  // 1) fenced block ```json ... ```
-  {
-    auto lines = split_lines(text);
-    bool in = false;
-    std::ostringstream body;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-      std::string line = ltrim_copy(lines[idx]);
-      std::string low = to_lower(line);
-      if (!in) {
-        if (low.rfind("```json", 0) == 0) {
-          in = true;
-          body.str("");
-          body.clear();
-        }
-      } else {
-        if (low.rfind("```", 0) == 0) {
-          std::string out = body.str();
-          if (!out.empty() && out.back() == '\n') out.pop_back();
-          return out;
-        }
-        body << lines[idx] << "\n";
-      }
-    }
-    if (in) return std::nullopt;  // fence started but not closed yet
+// The error parse_json_strictish() would fail with, found without building anything or throwing. A
+// duplicate key under DuplicateKeyPolicy::Error is recorded in `duplicate`.
+static std::optional<std::string> json_syntax_error(const std::string& text,
+                                                    const RepairConfig& repair,
+                                                    std::optional<std::string>& duplicate) {
+  Parser p(text, repair.allow_single_quotes, repair.duplicate_key_policy, nullptr);
+  p.first_duplicate_key = &duplicate;
+  std::optional<std::string> error = p.scan_value();
+  if (!error) {
+    p.skip_ws();
+    if (p.i != text.size()) error = "trailing data";
   }
+  return error;
+}
 
-  // 2) first balanced {...} or [...]
-  auto scan_balanced = [&](char open, char close) -> std::optional<std::string> {
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-    int depth = 0;
-    size_t start = std::string::npos;
-
-    for (size_t idx = 0; idx < text.size(); ++idx) {
-      char c = text[idx];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
+// A ``` fenced block opened at `open`: text[body, close) is its body and `close` where the closing ``` line
+// starts, or npos while the block is still open.
+struct FenceSpan {
+  size_t open{0};
+  size_t body{0};
+  size_t close{std::string::npos};
+};
+
+// Whether text[pos..) starts with `word`, compared exactly or (for a lowercase `word`) case-insensitively.
+static bool matches_at(const std::string& text, size_t pos, const char* word, bool ignore_case) {
+  for (; *word; ++word, ++pos) {
+    if (pos >= text.size()) return false;
+    const unsigned char c = static_cast<unsigned char>(text[pos]);
+    if ((ignore_case ? std::tolower(c) : c) != static_cast<unsigned char>(*word)) return false;
+  }
+  return true;
+}
 
+// Start of the first line at or after `from` (itself a line start) whose text after leading whitespace is
+// ``` followed by one of `langs`, or npos. Only the backticks are searched for; no line is copied.
+static size_t find_fence_line(const std::string& text, size_t from, std::initializer_list<const char*> langs,
+                              bool ignore_case) {
+  for (size_t tick = text.find('`', from); tick != std::string::npos; tick = text.find('`', tick + 1)) {
+    size_t line = tick;
+    while (line > from && text[line - 1] != '\n' && std::isspace(static_cast<unsigned char>(text[line - 1]))) --line;
+    if (line > from && text[line - 1] != '\n') continue;
+    if (!matches_at(text, tick, "```", false)) continue;
+    for (const char* lang : langs) {
+      if (matches_at(text, tick + 3, lang, ignore_case)) return line;
+    }
+  }
+  return std::string::npos;
+}
+
+// The first ```<lang> block opened on its own line at or after `from`, closed by the next line starting with ```.
+static std::optional<FenceSpan> find_fenced_lines(const std::string& text, size_t from,
+                                                  std::initializer_list<const char*> langs, bool ignore_case) {
+  const size_t open = find_fence_line(text, from, langs, ignore_case);
+  if (open == std::string::npos) return std::nullopt;
+  const size_t open_end = text.find('\n', open);
+  if (open_end == std::string::npos) return FenceSpan{open, text.size(), std::string::npos};
+  return FenceSpan{open, open_end + 1, find_fence_line(text, open_end + 1, {""}, false)};
+}
+
+// The body as the line-based extractors have always returned it: '\r' dropped, no trailing newline.
+static std::string fence_body_lines(const std::string& text, const FenceSpan& fence) {
+  const size_t end = std::min(fence.close, text.size());
+  std::string body;
+  body.reserve(end - fence.body);
+  std::remove_copy(text.begin() + static_cast<std::ptrdiff_t>(fence.body), text.begin() + static_cast<std::ptrdiff_t>(end),
+                   std::back_inserter(body), '\r');
+  if (fence.close != std::string::npos && !body.empty() && body.back() == '\n') body.pop_back();
+  return body;
+}
+
+// [start, end) of the first balanced run opened by `open` ('{' or '['), outside quoted strings.
+static std::optional<std::pair<size_t, size_t>> find_balanced_run(const std::string& text, char open) {
+  static const ByteScanner braces("{}\"'");
+  static const ByteScanner brackets("[]\"'");
+  static const ByteScanner in_double("\\\"");
+  static const ByteScanner in_single("\\'");
+  const ByteScanner& structural = open == '{' ? braces : brackets;
+  char quote = 0;
+  int depth = 0;
+  size_t start = std::string::npos;
+  for (size_t idx = structural.find(text, 0); idx != std::string::npos;) {
+    const char c = text[idx];
+    if (quote) {
+      if (c == '\\') {
+        idx += 2;  // the escaped character never ends the string
+      } else {
+        quote = 0;
+        idx += 1;
+      }
+    } else {
       if (c == '"' || c == '\'') {
-        in_str = true;
         quote = c;
-        continue;
-      }
-
-      if (c == open) {
-        if (depth == 0) start = idx;
-        depth++;
-      } else if (c == close && depth > 0) {
-        depth--;
-        if (depth == 0 && start != std::string::npos) {
-          return text.substr(start, idx - start + 1);
-        }
+      } else if (c == open) {
+        if (depth++ == 0) start = idx;
+      } else if (depth > 0 && --depth == 0) {
+        return std::make_pair(start, idx + 1);
       }
+      idx += 1;
     }
-
-    if (start != std::string::npos) return std::nullopt;  // started but not closed yet
-    return std::nullopt;
-  };
-
-  if (auto obj = scan_balanced('{', '}')) return obj;
-  if (auto arr = scan_balanced('[', ']')) return arr;
-
+    const ByteScanner& next = !quote ? structural : quote == '"' ? in_double : in_single;
+    idx = next.find(text, idx);
+  }
   return std::nullopt;
 }
 
+// The first balanced {...} run, else the first balanced [...] run.
+static std::optional<std::string> find_balanced_json(const std::string& text) {
+  auto run = find_balanced_run(text, '{');
+  if (!run) run = find_balanced_run(text, '[');
+  if (!run) return std::nullopt;
+  return text.substr(run->first, run->second - run->first);
+}
+
 struct JsonCandidateSpan {
   std::string candidate;
-  size_t consume_end{0};  // number of bytes to consume from start of buffer
+  size_t consume_end{0};  // offset just past the candidate (or its closing fence)
 };
 
-static std::optional<size_t> find_ci(const std::string& haystack, const std::string& needle) {
-  if (needle.empty()) return 0;
-  if (haystack.size() < needle.size()) return std::nullopt;
-  for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
-    bool ok = true;
-    for (size_t j = 0; j < needle.size(); ++j) {
-      char a = static_cast<char>(std::tolower(static_cast<unsigned char>(haystack[i + j])));
-      char b = static_cast<char>(std::tolower(static_cast<unsigned char>(needle[j])));
-      if (a != b) {
-        ok = false;
-        break;
-      }
-    }
-    if (ok) return i;
-  }
-  return std::nullopt;
-}
+// The earliest complete candidate at or after `from` in a stream buffer, found in one forward pass that
+// tracks both bracket kinds: the first {...} and first [...] run each close at their own depth 0, and the
+// one that starts first wins. A ```json fence reached before any run completes takes over, and nothing is
+// returned until its closing fence arrives. The scan stops as soon as the answer is settled, so popping k
+// candidates off a buffer costs O(n) overall.
+static std::optional<JsonCandidateSpan> try_extract_next_json_candidate_span(const std::string& text, size_t from) {
+  constexpr size_t npos = std::string::npos;
+  bool in_str = false;
+  char quote = 0;
+  bool escape = false;
+  int obj_depth = 0, arr_depth = 0;
+  size_t obj_start = npos, arr_start = npos;
+  std::optional<std::pair<size_t, size_t>> obj, arr;  // [start, end) of the first completed run of each kind
+
+  auto best = [&]() -> std::optional<JsonCandidateSpan> {
+    std::optional<std::pair<size_t, size_t>> pick = obj;
+    if (arr && (!pick || arr->first < pick->first)) pick = arr;
+    if (!pick) return std::nullopt;
+    return JsonCandidateSpan{text.substr(pick->first, pick->second - pick->first), pick->second};
+  };
 
-static std::optional<JsonCandidateSpan> try_extract_next_json_candidate_span(const std::string& text) {
-  // 1) fenced ```json ... ``` (best-effort, case-insensitive)
-  {
-    auto start = find_ci(text, "```json");
-    if (start) {
-      size_t start_pos = *start;
-      size_t body_start = text.find('\n', start_pos);
-      if (body_start == std::string::npos) return std::nullopt;
+  static const ByteScanner outside("`{}[]\"'");
+  static const ByteScanner in_double("`\\\"");
+  static const ByteScanner in_single("`\\'");
+  auto next = [&](size_t idx) {
+    if (escape) return idx;  // an escaped character is looked at whatever it is
+    return (!in_str ? outside : quote == '"' ? in_double : in_single).find(text, idx);
+  };
+  for (size_t idx = next(from); idx < text.size(); idx = next(idx + 1)) {
+    const char c = text[idx];
+    if (c == '`' && matches_at(text, idx, "```json", true)) {
+      if (obj || arr) return best();
+      size_t body_start = text.find('\n', idx);
+      if (body_start == npos) return std::nullopt;
       body_start += 1;
-      size_t end_pos = text.find("```", body_start);
-      if (end_pos == std::string::npos) return std::nullopt;
+      const size_t end_pos = text.find("```", body_start);
+      if (end_pos == npos) return std::nullopt;
       std::string body = text.substr(body_start, end_pos - body_start);
       // trim one trailing newline to match extract_json_candidate behavior
       if (!body.empty() && body.back() == '\n') body.pop_back();
-      return JsonCandidateSpan{body, end_pos + 3};
+      return JsonCandidateSpan{std::move(body), end_pos + 3};
     }
-  }
-
-  // 2) first balanced {...} or [...] (choose earliest)
-  auto scan_balanced_span = [&](char open, char close) -> std::optional<std::pair<size_t, size_t>> {
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-    int depth = 0;
-    size_t start = std::string::npos;
-
-    for (size_t idx = 0; idx < text.size(); ++idx) {
-      char c = text[idx];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
-
-      if (c == '"' || c == '\'') {
-        in_str = true;
-        quote = c;
-        continue;
-      }
-
-      if (c == open) {
-        if (depth == 0) start = idx;
-        depth++;
-      } else if (c == close && depth > 0) {
-        depth--;
-        if (depth == 0 && start != std::string::npos) {
-          return std::make_pair(start, idx);
-        }
+    if (in_str) {
+      if (escape) {
+        escape = false;
+      } else if (c == '\\') {
+        escape = true;
+      } else if (c == quote) {
+        in_str = false;
       }
+      continue;
     }
-
-    if (start != std::string::npos) return std::nullopt;  // started but not closed yet
-    return std::nullopt;
-  };
-
-  std::optional<std::pair<size_t, size_t>> obj = scan_balanced_span('{', '}');
-  std::optional<std::pair<size_t, size_t>> arr = scan_balanced_span('[', ']');
-
-  std::optional<std::pair<size_t, size_t>> best;
-  if (obj) best = obj;
-  if (arr) {
-    if (!best || arr->first < best->first) best = arr;
-  }
-  if (best) {
-    size_t start = best->first;
-    size_t end = best->second;
-    return JsonCandidateSpan{text.substr(start, end - start + 1), end + 1};
+    if (c == '"' || c == '\'') {
+      in_str = true;
+      quote = c;
+    } else if (c == '{' && !obj) {
+      if (obj_depth++ == 0) obj_start = idx;
+    } else if (c == '[' && !arr) {
+      if (arr_depth++ == 0) arr_start = idx;
+    } else if (c == '}' && !obj && obj_depth > 0 && --obj_depth == 0) {
+      obj = std::make_pair(obj_start, idx + 1);
+    } else if (c == ']' && !arr && arr_depth > 0 && --arr_depth == 0) {
+      arr = std::make_pair(arr_start, idx + 1);
+    } else {
+      continue;
+    }
+    // Settled once a run is complete and the other kind cannot start before it any more.
+    if (obj && (arr || arr_start == npos || arr_start > obj->first)) return best();
+    if (arr && (obj || obj_start == npos || obj_start > arr->first)) return best();
   }
-  return std::nullopt;
+  return best();
 }
 
-static std::optional<std::string> pop_next_json_candidate(std::string& buf) {
-  auto span = try_extract_next_json_candidate_span(buf);
-  if (!span) return std::nullopt;
-  std::string cand = span->candidate;
-  buf.erase(0, span->consume_end);
-  return cand;
-}
+// Pops candidates off the front of a stream buffer by offset; the consumed prefix is erased once, when the
+// cursor goes out of scope, instead of after every candidate.
+class StreamCandidateCursor {
+ public:
+  explicit StreamCandidateCursor(std::string& buf) : buf_(buf) {}
+  ~StreamCandidateCursor() { buf_.erase(0, consumed_); }
+  StreamCandidateCursor(const StreamCandidateCursor&) = delete;
+  StreamCandidateCursor& operator=(const StreamCandidateCursor&) = delete;
 
-std::string extract_json_candidate(const std::string& text) {
-  // 1) fenced block ```json ... ``` (scan lines; MSVC std::regex doesn't support (?is) flags)
-  {
-    auto lines = split_lines(text);
-    bool in = false;
-    std::ostringstream body;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-      std::string line = ltrim_copy(lines[idx]);
-      std::string low = to_lower(line);
-      if (!in) {
-        if (low.rfind("```json", 0) == 0) {
-          in = true;
-          body.str("");
-          body.clear();
-        }
-      } else {
-        if (low.rfind("```", 0) == 0) {
-          std::string out = body.str();
-          if (!out.empty() && out.back() == '\n') out.pop_back();
-          return out;
-        }
-        body << lines[idx] << "\n";
-      }
-    }
+  std::optional<std::string> next() {
+    auto span = try_extract_next_json_candidate_span(buf_, consumed_);
+    if (!span) return std::nullopt;
+    consumed_ = span->consume_end;
+    return std::move(span->candidate);
   }
 
-  // 2) first balanced {...} or [...]
-  auto scan_balanced = [&](char open, char close) -> std::optional<std::string> {
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-    int depth = 0;
-    size_t start = std::string::npos;
-
-    for (size_t idx = 0; idx < text.size(); ++idx) {
-      char c = text[idx];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
-
-      if (c == '"' || c == '\'') {
-        in_str = true;
-        quote = c;
-        continue;
-      }
+ private:
+  std::string& buf_;
+  size_t consumed_{0};
+};
 
-      if (c == open) {
-        if (depth == 0) start = idx;
-        depth++;
-      } else if (c == close && depth > 0) {
-        depth--;
-        if (depth == 0 && start != std::string::npos) {
-          return text.substr(start, idx - start + 1);
-        }
-      }
-    }
-    return std::nullopt;
-  };
+std::string extract_json_candidate(const std::string& text) {
+  // 1) fenced block ```json ... ```
+  auto fence = find_fenced_lines(text, 0, {"json"}, true);
+  if (fence && fence->close != std::string::npos) return fence_body_lines(text, *fence);
 
-  if (auto obj = scan_balanced('{', '}')) return *obj;
-  if (auto arr = scan_balanced('[', ']')) return *arr;
+  // 2) first balanced {...} or [...]
+  if (auto balanced = find_balanced_json(text)) return *balanced;
 
   throw std::runtime_error("no JSON found");
 }
 
-static std::pair<std::string, bool> extract_json_candidate_with_meta(const std::string& text) {
+// The candidate and whether it came from a ```json fence, or nullopt when the text holds no JSON.
+static std::optional<std::pair<std::string, bool>> try_extract_json_candidate_with_meta(const std::string& text) {
   // 1) fenced block ```json ... ```
-  {
-    auto lines = split_lines(text);
-    bool in = false;
-    std::ostringstream body;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-      std::string line = ltrim_copy(lines[idx]);
-      std::string low = to_lower(line);
-      if (!in) {
-        if (low.rfind("```json", 0) == 0) {
-          in = true;
-          body.str("");
-          body.clear();
-        }
-      } else {
-        if (low.rfind("```", 0) == 0) {
-          std::string out = body.str();
-          if (!out.empty() && out.back() == '\n') out.pop_back();
-          return {out, true};
-        }
-        body << lines[idx] << "\n";
-      }
-    }
-  }
+  auto fence = find_fenced_lines(text, 0, {"json"}, true);
+  if (fence && fence->close != std::string::npos) return std::make_pair(fence_body_lines(text, *fence), true);
 
   // 2) first balanced {...} or [...]
-  auto scan_balanced = [&](char open, char close) -> std::optional<std::string> {
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-    int depth = 0;
-    size_t start = std::string::npos;
-
-    for (size_t idx = 0; idx < text.size(); ++idx) {
-      char c = text[idx];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
-
-      if (c == '"' || c == '\'') {
-        in_str = true;
-        quote = c;
-        continue;
-      }
-
-      if (c == open) {
-        if (depth == 0) start = idx;
-        depth++;
-      } else if (c == close && depth > 0) {
-        depth--;
-        if (depth == 0 && start != std::string::npos) {
-          return text.substr(start, idx - start + 1);
-        }
-      }
-    }
-    return std::nullopt;
-  };
-
-  if (auto obj = scan_balanced('{', '}')) return {*obj, false};
-  if (auto arr = scan_balanced('[', ']')) return {*arr, false};
+  if (auto balanced = find_balanced_json(text)) return std::make_pair(std::move(*balanced), false);
 
   // 3) Fallback for top-level JSON primitives or incomplete JSON.
   // If the input starts with a JSON token (after whitespace), treat the remainder as the candidate.
@@ -1023,17 +1362,17 @@ static std::pair<std::string, bool> extract_json_candidate_with_meta(const std::
       const bool looks_like_json_value =
           (c0 == '{' || c0 == '[' || c0 == '"' || c0 == '\'' || c0 == '-' || std::isdigit(static_cast<unsigned char>(c0)) ||
            c0 == 't' || c0 == 'f' || c0 == 'n');
-      if (looks_like_json_value) return {trimmed, false};
+      if (looks_like_json_value) return std::make_pair(trimmed, false);
     }
   }
-
-  throw std::runtime_error("no JSON found");
+  return std::nullopt;
 }
 
-struct TextRange {
-  size_t start{0};
-  size_t end{0};  // exclusive
-};
+static std::pair<std::string, bool> extract_json_candidate_with_meta(const std::string& text) {
+  auto candidate = try_extract_json_candidate_with_meta(text);
+  if (!candidate) throw std::runtime_error("no JSON found");
+  return std::move(*candidate);
+}
 
 struct CandidateWithMeta {
   size_t start{0};
@@ -1041,157 +1380,109 @@ struct CandidateWithMeta {
   bool from_fence{false};
 };
 
-static bool RangeContains(const TextRange& r, size_t idx) { return idx >= r.start && idx < r.end; }
-
-static std::vector<CandidateWithMeta> extract_json_candidates_with_meta_all(const std::string& text) {
-  std::vector<CandidateWithMeta> out;
-  std::vector<TextRange> fenced_ranges;
-
-  // 1) all fenced blocks ```json ... ```
-  {
-    bool in = false;
-    size_t fence_start = 0;
-    size_t body_start = 0;
-
-    size_t pos = 0;
-    while (pos <= text.size()) {
-      const size_t line_start = pos;
-      size_t line_end = text.find('\n', pos);
-      if (line_end == std::string::npos) line_end = text.size();
-      const std::string line_raw = text.substr(line_start, line_end - line_start);
-      const std::string line = ltrim_copy(line_raw);
-      const std::string low = to_lower(line);
-
-      if (!in) {
-        if (low.rfind("```json", 0) == 0) {
-          in = true;
-          fence_start = line_start;
-          body_start = (line_end < text.size()) ? (line_end + 1) : text.size();
+// Matches {...} and [...] on per-kind stacks alongside the quote state, over one or more ranges of plain
+// text fed in order; the quote state carries over from one range to the next. An unmatched bracket costs
+// nothing extra, so a scan is O(n) however many runs the text holds.
+class BracketMatcher {
+ public:
+  void scan(const std::string& text, size_t from, size_t to) {
+    static const ByteScanner outside("{}[]\"'");
+    static const ByteScanner in_double("\\\"");
+    static const ByteScanner in_single("\\'");
+    const std::string_view plain(text.data(), to);
+    auto next = [&](size_t idx) {
+      if (escape_) return idx;  // an escaped character is looked at whatever it is
+      return (!quote_ ? outside : quote_ == '"' ? in_double : in_single).find(plain, idx);
+    };
+    for (size_t idx = next(from); idx < to; idx = next(idx + 1)) {
+      const char c = text[idx];
+      if (quote_) {
+        if (escape_) {
+          escape_ = false;
+        } else if (c == '\\') {
+          escape_ = true;
+        } else if (c == quote_) {
+          quote_ = 0;
         }
+      } else if (c == '"' || c == '\'') {
+        quote_ = c;
+      } else if (c == '{' || c == '[') {
+        (c == '{' ? open_braces_ : open_brackets_).push_back(opens_.size());
+        opens_.push_back(Open{idx, std::string::npos});
       } else {
-        if (low.rfind("```", 0) == 0) {
-          const size_t body_end = line_start;
-          std::string body = text.substr(body_start, body_end - body_start);
-          // match extract_json_candidate behavior: trim one trailing newline
-          if (!body.empty() && body.back() == '\n') body.pop_back();
-          out.push_back(CandidateWithMeta{body_start, std::move(body), true});
-
-          const size_t fence_end = (line_end < text.size()) ? (line_end + 1) : line_end;
-          fenced_ranges.push_back(TextRange{fence_start, fence_end});
-          in = false;
+        std::vector<size_t>& stack = c == '}' ? open_braces_ : open_brackets_;
+        if (!stack.empty()) {
+          opens_[stack.back()].end = idx + 1;
+          stack.pop_back();
         }
       }
-
-      if (line_end >= text.size()) break;
-      pos = line_end + 1;
     }
   }
 
-  // sort ranges so we can skip them efficiently
-  std::sort(fenced_ranges.begin(), fenced_ranges.end(), [](const TextRange& a, const TextRange& b) { return a.start < b.start; });
-
-  auto skip_fenced = [&](size_t& idx) -> bool {
-    // linear scan is fine (few fences typical)
-    for (const auto& r : fenced_ranges) {
-      if (RangeContains(r, idx)) {
-        idx = (r.end > 0) ? (r.end - 1) : idx;
-        return true;
-      }
+  // [start, end) of the matched runs, leftmost first, skipping those nested inside one already taken.
+  std::vector<std::pair<size_t, size_t>> outer_runs() const {
+    std::vector<std::pair<size_t, size_t>> runs;
+    size_t taken_end = 0;
+    for (const Open& o : opens_) {
+      if (o.end == std::string::npos || o.start < taken_end) continue;
+      runs.emplace_back(o.start, o.end);
+      taken_end = o.end;
     }
-    return false;
+    return runs;
+  }
+
+ private:
+  struct Open {
+    size_t start;
+    size_t end;  // one past the matching bracket, or npos
   };
+  std::vector<Open> opens_;
+  std::vector<size_t> open_braces_, open_brackets_;  // indices into `opens_` still waiting for their close
+  char quote_{0};
+  bool escape_{false};
+};
 
-  auto extract_balanced_at = [&](size_t start, std::string& cand, size_t& end_out) -> bool {
-    if (start >= text.size()) return false;
-    const char open = text[start];
-    const char close = (open == '{') ? '}' : ']';
+// Every JSON candidate in one forward pass: the bodies of ```json fences, and balanced {...} / [...] runs
+// outside them, in order of position. Fenced blocks are opaque to the bracket scan; an unterminated fence is
+// scanned as plain text.
+static std::vector<CandidateWithMeta> scan_json_candidates(const std::string& text) {
+  constexpr size_t npos = std::string::npos;
+  std::vector<CandidateWithMeta> fenced;
+  BracketMatcher brackets;
+  const size_t n = text.size();
 
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-    int depth = 0;
+  // Brackets are scanned up to the next fence line; once a fence never closes, every later ``` line would
+  // have closed it, so the rest of the text is plain.
+  for (size_t i = 0; i < n;) {
+    std::optional<FenceSpan> fence = find_fenced_lines(text, i, {"json"}, true);
+    if (fence && fence->close == npos) fence.reset();
+    brackets.scan(text, i, fence ? fence->open : n);
+    if (!fence) break;
 
-    for (size_t i = start; i < text.size(); ++i) {
-      char c = text[i];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
+    std::string body = text.substr(fence->body, fence->close - fence->body);
+    // match extract_json_candidate behavior: trim one trailing newline
+    if (!body.empty() && body.back() == '\n') body.pop_back();
+    fenced.push_back(CandidateWithMeta{fence->body, std::move(body), true});
+    const size_t close_end = text.find('\n', fence->close);
+    i = close_end == npos ? n : close_end + 1;
+  }
 
-      if (c == '"' || c == '\'') {
-        in_str = true;
-        quote = c;
-        continue;
-      }
+  std::vector<CandidateWithMeta> balanced;
+  for (const auto& [start, end] : brackets.outer_runs()) {
+    balanced.push_back(CandidateWithMeta{start, text.substr(start, end - start), false});
+  }
 
-      if (c == open) {
-        depth++;
-      } else if (c == close) {
-        if (depth > 0) depth--;
-        if (depth == 0) {
-          end_out = i + 1;
-          cand = text.substr(start, end_out - start);
-          return true;
-        }
-      }
-    }
-    return false;
-  };
-
-  // 2) all balanced {...} / [...] outside fenced regions
-  {
-    bool in_str = false;
-    char quote = 0;
-    bool escape = false;
-
-    for (size_t idx = 0; idx < text.size(); ++idx) {
-      if (skip_fenced(idx)) continue;
-
-      char c = text[idx];
-      if (in_str) {
-        if (escape) {
-          escape = false;
-        } else if (c == '\\') {
-          escape = true;
-        } else if (c == quote) {
-          in_str = false;
-          quote = 0;
-        }
-        continue;
-      }
-
-      if (c == '"' || c == '\'') {
-        in_str = true;
-        quote = c;
-        continue;
-      }
-
-      if (c == '{' || c == '[') {
-        std::string cand;
-        size_t end = 0;
-        if (extract_balanced_at(idx, cand, end)) {
-          out.push_back(CandidateWithMeta{idx, std::move(cand), false});
-          idx = end - 1;
-        }
-      }
-    }
-  }
+  std::vector<CandidateWithMeta> out;
+  out.reserve(fenced.size() + balanced.size());
+  std::merge(std::make_move_iterator(fenced.begin()), std::make_move_iterator(fenced.end()),
+             std::make_move_iterator(balanced.begin()), std::make_move_iterator(balanced.end()), std::back_inserter(out),
+             [](const CandidateWithMeta& a, const CandidateWithMeta& b) { return a.start < b.start; });
+  return out;
+}
 
+static std::vector<CandidateWithMeta> extract_json_candidates_with_meta_all(const std::string& text) {
+  std::vector<CandidateWithMeta> out = scan_json_candidates(text);
   if (out.empty()) throw std::runtime_error("no JSON found");
-
-  std::sort(out.begin(), out.end(), [](const CandidateWithMeta& a, const CandidateWithMeta& b) {
-    if (a.start != b.start) return a.start < b.start;
-    // stable-ish tie-breaker
-    if (a.from_fence != b.from_fence) return a.from_fence;
-    return a.text.size() < b.text.size();
-  });
   return out;
 }
 
@@ -1203,67 +1494,62 @@ std::vector<std::string> extract_json_candidates(const std::string& text) {
   return out;
 }
 
-static JsonishParseResult loads_jsonish_candidate_ex(const std::string& candidate, bool from_fence, const RepairConfig& repair) {
-  RepairMetadata meta;
-  meta.extracted_from_fence = from_fence;
-
-  std::string fixed = candidate;
-
-  if (repair.fix_smart_quotes) {
-    std::string before = fixed;
-    fixed = fix_smart_quotes(fixed);
-    meta.fixed_smart_quotes = (fixed != before);
-  }
-
-  if (repair.strip_json_comments) {
-    std::string before = fixed;
-    fixed = strip_json_comments(fixed);
-    meta.stripped_comments = (fixed != before);
-  }
-
-  if (repair.replace_python_literals) {
-    std::string before = fixed;
-    fixed = replace_python_literals(fixed);
-    meta.replaced_python_literals = (fixed != before);
-  }
+// Parses a candidate with `parse(text, &dup_count)`: first as-is when the strict fast path is on, then
+// after the text repairs. Fills `meta` and returns the text that parsed.
+template <typename ParseFn>
+static std::string parse_candidate_with_repairs(std::string candidate,
+                                                const RepairConfig& repair,
+                                                RepairMetadata& meta,
+                                                ParseFn&& parse) {
+  meta.duplicateKeyPolicy = repair.duplicate_key_policy;
 
-  if (repair.convert_kv_object_to_json) {
-    if (auto converted = try_kv_object_to_json(fixed)) {
-      meta.converted_kv_object = true;
-      fixed = *converted;
+  // Most candidates are already valid JSON: parse them in place and skip the repair passes entirely.
+  if (repair.strict_fast_path) {
+    try {
+      int dup_count = 0;
+      parse(candidate, &dup_count);
+      meta.used_strict_fast_path = true;
+      meta.duplicateKeyCount = dup_count;
+      return candidate;
+    } catch (const Parser::DuplicateKeyError& e) {
+      throw ValidationError("duplicate key", "$." + e.key, "parse");
+    } catch (const ValidationError&) {
+      throw;  // schema-driven parses report violations as they go
+    } catch (const std::exception&) {
+      // Fall through to the repair pipeline.
     }
   }
 
-  if (repair.quote_unquoted_keys) {
-    std::string before = fixed;
-    fixed = quote_unquoted_keys(fixed);
-    meta.quoted_unquoted_keys = (fixed != before);
-  }
-
-  if (repair.drop_trailing_commas) {
-    std::string before = fixed;
-    fixed = drop_trailing_commas(fixed);
-    meta.dropped_trailing_commas = (fixed != before);
-  }
+  std::string fixed = repair_jsonish_text(candidate, repair, meta);
 
   try {
     int dup_count = 0;
-    Json v = parse_json_strictish(fixed, repair.allow_single_quotes, repair.duplicate_key_policy, &dup_count);
+    parse(fixed, &dup_count);
     meta.duplicateKeyCount = dup_count;
-    meta.duplicateKeyPolicy = repair.duplicate_key_policy;
-    return JsonishParseResult{std::move(v), std::move(fixed), meta};
+    return fixed;
   } catch (const Parser::DuplicateKeyError& e) {
     meta.duplicateKeyCount = std::max(meta.duplicateKeyCount, 1);
-    meta.duplicateKeyPolicy = repair.duplicate_key_policy;
     throw ValidationError("duplicate key", "$." + e.key, "parse");
+  } catch (const ValidationError&) {
+    throw;
   } catch (const std::exception& e) {
     throw ValidationError(e.what(), "$", "parse");
   }
 }
 
+static JsonishParseResult loads_jsonish_candidate_ex(std::string candidate, bool from_fence, const RepairConfig& repair) {
+  RepairMetadata meta;
+  meta.extracted_from_fence = from_fence;
+  Json value;
+  std::string fixed = parse_candidate_with_repairs(std::move(candidate), repair, meta, [&](const std::string& text, int* dup_count) {
+    value = parse_json_strictish(text, repair.allow_single_quotes, repair.duplicate_key_policy, dup_count);
+  });
+  return JsonishParseResult{std::move(value), std::move(fixed), meta};
+}
+
 JsonishParseResult loads_jsonish_ex(const std::string& text, const RepairConfig& repair) {
   auto [candidate, from_fence] = extract_json_candidate_with_meta(text);
-  return loads_jsonish_candidate_ex(candidate, from_fence, repair);
+  return loads_jsonish_candidate_ex(std::move(candidate), from_fence, repair);
 }
 
 Json loads_jsonish(const std::string& text) {
@@ -1281,8 +1567,8 @@ JsonishParseAllResult loads_jsonish_all_ex(const std::string& text, const Repair
   out.fixed.reserve(all.size());
   out.metadata.reserve(all.size());
 
-  for (const auto& it : all) {
-    auto r = loads_jsonish_candidate_ex(it.text, it.from_fence, repair);
+  for (auto& it : all) {
+    auto r = loads_jsonish_candidate_ex(std::move(it.text), it.from_fence, repair);
     out.values.push_back(std::move(r.value));
     out.fixed.push_back(std::move(r.fixed));
     out.metadata.push_back(std::move(r.metadata));
@@ -1290,166 +1576,2294 @@ JsonishParseAllResult loads_jsonish_all_ex(const std::string& text, const Repair
   return out;
 }
 
-// ---------------- JSON schema validation (subset) ----------------
+// ---------------- Arena documents ----------------
 
-static std::optional<std::string> get_string_field(const JsonObject& obj, const std::string& key) {
-  auto it = obj.find(key);
-  if (it == obj.end()) return std::nullopt;
-  if (!it->second.is_string()) return std::nullopt;
-  return it->second.as_string();
+struct JsonDocument::Arena {
+  static constexpr size_t kFirstBlock = 4096;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  std::vector<size_t> block_sizes;
+  char* cur{nullptr};
+  size_t left{0};
+  size_t used{0};
+
+  void* allocate(size_t n, size_t align) {
+    size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+    if (cur == nullptr || pad + n > left) {
+      size_t size = std::max(n + align, block_sizes.empty() ? kFirstBlock : block_sizes.back() * 2);
+      blocks.push_back(std::make_unique<char[]>(size));
+      block_sizes.push_back(size);
+      cur = blocks.back().get();
+      left = size;
+      pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+    }
+    void* p = cur + pad;
+    cur += pad + n;
+    left -= pad + n;
+    used += pad + n;
+    return p;
+  }
+
+  template <typename T>
+  T* allocate_array(size_t n) {
+    return static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+  }
+
+  size_t reserved() const {
+    size_t total = 0;
+    for (size_t sz : block_sizes) total += sz;
+    return total;
+  }
+
+  // Keeps one block large enough for everything allocated so far, so the next tree fits without growing.
+  void reset() {
+    if (blocks.size() > 1) {
+      size_t total = reserved();
+      blocks.clear();
+      block_sizes.clear();
+      blocks.push_back(std::make_unique<char[]>(total));
+      block_sizes.push_back(total);
+    }
+    cur = blocks.empty() ? nullptr : blocks.front().get();
+    left = block_sizes.empty() ? 0 : block_sizes.front();
+    used = 0;
+  }
+};
+
+static const JsonNode kNullNode;
+
+bool JsonNode::as_bool() const {
+  if (kind_ != Kind::Bool) throw std::bad_variant_access();
+  return u_.b;
 }
 
-static std::optional<double> get_number_field(const JsonObject& obj, const std::string& key) {
-  auto it = obj.find(key);
-  if (it == obj.end()) return std::nullopt;
-  if (!it->second.is_number()) return std::nullopt;
-  return it->second.as_number();
+double JsonNode::as_number() const {
+  if (kind_ == Kind::Int64) return static_cast<double>(u_.i);
+  if (kind_ != Kind::Double) throw std::bad_variant_access();
+  return u_.d;
 }
 
-static const JsonObject& require_object_schema(const Json& schema, const std::string& path) {
-  if (!schema.is_object()) throw ValidationError("schema must be object", path);
-  return schema.as_object();
+int64_t JsonNode::as_int64() const {
+  if (kind_ != Kind::Int64) throw std::bad_variant_access();
+  return u_.i;
 }
 
-static bool json_equals(const Json& a, const Json& b) {
-  // For our use (enum), compare dumps.
-  return dumps_json(a) == dumps_json(b);
+std::string_view JsonNode::as_string() const {
+  if (kind_ != Kind::String) throw std::bad_variant_access();
+  return std::string_view(u_.str, size_);
 }
 
-struct ValidateOptions {
-  bool collect_all{false};
-  std::vector<ValidationError>* errors{nullptr};
-};
+size_t JsonNode::size() const {
+  if (kind_ != Kind::Array && kind_ != Kind::Object) throw std::bad_variant_access();
+  return size_;
+}
 
-static void validate_impl(const Json& value, const Json& schema, const std::string& path, const ValidateOptions& opt);
+const JsonNode& JsonNode::operator[](size_t index) const {
+  if (kind_ != Kind::Array) throw std::bad_variant_access();
+  if (index >= size_) throw std::out_of_range("JsonNode index out of range");
+  return u_.items[index];
+}
 
-static bool report_or_throw(
-    const ValidateOptions& opt, const std::string& message, const std::string& path, const std::string& kind = "schema") {
-  if (opt.collect_all && opt.errors) {
-    opt.errors->emplace_back(message, path, kind);
-    return false;
+const JsonNode::Member& JsonNode::member(size_t index) const {
+  if (kind_ != Kind::Object) throw std::bad_variant_access();
+  if (index >= size_) throw std::out_of_range("JsonNode member index out of range");
+  return u_.members[index];
+}
+
+const JsonNode* JsonNode::find(std::string_view key) const {
+  if (kind_ != Kind::Object) return nullptr;
+  for (uint32_t k = 0; k < size_; ++k) {
+    if (u_.members[k].key == key) return &u_.members[k].value;
   }
-  throw ValidationError(message, path, kind);
+  return nullptr;
 }
 
-static bool schema_passes(const Json& value, const Json& schema, const std::string& path) {
+Json JsonNode::to_json() const {
+  switch (kind_) {
+    case Kind::Null:
+      return Json(nullptr);
+    case Kind::Bool:
+      return Json(u_.b);
+    case Kind::Int64:
+      return Json(u_.i);
+    case Kind::Double:
+      return Json(u_.d);
+    case Kind::String:
+      return Json(std::string(u_.str, size_));
+    case Kind::Array: {
+      JsonArray arr;
+      arr.reserve(size_);
+      for (uint32_t k = 0; k < size_; ++k) arr.push_back(u_.items[k].to_json());
+      return Json(std::move(arr));
+    }
+    case Kind::Object: {
+      JsonObject obj;
+      for (uint32_t k = 0; k < size_; ++k) {
+        obj.emplace(std::string(u_.members[k].key), u_.members[k].value.to_json());
+      }
+      return Json(std::move(obj));
+    }
+  }
+  return Json();
+}
+
+JsonDocument::JsonDocument() : arena_(std::make_unique<Arena>()), root_(&kNullNode) {}
+JsonDocument::~JsonDocument() = default;
+JsonDocument::JsonDocument(JsonDocument&&) noexcept = default;
+JsonDocument& JsonDocument::operator=(JsonDocument&&) noexcept = default;
+
+const JsonNode& JsonDocument::root() const { return *root_; }
+
+void JsonDocument::clear() {
+  if (!arena_) arena_ = std::make_unique<Arena>();
+  arena_->reset();
+  root_ = &kNullNode;
+}
+
+size_t JsonDocument::arena_bytes() const { return arena_ ? arena_->reserved() : 0; }
+
+// Parses into a document with the same grammar and duplicate-key handling as parse_json_strictish.
+// Open arrays and objects collect their children on shared scratch stacks and are copied into the
+// arena in one piece when they close.
+struct JsonDocumentBuilder {
+  Parser p;
+  JsonDocument::Arena& arena;
+  std::vector<JsonNode> items;
+  std::vector<JsonNode::Member> members;
+  std::string scratch;
+
+  JsonDocumentBuilder(const std::string& text, JsonDocument::Arena& arena_, const RepairConfig& repair, int* dup_count)
+      : p(text, repair.allow_single_quotes, repair.duplicate_key_policy, dup_count), arena(arena_) {}
+
+  std::string_view parse_string() {
+    p.parse_string_into(scratch);
+    char* out = arena.allocate_array<char>(scratch.size());
+    if (!scratch.empty()) std::memcpy(out, scratch.data(), scratch.size());
+    return std::string_view(out, scratch.size());
+  }
+
+  JsonNode parse_value() {
+    p.skip_ws();
+    if (p.i >= p.s.size()) p.fail("unexpected end");
+    char c = p.s[p.i];
+    JsonNode node;
+    if (c == '{') return parse_object();
+    if (c == '[') return parse_array();
+    if (c == '"' || c == '\'') {
+      if (c == '\'' && !p.allow_single_quotes) p.fail("single-quoted strings are forbidden");
+      std::string_view sv = parse_string();
+      node.kind_ = JsonNode::Kind::String;
+      node.size_ = static_cast<uint32_t>(sv.size());
+      node.u_.str = sv.data();
+      return node;
+    }
+    if (c == 't' || c == 'f') {
+      node.kind_ = JsonNode::Kind::Bool;
+      node.u_.b = (c == 't' ? p.parse_true() : p.parse_false()).as_bool();
+      return node;
+    }
+    if (c == 'n') {
+      p.parse_null();
+      return node;
+    }
+    if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+      Json n = p.parse_number();
+      if (n.is_int64()) {
+        node.kind_ = JsonNode::Kind::Int64;
+        node.u_.i = n.as_int64();
+      } else {
+        node.kind_ = JsonNode::Kind::Double;
+        node.u_.d = n.as_number();
+      }
+      return node;
+    }
+    p.fail(std::string("unexpected char '") + c + "'");
+  }
+
+  // The member of the open object (starting at members[base]) keyed `key`, or nullptr. Small objects are
+  // searched linearly; past JsonObject::kIndexThreshold members `index` is filled and kept up to date.
+  JsonNode::Member* find_member(size_t base, std::string_view key, std::unordered_map<std::string_view, size_t>& index) {
+    if (!index.empty()) {
+      auto it = index.find(key);
+      return it == index.end() ? nullptr : &members[it->second];
+    }
+    for (size_t j = base; j < members.size(); ++j) {
+      if (members[j].key == key) return &members[j];
+    }
+    return nullptr;
+  }
+
+  JsonNode parse_object() {
+    p.consume('{');
+    size_t base = members.size();
+    std::unordered_map<std::string_view, size_t> index;  // key -> position in `members`; empty while small
+    p.skip_ws();
+    if (!p.consume('}')) {
+      while (true) {
+        p.skip_ws();
+        if (p.i >= p.s.size()) p.fail("unterminated object");
+        if (!(p.s[p.i] == '"' || p.s[p.i] == '\'')) p.fail("expected string key");
+        if (p.s[p.i] == '\'' && !p.allow_single_quotes) p.fail("single-quoted strings are forbidden");
+        std::string_view key = parse_string();
+        p.skip_ws();
+        if (!p.consume(':')) p.fail("expected :");
+        JsonNode val = parse_value();
+
+        if (JsonNode::Member* dup = find_member(base, key, index)) {
+          if (p.duplicate_key_count) (*p.duplicate_key_count)++;
+          if (p.duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::Error) {
+            throw Parser::DuplicateKeyError{std::string(key)};
+          }
+          if (p.duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::LastWins) dup->value = val;
+        } else {
+          members.push_back(JsonNode::Member{key, val});
+          if (!index.empty()) {
+            index.emplace(key, members.size() - 1);
+          } else if (members.size() - base > JsonObject::kIndexThreshold) {
+            index.reserve((members.size() - base) * 2);
+            for (size_t j = base; j < members.size(); ++j) index.emplace(members[j].key, j);
+          }
+        }
+        p.skip_ws();
+        if (p.consume('}')) break;
+        if (!p.consume(',')) p.fail("expected , or }");
+      }
+    }
+    JsonNode node;
+    node.kind_ = JsonNode::Kind::Object;
+    node.size_ = static_cast<uint32_t>(members.size() - base);
+    JsonNode::Member* out = arena.allocate_array<JsonNode::Member>(node.size_);
+    std::uninitialized_copy(members.begin() + static_cast<std::ptrdiff_t>(base), members.end(), out);
+    node.u_.members = out;
+    members.resize(base);
+    return node;
+  }
+
+  JsonNode parse_array() {
+    p.consume('[');
+    size_t base = items.size();
+    p.skip_ws();
+    if (!p.consume(']')) {
+      while (true) {
+        items.push_back(parse_value());
+        p.skip_ws();
+        if (p.consume(']')) break;
+        if (!p.consume(',')) p.fail("expected , or ]");
+      }
+    }
+    JsonNode node;
+    node.kind_ = JsonNode::Kind::Array;
+    node.size_ = static_cast<uint32_t>(items.size() - base);
+    JsonNode* out = arena.allocate_array<JsonNode>(node.size_);
+    std::uninitialized_copy(items.begin() + static_cast<std::ptrdiff_t>(base), items.end(), out);
+    node.u_.items = out;
+    items.resize(base);
+    return node;
+  }
+
+  static void parse_into(JsonDocument& doc, const std::string& text, const RepairConfig& repair, int* dup_count) {
+    doc.clear();
+    JsonDocumentBuilder b(text, *doc.arena_, repair, dup_count);
+    JsonNode root = b.parse_value();
+    b.p.skip_ws();
+    if (b.p.i != text.size()) throw std::runtime_error("JSON parse error: trailing data");
+    JsonNode* stored = doc.arena_->allocate_array<JsonNode>(1);
+    *stored = root;
+    doc.root_ = stored;
+  }
+};
+
+RepairMetadata loads_jsonish_into(JsonDocument& doc, const std::string& text, const RepairConfig& repair) {
+  auto [candidate, from_fence] = extract_json_candidate_with_meta(text);
+  RepairMetadata meta;
+  meta.extracted_from_fence = from_fence;
   try {
-    ValidateOptions opt;
-    validate_impl(value, schema, path, opt);
-    return true;
-  } catch (const ValidationError&) {
-    return false;
+    parse_candidate_with_repairs(std::move(candidate), repair, meta, [&](const std::string& t, int* dup_count) {
+      JsonDocumentBuilder::parse_into(doc, t, repair, dup_count);
+    });
+  } catch (...) {
+    doc.clear();
+    throw;
   }
+  return meta;
 }
 
-static void validate_impl(const Json& value, const Json& schema, const std::string& path, const ValidateOptions& opt) {
-  const auto& sch = require_object_schema(schema, path);
+// ---------------- Zero-copy views ----------------
 
-  // allOf / anyOf / oneOf
-  {
-    auto it_all = sch.find("allOf");
-    if (it_all != sch.end() && it_all->second.is_array()) {
-      for (const auto& sub : it_all->second.as_array()) {
-        if (!sub.is_object()) continue;
-        validate_impl(value, sub, path, opt);
+// Decodes a string body as Parser::parse_string_into does (same minimal escape set).
+static void unescape_json_string(std::string_view raw, std::string& out) {
+  out.clear();
+  out.reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i) {
+    char c = raw[i];
+    if (c != '\\' || i + 1 >= raw.size()) {
+      out.push_back(c);
+      continue;
+    }
+    out.push_back(unescape_json_char(raw[++i]));
+  }
+}
+
+// Scans one value with Parser's grammar, recording a tape entry per value instead of decoding it.
+struct JsonTapeBuilder {
+  static constexpr uint8_t kEscaped = 1;  // String flag: body contains escapes
+  static constexpr uint8_t kShadowed = 2;  // Key flag: member loses to a duplicate under the key policy
+  // Key flag (LastWins): a later duplicate's member is reported in this slot; `a` is that duplicate's key.
+  static constexpr uint8_t kReplaced = 4;
+
+  std::string_view s;
+  size_t i{0};
+  bool allow_single_quotes{true};
+  std::vector<JsonTape::Entry>& out;
+  // Duplicate keys are only looked for when set; the losing member's key is flagged kShadowed.
+  const RepairConfig::DuplicateKeyPolicy* duplicate_policy{nullptr};
+  int* duplicate_key_count{nullptr};
+  std::string key_a;
+  std::string key_b;
+  std::vector<size_t> live_keys;  // tape positions of the keys not shadowed so far, innermost object last
+
+  [[noreturn]] void fail(const std::string& msg) const { throw std::runtime_error("JSON parse error: " + msg); }
+
+  void skip_ws() {
+    while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+  }
+
+  bool consume(char c) {
+    skip_ws();
+    if (i < s.size() && s[i] == c) {
+      ++i;
+      return true;
+    }
+    return false;
+  }
+
+  void push(JsonView::Kind kind, uint8_t flags, size_t a, size_t b) {
+    out.push_back(JsonTape::Entry{kind, flags, static_cast<uint32_t>(a), static_cast<uint32_t>(b)});
+  }
+
+  void string() {
+    char q = s[i];
+    if (q == '\'' && !allow_single_quotes) fail("single-quoted strings are forbidden");
+    size_t start = ++i;
+    uint8_t escaped = 0;
+    while (i < s.size() && s[i] != q) {
+      if (s[i] == '\\') {
+        escaped = kEscaped;
+        ++i;
+      }
+      ++i;
+    }
+    if (i >= s.size()) fail("unterminated string");
+    push(JsonView::Kind::String, escaped, start, i - start);
+    ++i;
+  }
+
+  void number() {
+    size_t start = i;
+    if (s[i] == '-') ++i;
+    while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
+    uint8_t integral = 1;
+    if (i < s.size() && s[i] == '.') {
+      integral = 0;
+      ++i;
+      while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
+    }
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+      integral = 0;
+      ++i;
+      if (i < s.size() && (s[i] == '+' || s[i] == '-')) ++i;
+      while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) ++i;
+    }
+    push(JsonView::Kind::Number, integral, start, i - start);
+  }
+
+  void literal(std::string_view word, JsonView::Kind kind, uint8_t flags) {
+    if (s.substr(i, word.size()) != word) fail("expected " + std::string(word));
+    i += word.size();
+    push(kind, flags, 0, 0);
+  }
+
+  void value() {
+    skip_ws();
+    if (i >= s.size()) fail("unexpected end");
+    char c = s[i];
+    if (c == '{' || c == '[') {
+      const bool object = c == '{';
+      const char close = object ? '}' : ']';
+      size_t self = out.size();
+      push(object ? JsonView::Kind::Object : JsonView::Kind::Array, 0, 0, 0);
+      ++i;
+      size_t count = 0;
+      OpenKeys keys{live_keys.size(), {}};
+      skip_ws();
+      if (!consume(close)) {
+        while (true) {
+          if (object) {
+            skip_ws();
+            if (i >= s.size()) fail("unterminated object");
+            if (s[i] != '"' && s[i] != '\'') fail("expected string key");
+            string();
+            if (duplicate_policy && check_duplicate_key(keys)) --count;
+            if (!consume(':')) fail("expected :");
+          }
+          value();
+          ++count;
+          skip_ws();
+          if (consume(close)) break;
+          if (!consume(',')) fail(object ? "expected , or }" : "expected , or ]");
+        }
+      }
+      out[self].a = static_cast<uint32_t>(count);
+      out[self].b = static_cast<uint32_t>(out.size());
+      live_keys.resize(keys.base);
+      return;
+    }
+    if (c == '"' || c == '\'') return string();
+    if (c == 't') return literal("true", JsonView::Kind::Bool, 1);
+    if (c == 'f') return literal("false", JsonView::Kind::Bool, 0);
+    if (c == 'n') return literal("null", JsonView::Kind::Null, 0);
+    if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) return number();
+    fail(std::string("unexpected char '") + c + "'");
+  }
+
+  std::string_view key_text(size_t key, std::string& scratch) const {
+    const JsonTape::Entry& e = out[key].flags & kReplaced ? out[out[key].a] : out[key];
+    std::string_view raw = s.substr(e.a, e.b);
+    if (!(e.flags & kEscaped)) return raw;
+    unescape_json_string(raw, scratch);
+    return scratch;
+  }
+
+  // One open object's stretch of live_keys, from `base` on: searched linearly while the object is small and
+  // through a hash index past JsonObject::kIndexThreshold keys, as JsonObject does.
+  struct OpenKeys {
+    size_t base;
+    std::unordered_map<std::string, size_t> index;  // key text -> position in live_keys; empty while small
+  };
+
+  // Compares the key just pushed with the live keys of its object. Returns true when one of the two members
+  // is now shadowed.
+  bool check_duplicate_key(OpenKeys& keys) {
+    const size_t key = out.size() - 1;
+    const std::string_view k = key_text(key, key_a);
+    size_t slot = live_keys.size();
+    if (!keys.index.empty()) {
+      auto it = keys.index.find(std::string(k));
+      if (it != keys.index.end()) slot = it->second;
+    } else {
+      for (size_t j = keys.base; j < live_keys.size(); ++j) {
+        if (key_text(live_keys[j], key_b) == k) {
+          slot = j;
+          break;
+        }
       }
     }
 
-    auto it_any = sch.find("anyOf");
-    if (it_any != sch.end() && it_any->second.is_array()) {
-      bool ok = false;
-      for (const auto& sub : it_any->second.as_array()) {
-        if (!sub.is_object()) continue;
-        if (schema_passes(value, sub, path)) {
-          ok = true;
-          break;
-        }
-      }
-      if (!ok) {
-        if (!report_or_throw(opt, "does not match anyOf", path)) return;
-      }
-    }
+    if (slot == live_keys.size()) {
+      live_keys.push_back(key);
+      if (!keys.index.empty()) {
+        keys.index.emplace(std::string(k), slot);
+      } else if (live_keys.size() - keys.base > JsonObject::kIndexThreshold) {
+        keys.index.reserve((live_keys.size() - keys.base) * 2);
+        for (size_t j = keys.base; j < live_keys.size(); ++j) keys.index.emplace(std::string(key_text(live_keys[j], key_b)), j);
+      }
+      return false;
+    }
+    if (duplicate_key_count) ++*duplicate_key_count;
+    if (*duplicate_policy == RepairConfig::DuplicateKeyPolicy::Error) throw Parser::DuplicateKeyError{std::string(k)};
+    if (*duplicate_policy == RepairConfig::DuplicateKeyPolicy::LastWins) {
+      // The winner keeps the first occurrence's position, as in JsonObject; an earlier winner now loses.
+      JsonTape::Entry& first = out[live_keys[slot]];
+      if (first.flags & kReplaced) out[first.a].flags |= kShadowed;
+      first.flags |= kReplaced;
+      first.a = static_cast<uint32_t>(key);
+    }
+    out[key].flags |= kShadowed;
+    return true;
+  }
+
+  static void build(std::string_view text,
+                    bool allow_single_quotes,
+                    std::vector<JsonTape::Entry>& entries,
+                    const RepairConfig::DuplicateKeyPolicy* duplicate_policy = nullptr,
+                    int* duplicate_key_count = nullptr) {
+    if (text.size() > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("JSON parse error: input too large");
+    entries.clear();
+    JsonTapeBuilder b{text, 0, allow_single_quotes, entries, duplicate_policy, duplicate_key_count, {}, {}, {}};
+    b.value();
+    b.skip_ws();
+    if (b.i != text.size()) throw std::runtime_error("JSON parse error: trailing data");
+  }
+};
+
+JsonTape parse_json_tape(std::string_view json, bool allow_single_quotes) {
+  JsonTape tape;
+  tape.external_ = json;
+  try {
+    JsonTapeBuilder::build(json, allow_single_quotes, tape.entries_);
+  } catch (const std::exception& e) {
+    throw ValidationError(e.what(), "$", "parse");
+  }
+  return tape;
+}
+
+JsonTape loads_jsonish_tape(const std::string& text, const RepairConfig& repair) {
+  auto [candidate, from_fence] = extract_json_candidate_with_meta(text);
+  JsonTape tape;
+  tape.metadata_.extracted_from_fence = from_fence;
+  tape.owned_ = parse_candidate_with_repairs(std::move(candidate), repair, tape.metadata_, [&](const std::string& t, int* dup_count) {
+    JsonTapeBuilder::build(t, repair.allow_single_quotes, tape.entries_, &repair.duplicate_key_policy, dup_count);
+  });
+  tape.owns_text_ = true;
+  return tape;
+}
+
+JsonView::Kind JsonView::kind() const { return tape_->entries_[index_].kind; }
+
+bool JsonView::as_bool() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Bool) throw std::bad_variant_access();
+  return e.flags != 0;
+}
+
+double JsonView::as_number() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Number) throw std::bad_variant_access();
+  const char* p = tape_->text().data() + e.a;
+  return parse_number_token(p, p + e.b);
+}
+
+bool JsonView::is_int64() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Number || !e.flags) return false;
+  const char* p = tape_->text().data() + e.a;
+  int64_t n = 0;
+  auto res = std::from_chars(p, p + e.b, n);
+  return res.ec == std::errc() && res.ptr == p + e.b && !(n == 0 && *p == '-');
+}
+
+int64_t JsonView::as_int64() const {
+  if (!is_int64()) throw std::bad_variant_access();
+  const auto& e = tape_->entries_[index_];
+  const char* p = tape_->text().data() + e.a;
+  int64_t n = 0;
+  std::from_chars(p, p + e.b, n);
+  return n;
+}
+
+std::string_view JsonView::raw_string() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::String) throw std::bad_variant_access();
+  return tape_->text().substr(e.a, e.b);
+}
+
+std::string JsonView::as_string() const {
+  std::string_view raw = raw_string();
+  if (!(tape_->entries_[index_].flags & JsonTapeBuilder::kEscaped)) return std::string(raw);
+  std::string out;
+  unescape_json_string(raw, out);
+  return out;
+}
+
+size_t JsonView::size() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Array && e.kind != Kind::Object) throw std::bad_variant_access();
+  return e.a;
+}
+
+uint32_t JsonView::next_sibling() const {
+  const auto& e = tape_->entries_[index_];
+  return (e.kind == Kind::Array || e.kind == Kind::Object) ? e.b : index_ + 1;
+}
+
+JsonView JsonView::operator[](size_t index) const {
+  if (kind() != Kind::Array) throw std::bad_variant_access();
+  if (index >= size()) throw std::out_of_range("JsonView index out of range");
+  auto it = begin();
+  for (size_t k = 0; k < index; ++k) ++it;
+  return *it;
+}
+
+std::optional<JsonView> JsonView::find(std::string_view key) const {
+  if (kind() != Kind::Object) return std::nullopt;
+  std::string decoded;
+  for (auto it = begin(); it != end(); ++it) {
+    JsonView v = *it;
+    const auto& k = tape_->entries_[v.key_index_ - 1];
+    std::string_view raw = tape_->text().substr(k.a, k.b);
+    if (k.flags & JsonTapeBuilder::kEscaped) {
+      unescape_json_string(raw, decoded);
+      raw = decoded;
+    }
+    if (raw == key) return v;
+  }
+  return std::nullopt;
+}
+
+std::optional<JsonView> JsonView::at_path(std::string_view path) const {
+  std::optional<JsonView> cur = *this;
+  size_t i = (!path.empty() && path[0] == '$') ? 1 : 0;
+  bool first = true;
+  while (cur && i < path.size()) {
+    if (path[i] == '[') {
+      size_t close = path.find(']', i);
+      if (close == std::string_view::npos) return std::nullopt;
+      std::string_view inner = path.substr(i + 1, close - i - 1);
+      i = close + 1;
+      if (inner.size() >= 2 && (inner.front() == '"' || inner.front() == '\'') && inner.back() == inner.front()) {
+        cur = cur->find(inner.substr(1, inner.size() - 2));
+        continue;
+      }
+      size_t index = 0;
+      auto res = std::from_chars(inner.data(), inner.data() + inner.size(), index);
+      if (res.ec != std::errc() || res.ptr != inner.data() + inner.size()) return std::nullopt;
+      if (!cur->is_array() || index >= cur->size()) return std::nullopt;
+      cur = (*cur)[index];
+    } else {
+      if (path[i] == '.') {
+        ++i;
+      } else if (!first) {
+        return std::nullopt;
+      }
+      size_t end = path.find_first_of(".[", i);
+      if (end == std::string_view::npos) end = path.size();
+      cur = cur->find(path.substr(i, end - i));
+      i = end;
+    }
+    first = false;
+  }
+  return cur;
+}
+
+std::string_view JsonView::key() const {
+  if (key_index_ == 0) return {};
+  const auto& k = tape_->entries_[key_index_ - 1];
+  return tape_->text().substr(k.a, k.b);
+}
+
+JsonView::Iterator JsonView::begin() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Array && e.kind != Kind::Object) throw std::bad_variant_access();
+  return Iterator(tape_, index_ + 1, e.b, e.kind == Kind::Object);
+}
+
+JsonView::Iterator JsonView::end() const {
+  const auto& e = tape_->entries_[index_];
+  if (e.kind != Kind::Array && e.kind != Kind::Object) throw std::bad_variant_access();
+  return Iterator(tape_, e.b, e.b, e.kind == Kind::Object);
+}
+
+JsonView::Iterator::Iterator(const JsonTape* tape, uint32_t index, uint32_t end, bool object)
+    : tape_(tape), index_(index), end_(end), object_(object) {
+  skip_shadowed();
+}
+
+// Steps over members that lost to a duplicate key.
+void JsonView::Iterator::skip_shadowed() {
+  if (!object_) return;
+  while (index_ < end_ && (tape_->entries_[index_].flags & JsonTapeBuilder::kShadowed)) {
+    index_ = JsonView(tape_, index_ + 1, 0).next_sibling();
+  }
+}
+
+JsonView JsonView::Iterator::operator*() const {
+  if (!object_) return JsonView(tape_, index_, 0);
+  const auto& key = tape_->entries_[index_];
+  const uint32_t k = (key.flags & JsonTapeBuilder::kReplaced) ? key.a : index_;
+  return JsonView(tape_, k + 1, k + 1);
+}
+
+JsonView::Iterator& JsonView::Iterator::operator++() {
+  // Steps over the value stored in this slot, even when a later duplicate's is reported for it.
+  index_ = object_ ? JsonView(tape_, index_ + 1, 0).next_sibling() : JsonView(tape_, index_, 0).next_sibling();
+  skip_shadowed();
+  return *this;
+}
+
+Json JsonView::to_json() const {
+  switch (kind()) {
+    case Kind::Null:
+      return Json(nullptr);
+    case Kind::Bool:
+      return Json(as_bool());
+    case Kind::Number:
+      return is_int64() ? Json(as_int64()) : Json(as_number());
+    case Kind::String:
+      return Json(as_string());
+    case Kind::Array: {
+      JsonArray arr;
+      arr.reserve(size());
+      for (JsonView v : *this) arr.push_back(v.to_json());
+      return Json(std::move(arr));
+    }
+    case Kind::Object: {
+      JsonObject obj;
+      obj.reserve(size());
+      std::string key;
+      for (JsonView v : *this) {
+        std::string_view raw = v.key();
+        if (tape_->entries_[v.key_index_ - 1].flags & JsonTapeBuilder::kEscaped) {
+          unescape_json_string(raw, key);
+        } else {
+          key.assign(raw);
+        }
+        obj.emplace(key, v.to_json());
+      }
+      return Json(std::move(obj));
+    }
+  }
+  return Json();
+}
+
+// ---------------- SAX parsing ----------------
+
+// Emits events straight from text json_syntax_error() has accepted, so the grammar can't fail part-way.
+// Duplicate keys can only be FirstWins here (Error was rejected by the check): later ones are skipped
+// against a stack of the open objects' keys, searched as JsonTapeBuilder searches its live keys.
+struct JsonSaxScanner {
+  struct Key {
+    size_t start;
+    size_t size;
+    bool escaped;
+  };
+
+  Parser p;
+  JsonSaxHandler* handler;
+  int duplicate_key_count{0};
+  std::string scratch;
+  std::string key_a;
+  std::string key_b;
+  std::vector<Key> live_keys;  // innermost object last
+
+  std::string_view text_of(const Key& k, std::string& out) const {
+    std::string_view raw(p.s.data() + k.start, k.size);
+    if (!k.escaped) return raw;
+    unescape_json_string(raw, out);
+    return out;
+  }
+
+  // Steps over the string literal at the cursor and returns its body.
+  Key string() {
+    const size_t start = p.i + 1;
+    p.scan_string();
+    const size_t size = p.i - 1 - start;
+    return Key{start, size, std::memchr(p.s.data() + start, '\\', size) != nullptr};
+  }
+
+  // Reports the value at the cursor; false once the handler has asked to stop.
+  bool value() {
+    p.skip_ws();
+    const char c = p.s[p.i];
+    if (c == '{') return object();
+    if (c == '[') {
+      ++p.i;
+      if (!handler->on_array_start()) return false;
+      if (!p.consume(']')) {
+        do {
+          if (!value()) return false;
+        } while (!p.consume(']') && p.consume(','));
+      }
+      return handler->on_array_end();
+    }
+    if (c == '"' || c == '\'') return handler->on_string(text_of(string(), scratch));
+    if (c == 't') {
+      p.i += 4;
+      return handler->on_bool(true);
+    }
+    if (c == 'f') {
+      p.i += 5;
+      return handler->on_bool(false);
+    }
+    if (c == 'n') {
+      p.i += 4;
+      return handler->on_null();
+    }
+    const size_t start = p.i;
+    const bool integral = p.skip_number();
+    const char* first = p.s.data() + start;
+    const char* last = p.s.data() + p.i;
+    if (integral) {
+      int64_t n = 0;
+      auto res = std::from_chars(first, last, n);
+      if (res.ec == std::errc() && res.ptr == last && !(n == 0 && *first == '-')) return handler->on_integer(n);
+    }
+    return handler->on_number(parse_number_token(first, last));
+  }
+
+  bool object() {
+    ++p.i;
+    if (!handler->on_object_start()) return false;
+    const size_t base = live_keys.size();
+    std::unordered_set<std::string> index;  // key texts once the object outgrows linear search
+    if (!p.consume('}')) {
+      do {
+        p.skip_ws();
+        const Key key = string();
+        p.consume(':');
+        if (p.duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::FirstWins && is_duplicate(key, base, index)) {
+          // Scanned rather than skipped so duplicates inside it are counted, as the Json parser counts them.
+          ++duplicate_key_count;
+          static JsonSaxHandler ignore;
+          JsonSaxHandler* reporting = std::exchange(handler, &ignore);
+          value();
+          handler = reporting;
+        } else if (!handler->on_key(text_of(key, scratch)) || !value()) {
+          return false;
+        }
+      } while (!p.consume('}') && p.consume(','));
+    }
+    live_keys.resize(base);
+    return handler->on_object_end();
+  }
+
+  // Whether `key` repeats a key of the object whose keys start at live_keys[base]; records it when not.
+  bool is_duplicate(const Key& key, size_t base, std::unordered_set<std::string>& index) {
+    const std::string_view k = text_of(key, key_a);
+    if (!index.empty()) {
+      if (!index.emplace(k).second) return true;
+      live_keys.push_back(key);
+      return false;
+    }
+    for (size_t j = base; j < live_keys.size(); ++j) {
+      if (text_of(live_keys[j], key_b) == k) return true;
+    }
+    live_keys.push_back(key);
+    if (live_keys.size() - base > JsonObject::kIndexThreshold) {
+      index.reserve((live_keys.size() - base) * 2);
+      for (size_t j = base; j < live_keys.size(); ++j) index.emplace(text_of(live_keys[j], key_b));
+    }
+    return false;
+  }
+};
+
+// Walks a tape built with duplicate handling and reports it as handler events, skipping shadowed members.
+// Used for LastWins, where a member's winner is only known once its object closes.
+struct JsonSaxReplay {
+  std::string_view text;
+  const std::vector<JsonTape::Entry>& entries;
+  JsonSaxHandler& handler;
+  std::string scratch;
+
+  std::string_view string_at(const JsonTape::Entry& e) {
+    std::string_view raw = text.substr(e.a, e.b);
+    if (!(e.flags & JsonTapeBuilder::kEscaped)) return raw;
+    unescape_json_string(raw, scratch);
+    return scratch;
+  }
+
+  uint32_t next_sibling(uint32_t index) const {
+    const auto& e = entries[index];
+    return (e.kind == JsonView::Kind::Array || e.kind == JsonView::Kind::Object) ? e.b : index + 1;
+  }
+
+  // Reports the value at `index`; false once the handler has asked to stop.
+  bool value(uint32_t index) {
+    const auto& e = entries[index];
+    switch (e.kind) {
+      case JsonView::Kind::Null:
+        return handler.on_null();
+      case JsonView::Kind::Bool:
+        return handler.on_bool(e.flags != 0);
+      case JsonView::Kind::Number: {
+        const char* p = text.data() + e.a;
+        if (e.flags) {
+          int64_t n = 0;
+          auto res = std::from_chars(p, p + e.b, n);
+          if (res.ec == std::errc() && res.ptr == p + e.b && !(n == 0 && *p == '-')) return handler.on_integer(n);
+        }
+        return handler.on_number(parse_number_token(p, p + e.b));
+      }
+      case JsonView::Kind::String:
+        return handler.on_string(string_at(e));
+      case JsonView::Kind::Array:
+        if (!handler.on_array_start()) return false;
+        for (uint32_t j = index + 1; j < e.b; j = next_sibling(j)) {
+          if (!value(j)) return false;
+        }
+        return handler.on_array_end();
+      case JsonView::Kind::Object:
+        if (!handler.on_object_start()) return false;
+        for (uint32_t j = index + 1; j < e.b;) {
+          const auto& key = entries[j];
+          if (!(key.flags & JsonTapeBuilder::kShadowed)) {
+            const uint32_t k = (key.flags & JsonTapeBuilder::kReplaced) ? key.a : j;
+            if (!handler.on_key(string_at(entries[k]))) return false;
+            if (!value(k + 1)) return false;
+          }
+          j = next_sibling(j + 1);
+        }
+        return handler.on_object_end();
+    }
+    return true;
+  }
+
+  static void run(std::string candidate, JsonSaxHandler& handler, const RepairConfig& repair, RepairMetadata& meta) {
+    std::vector<JsonTape::Entry> entries;
+    std::string parsed = parse_candidate_with_repairs(std::move(candidate), repair, meta, [&](const std::string& t, int* dup_count) {
+      JsonTapeBuilder::build(t, repair.allow_single_quotes, entries, &repair.duplicate_key_policy, dup_count);
+    });
+    JsonSaxReplay replay{parsed, entries, handler, {}};
+    replay.value(0);
+  }
+};
+
+RepairMetadata parse_jsonish_sax(const std::string& text, JsonSaxHandler& handler, const RepairConfig& repair) {
+  auto [candidate, from_fence] = extract_json_candidate_with_meta(text);
+  RepairMetadata meta;
+  meta.extracted_from_fence = from_fence;
+  if (repair.duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::LastWins) {
+    JsonSaxReplay::run(std::move(candidate), handler, repair, meta);
+    return meta;
+  }
+  // Check (and if need be repair) before the first event, so no event is ever taken back.
+  const std::string checked = parse_candidate_with_repairs(std::move(candidate), repair, meta, [&](const std::string& t, int*) {
+    std::optional<std::string> duplicate;
+    if (std::optional<std::string> error = json_syntax_error(t, repair, duplicate)) {
+      if (duplicate) throw Parser::DuplicateKeyError{*duplicate};
+      throw std::runtime_error("JSON parse error: " + *error);
+    }
+  });
+  JsonSaxScanner scanner{Parser(checked, repair.allow_single_quotes, repair.duplicate_key_policy, nullptr), &handler};
+  scanner.value();
+  meta.duplicateKeyCount = scanner.duplicate_key_count;
+  return meta;
+}
+
+// ---------------- String formats ----------------
+
+// Single-pass, allocation-free checks for the string formats understood by schema validation and
+// schema inference. Each one accepts exactly the strings of its format and nothing else.
+
+static bool is_ascii_digit(char c) { return c >= '0' && c <= '9'; }
+static bool is_ascii_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+static bool is_ascii_alnum(char c) { return is_ascii_digit(c) || is_ascii_alpha(c); }
+static bool is_ascii_hex(char c) { return is_ascii_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+static bool is_format_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+// Reads exactly n digits at s[pos..pos+n) into out.
+static bool read_fixed_digits(std::string_view s, size_t pos, size_t n, int& out) {
+  if (pos + n > s.size()) return false;
+  int v = 0;
+  for (size_t i = pos; i < pos + n; ++i) {
+    if (!is_ascii_digit(s[i])) return false;
+    v = v * 10 + (s[i] - '0');
+  }
+  out = v;
+  return true;
+}
+
+// YYYY-MM-DD starting at pos; advances pos past it.
+static bool scan_full_date(std::string_view s, size_t& pos) {
+  int year = 0, month = 0, day = 0;
+  if (!read_fixed_digits(s, pos, 4, year)) return false;
+  if (pos + 4 >= s.size() || s[pos + 4] != '-') return false;
+  if (!read_fixed_digits(s, pos + 5, 2, month)) return false;
+  if (pos + 7 >= s.size() || s[pos + 7] != '-') return false;
+  if (!read_fixed_digits(s, pos + 8, 2, day)) return false;
+  if (month < 1 || month > 12 || day < 1) return false;
+  static const int kDaysInMonth[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (day > kDaysInMonth[month - 1]) return false;
+  if (month == 2 && day == 29) {
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (!leap) return false;
+  }
+  pos += 10;
+  return true;
+}
+
+// HH:MM:SS(.fraction)? starting at pos; advances pos past it.
+static bool scan_partial_time(std::string_view s, size_t& pos) {
+  int hour = 0, minute = 0, second = 0;
+  if (!read_fixed_digits(s, pos, 2, hour)) return false;
+  if (pos + 2 >= s.size() || s[pos + 2] != ':') return false;
+  if (!read_fixed_digits(s, pos + 3, 2, minute)) return false;
+  if (pos + 5 >= s.size() || s[pos + 5] != ':') return false;
+  if (!read_fixed_digits(s, pos + 6, 2, second)) return false;
+  if (hour > 23 || minute > 59 || second > 60) return false;
+  pos += 8;
+  if (pos < s.size() && s[pos] == '.') {
+    size_t start = ++pos;
+    while (pos < s.size() && is_ascii_digit(s[pos])) ++pos;
+    if (pos == start) return false;
+  }
+  return true;
+}
+
+// Z | +HH:MM | -HH:MM starting at pos; advances pos past it.
+static bool scan_time_offset(std::string_view s, size_t& pos) {
+  if (pos >= s.size()) return false;
+  if (s[pos] == 'Z') {
+    ++pos;
+    return true;
+  }
+  if (s[pos] != '+' && s[pos] != '-') return false;
+  int hour = 0, minute = 0;
+  if (!read_fixed_digits(s, pos + 1, 2, hour)) return false;
+  if (pos + 3 >= s.size() || s[pos + 3] != ':') return false;
+  if (!read_fixed_digits(s, pos + 4, 2, minute)) return false;
+  if (hour > 23 || minute > 59) return false;
+  pos += 6;
+  return true;
+}
+
+// RFC 3339 date-time; the offset is required.
+static bool is_date_time_format(std::string_view s) {
+  size_t pos = 0;
+  if (!scan_full_date(s, pos)) return false;
+  if (pos >= s.size() || s[pos] != 'T') return false;
+  ++pos;
+  return scan_partial_time(s, pos) && scan_time_offset(s, pos) && pos == s.size();
+}
+
+static bool is_date_format(std::string_view s) {
+  size_t pos = 0;
+  return scan_full_date(s, pos) && pos == s.size();
+}
+
+// HH:MM:SS(.fraction)? with an optional offset.
+static bool is_time_format(std::string_view s) {
+  size_t pos = 0;
+  if (!scan_partial_time(s, pos)) return false;
+  if (pos == s.size()) return true;
+  return scan_time_offset(s, pos) && pos == s.size();
+}
+
+// local@domain.tld: one '@', no whitespace, non-empty local part, and a '.' inside the domain
+// with at least one character on each side.
+static bool is_email_format(std::string_view s) {
+  size_t at = std::string_view::npos;
+  for (size_t i = 0; i < s.size(); ++i) {
+    char c = s[i];
+    if (is_format_space(c)) return false;
+    if (c == '@') {
+      if (at != std::string_view::npos) return false;
+      at = i;
+    }
+  }
+  if (at == std::string_view::npos || at == 0) return false;
+  const size_t domain = at + 1;
+  for (size_t i = domain + 1; i + 1 < s.size(); ++i) {
+    if (s[i] == '.') return true;
+  }
+  return false;
+}
+
+static bool is_uuid_format(std::string_view s) {
+  if (s.size() != 36) return false;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (i == 8 || i == 13 || i == 18 || i == 23) {
+      if (s[i] != '-') return false;
+    } else if (!is_ascii_hex(s[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Dotted quad of decimal octets 0-255 without leading zeros.
+static bool is_ipv4_format(std::string_view s) {
+  size_t pos = 0;
+  for (int part = 0; part < 4; ++part) {
+    if (part > 0) {
+      if (pos >= s.size() || s[pos] != '.') return false;
+      ++pos;
+    }
+    size_t start = pos;
+    int v = 0;
+    while (pos < s.size() && is_ascii_digit(s[pos]) && pos - start < 3) {
+      v = v * 10 + (s[pos] - '0');
+      ++pos;
+    }
+    size_t len = pos - start;
+    if (len == 0 || v > 255 || (len > 1 && s[start] == '0')) return false;
+  }
+  return pos == s.size();
+}
+
+// RFC 1123 hostname: dot-separated labels of 1-63 alphanumerics/hyphens that do not start or end
+// with a hyphen, 253 characters at most.
+static bool is_hostname_format(std::string_view s) {
+  if (s.empty() || s.size() > 253) return false;
+  size_t label_len = 0;
+  char prev = '.';
+  for (char c : s) {
+    if (c == '.') {
+      if (label_len == 0 || prev == '-') return false;
+      label_len = 0;
+    } else if (is_ascii_alnum(c) || c == '-') {
+      if (label_len == 0 && c == '-') return false;
+      if (++label_len > 63) return false;
+    } else {
+      return false;
+    }
+    prev = c;
+  }
+  return label_len > 0 && prev != '-';
+}
+
+// Absolute URI: scheme ":" followed by a non-empty remainder without whitespace or control characters.
+static bool is_uri_format(std::string_view s) {
+  if (s.empty() || !is_ascii_alpha(s[0])) return false;
+  size_t pos = 1;
+  while (pos < s.size() && (is_ascii_alnum(s[pos]) || s[pos] == '+' || s[pos] == '-' || s[pos] == '.')) ++pos;
+  if (pos >= s.size() || s[pos] != ':') return false;
+  ++pos;
+  if (pos == s.size()) return false;
+  for (; pos < s.size(); ++pos) {
+    unsigned char c = static_cast<unsigned char>(s[pos]);
+    if (c <= 0x20 || c == 0x7f) return false;
+  }
+  return true;
+}
+
+enum class StringFormat { Unknown, Email, Uuid, DateTime, Date, Time, Ipv4, Uri, Hostname };
+
+static bool equals_ascii_ci(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != static_cast<unsigned char>(b[i])) return false;
+  }
+  return true;
+}
+
+static StringFormat string_format_from_name(std::string_view name) {
+  if (equals_ascii_ci(name, "email")) return StringFormat::Email;
+  if (equals_ascii_ci(name, "uuid")) return StringFormat::Uuid;
+  if (equals_ascii_ci(name, "date-time")) return StringFormat::DateTime;
+  if (equals_ascii_ci(name, "date")) return StringFormat::Date;
+  if (equals_ascii_ci(name, "time")) return StringFormat::Time;
+  if (equals_ascii_ci(name, "ipv4")) return StringFormat::Ipv4;
+  if (equals_ascii_ci(name, "uri")) return StringFormat::Uri;
+  if (equals_ascii_ci(name, "hostname")) return StringFormat::Hostname;
+  return StringFormat::Unknown;
+}
+
+static const char* string_format_name(StringFormat f) {
+  switch (f) {
+    case StringFormat::Email: return "email";
+    case StringFormat::Uuid: return "uuid";
+    case StringFormat::DateTime: return "date-time";
+    case StringFormat::Date: return "date";
+    case StringFormat::Time: return "time";
+    case StringFormat::Ipv4: return "ipv4";
+    case StringFormat::Uri: return "uri";
+    case StringFormat::Hostname: return "hostname";
+    case StringFormat::Unknown: break;
+  }
+  return "";
+}
+
+static bool matches_string_format(StringFormat f, std::string_view s) {
+  switch (f) {
+    case StringFormat::Email: return is_email_format(s);
+    case StringFormat::Uuid: return is_uuid_format(s);
+    case StringFormat::DateTime: return is_date_time_format(s);
+    case StringFormat::Date: return is_date_format(s);
+    case StringFormat::Time: return is_time_format(s);
+    case StringFormat::Ipv4: return is_ipv4_format(s);
+    case StringFormat::Uri: return is_uri_format(s);
+    case StringFormat::Hostname: return is_hostname_format(s);
+    case StringFormat::Unknown: break;
+  }
+  return true;
+}
+
+bool matches_string_format(const std::string& format, const std::string& s) {
+  return matches_string_format(string_format_from_name(format), s);
+}
+
+// ---------------- JSON schema validation (subset) ----------------
+
+static std::optional<std::string> get_string_field(const JsonObject& obj, const std::string& key) {
+  auto it = obj.find(key);
+  if (it == obj.end()) return std::nullopt;
+  if (!it->second.is_string()) return std::nullopt;
+  return it->second.as_string();
+}
+
+static std::optional<double> get_number_field(const JsonObject& obj, const std::string& key) {
+  auto it = obj.find(key);
+  if (it == obj.end()) return std::nullopt;
+  if (!it->second.is_number()) return std::nullopt;
+  return it->second.as_number();
+}
+
+static const JsonObject& require_object_schema(const Json& schema, const std::string& path) {
+  if (!schema.is_object()) throw ValidationError("schema must be object", path);
+  return schema.as_object();
+}
+
+// ---------------- Pattern regex engine ----------------
+
+// Thompson-NFA matcher for the ECMAScript subset JSON Schema patterns normally use: literals, escapes,
+// classes, '.', ^/$, \b/\B, groups, alternation and greedy/lazy quantifiers. search() simulates every
+// NFA state in lockstep, so it runs in O(n*m) time with no backtracking and no recursion on the input.
+// Anything outside the subset (backreferences, lookaround, named groups, POSIX classes, odd escapes)
+// is rejected at compile time so the caller can fall back to std::regex, which also decides validity.
+
+static constexpr size_t kNfaMaxInstructions = 20000;
+static constexpr int kNfaMaxRepeat = 1000;
+static constexpr int kNfaMaxDepth = 200;
+
+struct NfaProgram {
+  enum class Op : uint8_t { Class, Split, Jmp, Match, LineBegin, LineEnd, WordBoundary, NotWordBoundary };
+  struct Inst {
+    Op op;
+    int x;  // Class: class index; Split/Jmp: first target
+    int y;  // Split: second target
+  };
+  std::vector<Inst> code;
+  std::vector<std::bitset<256>> classes;
+  bool anchored{false};
+
+  bool search(std::string_view s) const;
+};
+
+struct RegexUnsupported {};
+
+struct RegexNode {
+  enum class Kind { Empty, Class, Concat, Alt, Repeat, Assert };
+  Kind kind{Kind::Empty};
+  int cls{-1};
+  NfaProgram::Op assertion{NfaProgram::Op::Match};
+  int min{0};
+  int max{-1};  // -1 = unbounded
+  std::vector<RegexNode> children;
+};
+
+static bool is_regex_word_byte(unsigned char c) { return is_ascii_alnum(static_cast<char>(c)) || c == '_'; }
+
+struct RegexSubsetParser {
+  std::string_view p;
+  size_t i{0};
+  NfaProgram& prog;
+  int single_class[256];
+
+  RegexSubsetParser(std::string_view pattern, NfaProgram& program) : p(pattern), prog(program) {
+    std::fill(std::begin(single_class), std::end(single_class), -1);
+  }
+
+  bool at_end() const { return i >= p.size(); }
+  unsigned char peek() const { return static_cast<unsigned char>(p[i]); }
+
+  int add_class(const std::bitset<256>& set) {
+    prog.classes.push_back(set);
+    return static_cast<int>(prog.classes.size() - 1);
+  }
+
+  int byte_class(unsigned char c) {
+    if (single_class[c] < 0) {
+      std::bitset<256> set;
+      set.set(c);
+      single_class[c] = add_class(set);
+    }
+    return single_class[c];
+  }
+
+  static RegexNode class_node(int cls) {
+    RegexNode n;
+    n.kind = RegexNode::Kind::Class;
+    n.cls = cls;
+    return n;
+  }
+
+  static RegexNode assert_node(NfaProgram::Op op) {
+    RegexNode n;
+    n.kind = RegexNode::Kind::Assert;
+    n.assertion = op;
+    return n;
+  }
+
+  // \d \w \s and their negations; false when c is not a class escape.
+  static bool class_escape(unsigned char c, std::bitset<256>& set) {
+    std::bitset<256> base;
+    switch (c) {
+      case 'd': case 'D':
+        for (int b = '0'; b <= '9'; ++b) base.set(b);
+        break;
+      case 'w': case 'W':
+        for (int b = 0; b < 256; ++b) if (is_regex_word_byte(static_cast<unsigned char>(b))) base.set(b);
+        break;
+      case 's': case 'S':
+        for (unsigned char b : {' ', '\t', '\n', '\v', '\f', '\r'}) base.set(b);
+        break;
+      default:
+        return false;
+    }
+    if (c == 'D' || c == 'W' || c == 'S') base.flip();
+    set |= base;
+    return true;
+  }
+
+  int hex_digits(size_t count) {
+    if (i + count > p.size()) throw RegexUnsupported{};
+    int v = 0;
+    for (size_t k = 0; k < count; ++k) {
+      char c = p[i++];
+      if (!is_ascii_hex(c)) throw RegexUnsupported{};
+      v = v * 16 + (is_ascii_digit(c) ? c - '0' : (std::tolower(static_cast<unsigned char>(c)) - 'a' + 10));
+    }
+    return v;
+  }
+
+  // Single-byte escape after '\' (the backslash is already consumed).
+  unsigned char byte_escape(unsigned char c, bool in_class) {
+    switch (c) {
+      case 't': return '\t';
+      case 'n': return '\n';
+      case 'v': return '\v';
+      case 'f': return '\f';
+      case 'r': return '\r';
+      case 'b':
+        if (in_class) return '\b';
+        break;
+      case '0':
+        if (at_end() || !is_ascii_digit(p[i])) return '\0';
+        break;
+      case 'x':
+        return static_cast<unsigned char>(hex_digits(2));
+      case 'u': {
+        int v = hex_digits(4);
+        if (v > 0x7f) break;
+        return static_cast<unsigned char>(v);
+      }
+      default:
+        if (c < 0x80 && !is_ascii_alnum(static_cast<char>(c))) return c;
+        break;
+    }
+    throw RegexUnsupported{};
+  }
+
+  RegexNode parse() {
+    RegexNode n = parse_alt(0);
+    if (!at_end()) throw RegexUnsupported{};
+    return n;
+  }
+
+  RegexNode parse_alt(int depth) {
+    if (depth > kNfaMaxDepth) throw RegexUnsupported{};
+    RegexNode first = parse_concat(depth);
+    if (at_end() || peek() != '|') return first;
+    RegexNode alt;
+    alt.kind = RegexNode::Kind::Alt;
+    alt.children.push_back(std::move(first));
+    while (!at_end() && peek() == '|') {
+      ++i;
+      alt.children.push_back(parse_concat(depth));
+    }
+    return alt;
+  }
+
+  RegexNode parse_concat(int depth) {
+    RegexNode cat;
+    cat.kind = RegexNode::Kind::Concat;
+    while (!at_end() && peek() != '|' && peek() != ')') {
+      cat.children.push_back(parse_repeat(depth));
+    }
+    return cat;
+  }
+
+  RegexNode parse_repeat(int depth) {
+    RegexNode atom = parse_atom(depth);
+    if (at_end()) return atom;
+    int mn = 0;
+    int mx = -1;
+    unsigned char c = peek();
+    if (c == '*') {
+      ++i;
+    } else if (c == '+') {
+      ++i;
+      mn = 1;
+    } else if (c == '?') {
+      ++i;
+      mx = 1;
+    } else if (c == '{') {
+      ++i;
+      mn = parse_count();
+      mx = mn;
+      if (!at_end() && peek() == ',') {
+        ++i;
+        mx = (!at_end() && peek() == '}') ? -1 : parse_count();
+      }
+      if (at_end() || peek() != '}') throw RegexUnsupported{};
+      ++i;
+      if (mx >= 0 && mx < mn) throw RegexUnsupported{};
+    } else {
+      return atom;
+    }
+    if (atom.kind == RegexNode::Kind::Assert) throw RegexUnsupported{};
+    if (!at_end() && peek() == '?') ++i;  // lazy: irrelevant for a yes/no search
+    if (!at_end() && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{')) throw RegexUnsupported{};
+
+    RegexNode rep;
+    rep.kind = RegexNode::Kind::Repeat;
+    rep.min = mn;
+    rep.max = mx;
+    rep.children.push_back(std::move(atom));
+    return rep;
+  }
+
+  int parse_count() {
+    size_t start = i;
+    int v = 0;
+    while (!at_end() && is_ascii_digit(p[i])) {
+      v = v * 10 + (p[i] - '0');
+      if (v > kNfaMaxRepeat) throw RegexUnsupported{};
+      ++i;
+    }
+    if (i == start) throw RegexUnsupported{};
+    return v;
+  }
+
+  RegexNode parse_atom(int depth) {
+    unsigned char c = peek();
+    ++i;
+    switch (c) {
+      case '(': {
+        if (!at_end() && peek() == '?') {
+          if (i + 1 >= p.size() || p[i + 1] != ':') throw RegexUnsupported{};
+          i += 2;
+        }
+        RegexNode inner = parse_alt(depth + 1);
+        if (at_end() || peek() != ')') throw RegexUnsupported{};
+        ++i;
+        return inner;
+      }
+      case '[':
+        return class_node(parse_class());
+      case '.': {
+        std::bitset<256> set;
+        set.set();
+        set.reset('\n');
+        set.reset('\r');
+        return class_node(add_class(set));
+      }
+      case '^':
+        return assert_node(NfaProgram::Op::LineBegin);
+      case '$':
+        return assert_node(NfaProgram::Op::LineEnd);
+      case '\\': {
+        if (at_end()) throw RegexUnsupported{};
+        unsigned char e = peek();
+        ++i;
+        if (e == 'b') return assert_node(NfaProgram::Op::WordBoundary);
+        if (e == 'B') return assert_node(NfaProgram::Op::NotWordBoundary);
+        std::bitset<256> set;
+        if (class_escape(e, set)) return class_node(add_class(set));
+        return class_node(byte_class(byte_escape(e, false)));
+      }
+      case '*': case '+': case '?': case '{': case '}': case ']': case ')': case '|':
+        throw RegexUnsupported{};
+      default:
+        return class_node(byte_class(c));
+    }
+  }
+
+  // One class member: a byte (returned) or a class escape (merged into set, returns -1).
+  int parse_class_member(std::bitset<256>& set) {
+    unsigned char c = peek();
+    ++i;
+    if (c == '[' && !at_end() && (peek() == ':' || peek() == '.' || peek() == '=')) throw RegexUnsupported{};
+    if (c != '\\') return c;
+    if (at_end()) throw RegexUnsupported{};
+    unsigned char e = peek();
+    ++i;
+    if (class_escape(e, set)) return -1;
+    return byte_escape(e, true);
+  }
+
+  int parse_class() {
+    std::bitset<256> set;
+    bool negate = false;
+    if (!at_end() && peek() == '^') {
+      negate = true;
+      ++i;
+    }
+    if (!at_end() && peek() == ']') throw RegexUnsupported{};
+    while (true) {
+      if (at_end()) throw RegexUnsupported{};
+      if (peek() == ']') {
+        ++i;
+        break;
+      }
+      int lo = parse_class_member(set);
+      if (i + 1 < p.size() && p[i] == '-' && p[i + 1] != ']') {
+        ++i;
+        int hi = parse_class_member(set);
+        if (lo < 0 || hi < 0 || hi < lo) throw RegexUnsupported{};
+        for (int b = lo; b <= hi; ++b) set.set(b);
+      } else if (lo >= 0) {
+        set.set(lo);
+      }
+    }
+    if (negate) set.flip();
+    return add_class(set);
+  }
+};
+
+static int nfa_emit(NfaProgram& prog, NfaProgram::Op op, int x = 0, int y = 0) {
+  if (prog.code.size() >= kNfaMaxInstructions) throw RegexUnsupported{};
+  prog.code.push_back({op, x, y});
+  return static_cast<int>(prog.code.size() - 1);
+}
+
+static int nfa_pc(const NfaProgram& prog) { return static_cast<int>(prog.code.size()); }
+
+static void nfa_compile_node(NfaProgram& prog, const RegexNode& n) {
+  using Op = NfaProgram::Op;
+  switch (n.kind) {
+    case RegexNode::Kind::Empty:
+      break;
+    case RegexNode::Kind::Class:
+      nfa_emit(prog, Op::Class, n.cls);
+      break;
+    case RegexNode::Kind::Assert:
+      nfa_emit(prog, n.assertion);
+      break;
+    case RegexNode::Kind::Concat:
+      for (const auto& child : n.children) nfa_compile_node(prog, child);
+      break;
+    case RegexNode::Kind::Alt: {
+      std::vector<int> exits;
+      for (size_t k = 0; k + 1 < n.children.size(); ++k) {
+        int split = nfa_emit(prog, Op::Split, nfa_pc(prog) + 1);
+        nfa_compile_node(prog, n.children[k]);
+        exits.push_back(nfa_emit(prog, Op::Jmp));
+        prog.code[split].y = nfa_pc(prog);
+      }
+      nfa_compile_node(prog, n.children.back());
+      for (int pc : exits) prog.code[pc].x = nfa_pc(prog);
+      break;
+    }
+    case RegexNode::Kind::Repeat: {
+      const RegexNode& body = n.children.front();
+      for (int k = 0; k < n.min; ++k) nfa_compile_node(prog, body);
+      if (n.max < 0) {
+        int loop = nfa_emit(prog, Op::Split, nfa_pc(prog) + 1);
+        nfa_compile_node(prog, body);
+        nfa_emit(prog, Op::Jmp, loop);
+        prog.code[loop].y = nfa_pc(prog);
+      } else {
+        std::vector<int> splits;
+        for (int k = n.min; k < n.max; ++k) {
+          splits.push_back(nfa_emit(prog, Op::Split, nfa_pc(prog) + 1));
+          nfa_compile_node(prog, body);
+        }
+        for (int pc : splits) prog.code[pc].y = nfa_pc(prog);
+      }
+      break;
+    }
+  }
+}
+
+// Returns nullopt when the pattern is outside the supported subset.
+static std::optional<NfaProgram> compile_nfa_program(std::string_view pattern) {
+  NfaProgram prog;
+  try {
+    RegexSubsetParser parser(pattern, prog);
+    RegexNode root = parser.parse();
+    const RegexNode* first = &root;
+    while (first->kind == RegexNode::Kind::Concat && !first->children.empty()) first = &first->children.front();
+    prog.anchored = first->kind == RegexNode::Kind::Assert && first->assertion == NfaProgram::Op::LineBegin;
+    nfa_compile_node(prog, root);
+    nfa_emit(prog, NfaProgram::Op::Match);
+  } catch (const RegexUnsupported&) {
+    return std::nullopt;
+  }
+  return prog;
+}
+
+bool NfaProgram::search(std::string_view s) const {
+  // Per-thread scratch so repeated searches do not allocate.
+  thread_local std::vector<int> clist;
+  thread_local std::vector<int> nlist;
+  thread_local std::vector<int> stack;
+  thread_local std::vector<size_t> mark;
+  mark.assign(code.size(), std::numeric_limits<size_t>::max());
+  clist.clear();
+
+  auto word_at = [&](size_t pos) { return pos < s.size() && is_regex_word_byte(static_cast<unsigned char>(s[pos])); };
+
+  // Follows Jmp/Split/assertions from pc at input position pos; returns true on reaching Match.
+  auto add_thread = [&](std::vector<int>& list, int start, size_t pos) {
+    stack.clear();
+    stack.push_back(start);
+    while (!stack.empty()) {
+      int pc = stack.back();
+      stack.pop_back();
+      if (mark[pc] == pos) continue;
+      mark[pc] = pos;
+      const Inst& in = code[pc];
+      switch (in.op) {
+        case Op::Match:
+          return true;
+        case Op::Class:
+          list.push_back(pc);
+          break;
+        case Op::Jmp:
+          stack.push_back(in.x);
+          break;
+        case Op::Split:
+          stack.push_back(in.y);
+          stack.push_back(in.x);
+          break;
+        case Op::LineBegin:
+          if (pos == 0) stack.push_back(pc + 1);
+          break;
+        case Op::LineEnd:
+          if (pos == s.size()) stack.push_back(pc + 1);
+          break;
+        case Op::WordBoundary:
+        case Op::NotWordBoundary: {
+          bool boundary = (pos > 0 && word_at(pos - 1)) != word_at(pos);
+          if (boundary == (in.op == Op::WordBoundary)) stack.push_back(pc + 1);
+          break;
+        }
+      }
+    }
+    return false;
+  };
+
+  for (size_t pos = 0;; ++pos) {
+    if (pos == 0 || !anchored) {
+      if (add_thread(clist, 0, pos)) return true;
+    }
+    if (pos == s.size() || (anchored && clist.empty())) return false;
+    nlist.clear();
+    const unsigned char c = static_cast<unsigned char>(s[pos]);
+    for (int pc : clist) {
+      if (classes[code[pc].x].test(c) && add_thread(nlist, pc + 1, pos + 1)) return true;
+    }
+    clist.swap(nlist);
+  }
+}
+
+// ---------------- Pattern regex cache ----------------
+
+// A compiled schema `pattern`: the linear-time NFA when the pattern fits its subset, otherwise std::regex
+// (unless that fallback is disabled, in which case the pattern is reported as unsupported).
+struct PatternMatcher {
+  std::optional<NfaProgram> nfa;
+  std::optional<std::regex> fallback;
+
+  bool supported() const { return nfa || fallback; }
+  bool search(const std::string& s) const { return nfa ? nfa->search(s) : std::regex_search(s, *fallback); }
+};
+
+// Compiled patterns shared by every schema, keyed by pattern text. Patterns std::regex rejects are cached
+// as null so they are not recompiled either. The cache is cleared when it reaches kRegexCacheMaxEntries.
+static constexpr size_t kRegexCacheMaxEntries = 1024;
+
+struct RegexCache {
+  std::mutex mu;
+  std::unordered_map<std::string, std::shared_ptr<const PatternMatcher>> entries;
+  size_t hits{0};
+  size_t misses{0};
+  size_t fallbacks{0};
+  bool allow_fallback{true};
+};
+
+static RegexCache& regex_cache() {
+  static RegexCache cache;
+  return cache;
+}
+
+static std::shared_ptr<const PatternMatcher> cached_pattern_regex(const std::string& pattern) {
+  RegexCache& cache = regex_cache();
+  bool allow_fallback = true;
+  {
+    std::lock_guard<std::mutex> lock(cache.mu);
+    auto it = cache.entries.find(pattern);
+    if (it != cache.entries.end()) {
+      cache.hits++;
+      return it->second;
+    }
+    cache.misses++;
+    allow_fallback = cache.allow_fallback;
+  }
+
+  // Compile outside the lock; a concurrent miss on the same pattern just compiles it twice.
+  auto matcher = std::make_shared<PatternMatcher>();
+  matcher->nfa = compile_nfa_program(pattern);
+  bool used_fallback = false;
+  if (!matcher->nfa && allow_fallback) {
+    try {
+      matcher->fallback.emplace(pattern, std::regex::ECMAScript);
+      used_fallback = true;
+    } catch (const std::regex_error&) {
+      matcher.reset();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(cache.mu);
+  if (cache.entries.size() >= kRegexCacheMaxEntries) cache.entries.clear();
+  if (used_fallback) cache.fallbacks++;
+  cache.entries.emplace(pattern, matcher);
+  return matcher;
+}
+
+void set_pattern_regex_fallback(bool enabled) {
+  RegexCache& cache = regex_cache();
+  std::lock_guard<std::mutex> lock(cache.mu);
+  if (cache.allow_fallback == enabled) return;
+  cache.allow_fallback = enabled;
+  cache.entries.clear();
+}
+
+bool pattern_regex_fallback() {
+  RegexCache& cache = regex_cache();
+  std::lock_guard<std::mutex> lock(cache.mu);
+  return cache.allow_fallback;
+}
+
+RegexCacheStats regex_cache_stats() {
+  RegexCache& cache = regex_cache();
+  std::lock_guard<std::mutex> lock(cache.mu);
+  RegexCacheStats out;
+  out.hits = cache.hits;
+  out.misses = cache.misses;
+  out.fallbacks = cache.fallbacks;
+  out.size = cache.entries.size();
+  return out;
+}
+
+void clear_regex_cache() {
+  RegexCache& cache = regex_cache();
+  std::lock_guard<std::mutex> lock(cache.mu);
+  cache.entries.clear();
+  cache.hits = 0;
+  cache.misses = 0;
+  cache.fallbacks = 0;
+}
+
+// ---------------- Discriminated unions ----------------
+
+// Index from a discriminator property's value to the anyOf/oneOf branches that pin it with const/enum.
+// A branch pinned to other values can never match an object carrying this value, so only the branches
+// pinned to the value plus the unpinned ones need to be tried.
+struct DiscriminatorIndex {
+  std::string property;
+  std::unordered_map<Json, std::vector<size_t>> by_value;  // discriminator value -> branch indices
+  std::vector<size_t> unpinned;                            // branches without const/enum on property
+
+  // Branches pinned to value's discriminator (possibly none), or null when value is not an object with the
+  // property and every branch must be tried.
+  const std::vector<size_t>* pinned_for(const Json& value) const {
+    static const std::vector<size_t> kNone;
+    if (!value.is_object()) return nullptr;
+    const auto& obj = value.as_object();
+    auto it = obj.find(property);
+    if (it == obj.end()) return nullptr;
+    auto hit = by_value.find(it->second);
+    return hit == by_value.end() ? &kNone : &hit->second;
+  }
+
+  // Branches worth trying for value, in branch order; nullopt when every branch must be tried.
+  std::optional<std::vector<size_t>> candidates(const Json& value) const {
+    const std::vector<size_t>* pinned = pinned_for(value);
+    if (!pinned) return std::nullopt;
+    std::vector<size_t> out;
+    out.reserve(pinned->size() + unpinned.size());
+    std::merge(pinned->begin(), pinned->end(), unpinned.begin(), unpinned.end(), std::back_inserter(out));
+    return out;
+  }
+};
+
+// True when branch pins property with const or enum; appends the pinned values to out if given.
+static bool discriminator_pin(const Json& branch, const std::string& property, std::vector<const Json*>* out) {
+  if (!branch.is_object()) return false;
+  const auto& b = branch.as_object();
+  auto props = b.find("properties");
+  if (props == b.end() || !props->second.is_object()) return false;
+  auto prop = props->second.as_object().find(property);
+  if (prop == props->second.as_object().end() || !prop->second.is_object()) return false;
+  const auto& ps = prop->second.as_object();
+  if (auto c = ps.find("const"); c != ps.end()) {
+    if (out) out->push_back(&c->second);
+    return true;
+  }
+  if (auto e = ps.find("enum"); e != ps.end() && e->second.is_array()) {
+    if (out) {
+      for (const auto& v : e->second.as_array()) out->push_back(&v);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Uses the schema's `discriminator` keyword ("prop" or {"propertyName": "prop"}) when present, otherwise
+// the property pinned by the most branches (at least two).
+static std::optional<DiscriminatorIndex> build_discriminator_index(const JsonObject& schema, const JsonArray& branches) {
+  std::optional<std::string> property;
+  if (auto it = schema.find("discriminator"); it != schema.end()) {
+    if (it->second.is_string()) {
+      property = it->second.as_string();
+    } else if (it->second.is_object()) {
+      property = get_string_field(it->second.as_object(), "propertyName");
+    }
+  }
+  if (!property) {
+    std::map<std::string, size_t> pins;
+    for (const auto& branch : branches) {
+      if (!branch.is_object()) continue;
+      auto props = branch.as_object().find("properties");
+      if (props == branch.as_object().end() || !props->second.is_object()) continue;
+      for (const auto& kv : props->second.as_object()) {
+        if (discriminator_pin(branch, kv.first, nullptr)) pins[kv.first]++;
+      }
+    }
+    size_t best = 1;
+    for (const auto& kv : pins) {
+      if (kv.second > best) {
+        best = kv.second;
+        property = kv.first;
+      }
+    }
+  }
+  if (!property) return std::nullopt;
+
+  DiscriminatorIndex index;
+  index.property = *property;
+  std::vector<const Json*> values;
+  for (size_t i = 0; i < branches.size(); ++i) {
+    values.clear();
+    if (!discriminator_pin(branches[i], index.property, &values)) {
+      index.unpinned.push_back(i);
+      continue;
+    }
+    for (const auto& v : values) {
+      auto& slot = index.by_value[*v];
+      if (slot.empty() || slot.back() != i) slot.push_back(i);
+    }
+  }
+  if (index.by_value.empty()) return std::nullopt;
+  return index;
+}
+
+// ---------------- Compiled schema nodes ----------------
+
+enum class SchemaType { None, Null, Boolean, Number, Integer, String, Array, Object, Other };
+enum class AdditionalMode { Allow, Forbid, Schema };
+
+struct SchemaNode;
+
+// anyOf/oneOf branches, aligned with the source array (null for non-object entries, which are skipped).
+struct SchemaBranches {
+  bool present{false};
+  std::vector<const SchemaNode*> nodes;
+  std::optional<DiscriminatorIndex> index;
+};
+
+// One schema object with every keyword looked up, type-checked and converted ahead of time.
+// Strings point into the source Json, which must outlive the node.
+struct SchemaNode {
+  // Non-object schemas compile to an invalid node, which fails with "schema must be object" when applied.
+  bool valid{true};
+
+  std::vector<const SchemaNode*> all_of;
+  SchemaBranches any_of;
+  SchemaBranches one_of;
+
+  bool has_const{false};
+  const Json* const_value{nullptr};
+  bool has_enum{false};
+  std::unordered_set<const Json*, JsonPtrHash, JsonPtrEqual> enum_values;
+
+  SchemaType type{SchemaType::None};
+
+  std::optional<double> minimum;
+  std::optional<double> maximum;
+  std::optional<double> multiple_of;
+  std::optional<int64_t> multiple_of_int;  // set when multipleOf is a positive integer, for exact checks
+
+  std::optional<double> min_length;
+  std::optional<double> max_length;
+  const std::string* pattern{nullptr};
+  std::shared_ptr<const PatternMatcher> pattern_re;  // null when std::regex rejects the pattern
+  StringFormat format{StringFormat::Unknown};
+
+  std::optional<double> min_items;
+  std::optional<double> max_items;
+  const SchemaNode* items{nullptr};
+  const SchemaNode* contains{nullptr};
+  size_t min_contains{1};
+  std::optional<size_t> max_contains;
+
+  std::optional<double> min_properties;
+  std::optional<double> max_properties;
+  std::vector<const std::string*> required;
+  std::vector<std::pair<const std::string*, std::vector<const std::string*>>> dependent_required;
+  const SchemaNode* property_names{nullptr};
+  std::vector<std::pair<std::string_view, const SchemaNode*>> properties;  // sorted by key
+  AdditionalMode additional{AdditionalMode::Allow};
+  const SchemaNode* additional_schema{nullptr};
+
+  const SchemaNode* if_schema{nullptr};
+  const SchemaNode* then_schema{nullptr};
+  const SchemaNode* else_schema{nullptr};
+
+  const SchemaNode* find_property(const std::string& key) const {
+    auto it = std::lower_bound(properties.begin(), properties.end(), std::string_view(key),
+                               [](const auto& p, std::string_view k) { return p.first < k; });
+    if (it == properties.end() || it->first != key) return nullptr;
+    return it->second;
+  }
+};
+
+// Owns the nodes of one compiled schema; a deque keeps node addresses stable while compiling.
+struct SchemaProgram {
+  std::deque<SchemaNode> nodes;
+  const SchemaNode* root{nullptr};
+};
+
+static SchemaType schema_type_from_name(const std::string& name) {
+  const std::string t = to_lower(name);
+  if (t == "null") return SchemaType::Null;
+  if (t == "boolean") return SchemaType::Boolean;
+  if (t == "number") return SchemaType::Number;
+  if (t == "integer") return SchemaType::Integer;
+  if (t == "string") return SchemaType::String;
+  if (t == "array") return SchemaType::Array;
+  if (t == "object") return SchemaType::Object;
+  return SchemaType::Other;
+}
+
+static const SchemaNode* compile_schema_node(const Json& schema, SchemaProgram& prog) {
+  prog.nodes.emplace_back();
+  SchemaNode& node = prog.nodes.back();
+  if (!schema.is_object()) {
+    node.valid = false;
+    return &node;
+  }
+  const auto& sch = schema.as_object();
+
+  auto find_object = [&](const char* key) -> const Json* {
+    auto it = sch.find(key);
+    if (it == sch.end() || !it->second.is_object()) return nullptr;
+    return &it->second;
+  };
+  if (auto it = sch.find("allOf"); it != sch.end() && it->second.is_array()) {
+    for (const auto& sub : it->second.as_array()) {
+      if (sub.is_object()) node.all_of.push_back(compile_schema_node(sub, prog));
+    }
+  }
+  auto compile_branches = [&](const char* key, SchemaBranches& out) {
+    auto it = sch.find(key);
+    if (it == sch.end() || !it->second.is_array()) return;
+    const auto& branches = it->second.as_array();
+    out.present = true;
+    for (const auto& sub : branches) {
+      out.nodes.push_back(sub.is_object() ? compile_schema_node(sub, prog) : nullptr);
+    }
+    out.index = build_discriminator_index(sch, branches);
+  };
+  compile_branches("anyOf", node.any_of);
+  compile_branches("oneOf", node.one_of);
+
+  if (auto it = sch.find("const"); it != sch.end()) {
+    node.has_const = true;
+    node.const_value = &it->second;
+  }
+  if (auto it = sch.find("enum"); it != sch.end() && it->second.is_array()) {
+    node.has_enum = true;
+    node.enum_values.reserve(it->second.as_array().size());
+    for (const auto& v : it->second.as_array()) node.enum_values.insert(&v);
+  }
+
+  if (auto t = get_string_field(sch, "type")) node.type = schema_type_from_name(*t);
+
+  node.minimum = get_number_field(sch, "minimum");
+  node.maximum = get_number_field(sch, "maximum");
+  node.multiple_of = get_number_field(sch, "multipleOf");
+  if (auto it = sch.find("multipleOf"); it != sch.end() && it->second.is_int64() && it->second.as_int64() > 0) {
+    node.multiple_of_int = it->second.as_int64();
+  }
+
+  node.min_length = get_number_field(sch, "minLength");
+  node.max_length = get_number_field(sch, "maxLength");
+  if (auto it = sch.find("pattern"); it != sch.end() && it->second.is_string()) {
+    node.pattern = &it->second.as_string();
+    node.pattern_re = cached_pattern_regex(*node.pattern);
+  }
+  if (auto f = get_string_field(sch, "format")) node.format = string_format_from_name(*f);
+
+  node.min_items = get_number_field(sch, "minItems");
+  node.max_items = get_number_field(sch, "maxItems");
+  if (const Json* items = find_object("items")) node.items = compile_schema_node(*items, prog);
+  if (const Json* contains = find_object("contains")) {
+    node.contains = compile_schema_node(*contains, prog);
+    if (auto mn = get_number_field(sch, "minContains")) {
+      if (*mn >= 0.0) node.min_contains = static_cast<size_t>(*mn);
+    }
+    if (auto mx = get_number_field(sch, "maxContains")) {
+      if (*mx >= 0.0) node.max_contains = static_cast<size_t>(*mx);
+    }
+  }
+
+  node.min_properties = get_number_field(sch, "minProperties");
+  node.max_properties = get_number_field(sch, "maxProperties");
+  if (auto it = sch.find("required"); it != sch.end() && it->second.is_array()) {
+    for (const auto& k : it->second.as_array()) {
+      if (k.is_string()) node.required.push_back(&k.as_string());
+    }
+  }
+  if (const Json* deps = find_object("dependentRequired")) {
+    for (const auto& dep : deps->as_object()) {
+      if (!dep.second.is_array()) continue;
+      std::vector<const std::string*> reqs;
+      for (const auto& req : dep.second.as_array()) {
+        if (req.is_string()) reqs.push_back(&req.as_string());
+      }
+      node.dependent_required.emplace_back(&dep.first, std::move(reqs));
+    }
+  }
+  if (const Json* pn = find_object("propertyNames")) node.property_names = compile_schema_node(*pn, prog);
+  if (const Json* props = find_object("properties")) {
+    for (const auto& kv : props->as_object()) {
+      node.properties.emplace_back(std::string_view(kv.first), compile_schema_node(kv.second, prog));
+    }
+    std::sort(node.properties.begin(), node.properties.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+  }
+  if (auto it = sch.find("additionalProperties"); it != sch.end()) {
+    if (it->second.is_bool()) {
+      node.additional = it->second.as_bool() ? AdditionalMode::Allow : AdditionalMode::Forbid;
+    } else if (it->second.is_object()) {
+      node.additional = AdditionalMode::Schema;
+      node.additional_schema = compile_schema_node(it->second, prog);
+    }
+  }
+
+  if (const Json* if_schema = find_object("if")) {
+    node.if_schema = compile_schema_node(*if_schema, prog);
+    if (const Json* then_schema = find_object("then")) node.then_schema = compile_schema_node(*then_schema, prog);
+    if (const Json* else_schema = find_object("else")) node.else_schema = compile_schema_node(*else_schema, prog);
+  }
+  return &node;
+}
+
+static void compile_schema_program(const Json& schema, SchemaProgram& prog) {
+  prog.root = compile_schema_node(schema, prog);
+}
+
+struct ValidateOptions {
+  bool collect_all{false};
+  std::vector<ValidationError>* errors{nullptr};
+  // Probe mode (schema_passes): set *failed and stop at the first failure instead of building an error.
+  bool* failed{nullptr};
+  // Capture mode (try_validate): probe mode that keeps the first failure, message and all, here.
+  std::optional<ValidationError>* first_error{nullptr};
+  // The value's items and members were already checked against items/properties/additionalProperties;
+  // applies to the top node only.
+  bool shallow{false};
+};
+
+static bool probe_failed(const ValidateOptions& opt) { return opt.failed && *opt.failed; }
+
+// In probe mode, records the failure and returns true so the caller can stop without building a message.
+static bool probe_fail(const ValidateOptions& opt) {
+  if (!opt.failed) return false;
+  if (opt.first_error) return *opt.failed;  // the first failure still needs its message
+  *opt.failed = true;
+  return true;
+}
+
+// Location of the value being validated, as a chain of frames on the validator's call stack. The JSONPath
+// string is only built when an error is reported, so valid values cost no path allocations.
+struct ValidatePath {
+  enum class Kind { Root, Key, Index, Suffix };
+  const ValidatePath* parent{nullptr};
+  Kind kind{Kind::Root};
+  const std::string* text{nullptr};  // Root: base path; Key: property name; Suffix: appended verbatim
+  size_t index{0};
+
+  explicit ValidatePath(const std::string& base) : text(&base) {}
+  ValidatePath(const ValidatePath* p, Kind k, const std::string* t, size_t i) : parent(p), kind(k), text(t), index(i) {}
+
+  ValidatePath key(const std::string& k) const { return ValidatePath(this, Kind::Key, &k, 0); }
+  ValidatePath at(size_t i) const { return ValidatePath(this, Kind::Index, nullptr, i); }
+  ValidatePath suffix(const std::string& s) const { return ValidatePath(this, Kind::Suffix, &s, 0); }
+
+  std::string str() const {
+    std::vector<const ValidatePath*> frames;
+    for (const ValidatePath* f = this; f; f = f->parent) frames.push_back(f);
+    std::string out;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+      const ValidatePath& f = **it;
+      switch (f.kind) {
+        case Kind::Root:
+        case Kind::Suffix:
+          out += *f.text;
+          break;
+        case Kind::Key:
+          out += ".";
+          out += *f.text;
+          break;
+        case Kind::Index:
+          out += "[" + std::to_string(f.index) + "]";
+          break;
+      }
+    }
+    return out;
+  }
+};
+
+static const std::string kPropertyNamesSuffix = ".<propertyNames>";
+
+static bool report_or_throw(
+    const ValidateOptions& opt, const std::string& message, const ValidatePath& path, const std::string& kind = "schema") {
+  if (probe_fail(opt)) return false;
+  if (opt.first_error) {
+    opt.first_error->emplace(message, path.str(), kind);
+    *opt.failed = true;
+    return false;
+  }
+  if (opt.collect_all && opt.errors) {
+    opt.errors->emplace_back(message, path.str(), kind);
+    return false;
+  }
+  throw ValidationError(message, path.str(), kind);
+}
+
+static bool report_or_throw(const ValidateOptions& opt, const char* message, const ValidatePath& path) {
+  if (probe_fail(opt)) return false;
+  return report_or_throw(opt, std::string(message), path);
+}
+
+static void validate_node(const Json& value, const SchemaNode& node, const ValidatePath& path, const ValidateOptions& opt);
+
+static bool schema_passes(const Json& value, const SchemaNode& node, const ValidatePath& path) {
+  bool failed = false;
+  ValidateOptions opt;
+  opt.failed = &failed;
+  validate_node(value, node, path, opt);
+  return !failed;
+}
+
+static bool schema_passes(const Json& value, const Json& schema, const std::string& path) {
+  SchemaProgram prog;
+  compile_schema_program(schema, prog);
+  return schema_passes(value, *prog.root, ValidatePath(path));
+}
+
+// Number of branches value passes, counting no further than limit. With a discriminator index, branches
+// pinned to other discriminator values are known to fail and are skipped.
+static size_t count_passing_branches(const Json& value, const SchemaBranches& branches, const ValidatePath& path, size_t limit) {
+  size_t count = 0;
+  auto try_branch = [&](size_t i) {
+    const SchemaNode* sub = branches.nodes[i];
+    if (sub && schema_passes(value, *sub, path)) ++count;
+    return count >= limit;
+  };
+  const std::vector<size_t>* pinned = branches.index ? branches.index->pinned_for(value) : nullptr;
+  if (!pinned) {
+    for (size_t i = 0; i < branches.nodes.size(); ++i) {
+      if (try_branch(i)) break;
+    }
+    return count;
+  }
+  for (size_t i : *pinned) {
+    if (try_branch(i)) return count;
+  }
+  for (size_t i : branches.index->unpinned) {
+    if (try_branch(i)) return count;
+  }
+  return count;
+}
+
+static void validate_node(const Json& value, const SchemaNode& node, const ValidatePath& path, const ValidateOptions& opt) {
+  if (!node.valid) {
+    if (!opt.failed) throw ValidationError("schema must be object", path.str());
+    if (opt.first_error && !*opt.failed) opt.first_error->emplace("schema must be object", path.str());
+    *opt.failed = true;
+    return;
+  }
+
+  ValidateOptions deep = opt;
+  deep.shallow = false;
 
-    auto it_one = sch.find("oneOf");
-    if (it_one != sch.end() && it_one->second.is_array()) {
-      int ok_count = 0;
-      for (const auto& sub : it_one->second.as_array()) {
-        if (!sub.is_object()) continue;
-        if (schema_passes(value, sub, path)) ok_count++;
-      }
-      if (ok_count != 1) {
-        if (!report_or_throw(opt, "does not match oneOf", path)) return;
-      }
-    }
+  // allOf / anyOf / oneOf
+  for (const SchemaNode* sub : node.all_of) {
+    validate_node(value, *sub, path, deep);
+    if (probe_failed(opt)) return;
   }
 
-  // const
-  {
-    auto it = sch.find("const");
-    if (it != sch.end()) {
-      if (!json_equals(value, it->second)) {
-        if (!report_or_throw(opt, "value does not match const", path)) return;
-      }
+  if (node.any_of.present) {
+    if (count_passing_branches(value, node.any_of, path, 1) == 0) {
+      if (!report_or_throw(opt, "does not match anyOf", path)) return;
     }
   }
 
-  // enum
-  {
-    auto it = sch.find("enum");
-    if (it != sch.end() && it->second.is_array()) {
-      const auto& arr = it->second.as_array();
-      bool ok = false;
-      for (const auto& v : arr) {
-        if (json_equals(value, v)) {
-          ok = true;
-          break;
-        }
-      }
-      if (!ok) {
-        if (!report_or_throw(opt, "value not in enum", path)) return;
-      }
+  if (node.one_of.present) {
+    if (count_passing_branches(value, node.one_of, path, 2) != 1) {
+      if (!report_or_throw(opt, "does not match oneOf", path)) return;
     }
   }
 
-  // type
-  std::optional<std::string> ty;
-  if (auto t = get_string_field(sch, "type")) ty = to_lower(*t);
+  // const / enum
+  if (node.has_const && value != *node.const_value) {
+    if (!report_or_throw(opt, "value does not match const", path)) return;
+  }
+  if (node.has_enum && node.enum_values.count(&value) == 0) {
+    if (!report_or_throw(opt, "value not in enum", path)) return;
+  }
 
-  auto type_mismatch = [&](const std::string& expected) {
-    report_or_throw(opt, "expected " + expected, path, "type");
+  // type
+  auto type_mismatch = [&](const char* expected) {
+    if (probe_fail(opt)) return;
+    report_or_throw(opt, std::string("expected ") + expected, path, "type");
   };
 
-  if (ty) {
-    if (*ty == "null" && !value.is_null()) type_mismatch("null");
-    if (*ty == "boolean" && !value.is_bool()) type_mismatch("boolean");
-    if ((*ty == "number" || *ty == "integer") && !value.is_number()) type_mismatch("number");
-    if (*ty == "string" && !value.is_string()) type_mismatch("string");
-    if (*ty == "array" && !value.is_array()) type_mismatch("array");
-    if (*ty == "object" && !value.is_object()) type_mismatch("object");
-    if (*ty == "integer" && value.is_number()) {
-      double n = value.as_number();
-      if (!std::isfinite(n)) type_mismatch("integer");
-      double ip;
-      double frac = std::modf(n, &ip);
-      if (std::fabs(frac) > 1e-12) type_mismatch("integer");
-    }
+  switch (node.type) {
+    case SchemaType::Null:
+      if (!value.is_null()) type_mismatch("null");
+      break;
+    case SchemaType::Boolean:
+      if (!value.is_bool()) type_mismatch("boolean");
+      break;
+    case SchemaType::Number:
+      if (!value.is_number()) type_mismatch("number");
+      break;
+    case SchemaType::Integer:
+      if (!value.is_number()) {
+        type_mismatch("number");
+      } else if (!value.is_int64()) {
+        double n = value.as_number();
+        if (!std::isfinite(n)) type_mismatch("integer");
+        double ip;
+        double frac = std::modf(n, &ip);
+        if (std::fabs(frac) > 1e-12) type_mismatch("integer");
+      }
+      break;
+    case SchemaType::String:
+      if (!value.is_string()) type_mismatch("string");
+      break;
+    case SchemaType::Array:
+      if (!value.is_array()) type_mismatch("array");
+      break;
+    case SchemaType::Object:
+      if (!value.is_object()) type_mismatch("object");
+      break;
+    case SchemaType::None:
+    case SchemaType::Other:
+      break;
   }
+  if (probe_failed(opt)) return;
 
   // numeric constraints
   if (value.is_number()) {
-    if (auto mn = get_number_field(sch, "minimum")) {
-      if (value.as_number() < *mn) {
-        if (!report_or_throw(opt, "number < minimum", path)) return;
-      }
+    if (node.minimum && value.as_number() < *node.minimum) {
+      if (!report_or_throw(opt, "number < minimum", path)) return;
     }
-    if (auto mx = get_number_field(sch, "maximum")) {
-      if (value.as_number() > *mx) {
-        if (!report_or_throw(opt, "number > maximum", path)) return;
-      }
+    if (node.maximum && value.as_number() > *node.maximum) {
+      if (!report_or_throw(opt, "number > maximum", path)) return;
     }
-
-    if (auto mul = get_number_field(sch, "multipleOf")) {
-      double m = *mul;
+    if (node.multiple_of_int && value.is_int64()) {
+      if (value.as_int64() % *node.multiple_of_int != 0) {
+        if (!report_or_throw(opt, "number is not a multipleOf", path)) return;
+      }
+    } else if (node.multiple_of) {
+      double m = *node.multiple_of;
       if (m > 0.0) {
         double n = value.as_number();
         double q = n / m;
@@ -1464,100 +3878,59 @@ static void validate_impl(const Json& value, const Json& schema, const std::stri
   // string constraints (+ pattern)
   if (value.is_string()) {
     const auto& s = value.as_string();
-    if (auto mn = get_number_field(sch, "minLength")) {
-      if (static_cast<double>(s.size()) < *mn) {
-        if (!report_or_throw(opt, "string shorter than minLength", path)) return;
-      }
+    if (node.min_length && static_cast<double>(s.size()) < *node.min_length) {
+      if (!report_or_throw(opt, "string shorter than minLength", path)) return;
     }
-    if (auto mx = get_number_field(sch, "maxLength")) {
-      if (static_cast<double>(s.size()) > *mx) {
-        if (!report_or_throw(opt, "string longer than maxLength", path)) return;
-      }
+    if (node.max_length && static_cast<double>(s.size()) > *node.max_length) {
+      if (!report_or_throw(opt, "string longer than maxLength", path)) return;
     }
 
-    auto it_pat = sch.find("pattern");
-    if (it_pat != sch.end() && it_pat->second.is_string()) {
-      try {
-        std::regex r(it_pat->second.as_string(), std::regex::ECMAScript);
-        if (!std::regex_search(s, r)) {
-          if (!report_or_throw(opt, "string does not match pattern", path)) return;
-        }
-      } catch (const std::regex_error&) {
+    if (node.pattern) {
+      if (!node.pattern_re) {
         if (!report_or_throw(opt, "invalid pattern regex", path)) return;
+      } else if (!node.pattern_re->supported()) {
+        if (!report_or_throw(opt, "unsupported pattern regex (std::regex fallback disabled)", path)) return;
+      } else if (!node.pattern_re->search(s)) {
+        if (!report_or_throw(opt, "string does not match pattern", path)) return;
       }
     }
 
-    // format (email | uuid | date-time)
-    auto it_fmt = sch.find("format");
-    if (it_fmt != sch.end() && it_fmt->second.is_string()) {
-      const std::string fmt = to_lower(it_fmt->second.as_string());
-      try {
-        if (fmt == "email") {
-          std::regex r(R"(^[^\s@]+@[^\s@]+\.[^\s@]+$)", std::regex::ECMAScript);
-          if (!std::regex_match(s, r)) {
-            if (!report_or_throw(opt, "string does not match email format", path)) return;
-          }
-        } else if (fmt == "uuid") {
-          std::regex r(R"(^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}$)",
-                       std::regex::ECMAScript);
-          if (!std::regex_match(s, r)) {
-            if (!report_or_throw(opt, "string does not match uuid format", path)) return;
-          }
-        } else if (fmt == "date-time") {
-          std::regex r(R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(\.\d+)?(Z|[+-]\d{2}:\d{2})$)",
-                       std::regex::ECMAScript);
-          if (!std::regex_match(s, r)) {
-            if (!report_or_throw(opt, "string does not match date-time format", path)) return;
-          }
-        }
-      } catch (const std::regex_error&) {
-        if (!report_or_throw(opt, "invalid format regex", path)) return;
-      }
+    // format
+    if (!matches_string_format(node.format, s)) {
+      if (probe_fail(opt)) return;
+      if (!report_or_throw(opt, std::string("string does not match ") + string_format_name(node.format) + " format", path)) return;
     }
   }
 
   // array constraints
   if (value.is_array()) {
     const auto& arr = value.as_array();
-    if (auto mn = get_number_field(sch, "minItems")) {
-      if (static_cast<double>(arr.size()) < *mn) {
-        if (!report_or_throw(opt, "array shorter than minItems", path)) return;
-      }
+    if (node.min_items && static_cast<double>(arr.size()) < *node.min_items) {
+      if (!report_or_throw(opt, "array shorter than minItems", path)) return;
     }
-    if (auto mx = get_number_field(sch, "maxItems")) {
-      if (static_cast<double>(arr.size()) > *mx) {
-        if (!report_or_throw(opt, "array longer than maxItems", path)) return;
-      }
+    if (node.max_items && static_cast<double>(arr.size()) > *node.max_items) {
+      if (!report_or_throw(opt, "array longer than maxItems", path)) return;
     }
 
-    auto it_items = sch.find("items");
-    if (it_items != sch.end() && it_items->second.is_object()) {
+    if (node.items && !opt.shallow) {
       for (size_t idx = 0; idx < arr.size(); ++idx) {
-        validate_impl(arr[idx], it_items->second, path + "[" + std::to_string(idx) + "]", opt);
+        validate_node(arr[idx], *node.items, path.at(idx), opt);
+        if (probe_failed(opt)) return;
       }
     }
 
     // contains (+ minContains/maxContains)
-    auto it_contains = sch.find("contains");
-    if (it_contains != sch.end() && it_contains->second.is_object()) {
+    if (node.contains) {
       size_t count = 0;
       for (size_t idx = 0; idx < arr.size(); ++idx) {
-        if (schema_passes(arr[idx], it_contains->second, path + "[" + std::to_string(idx) + "]")) {
+        if (schema_passes(arr[idx], *node.contains, path.at(idx))) {
           ++count;
         }
       }
-      size_t minC = 1;
-      if (auto mn = get_number_field(sch, "minContains")) {
-        if (*mn >= 0.0) minC = static_cast<size_t>(*mn);
-      }
-      std::optional<size_t> maxC;
-      if (auto mx = get_number_field(sch, "maxContains")) {
-        if (*mx >= 0.0) maxC = static_cast<size_t>(*mx);
-      }
-      if (count < minC) {
+      if (count < node.min_contains) {
         if (!report_or_throw(opt, "array does not satisfy contains/minContains", path)) return;
       }
-      if (maxC && count > *maxC) {
+      if (node.max_contains && count > *node.max_contains) {
         if (!report_or_throw(opt, "array exceeds maxContains", path)) return;
       }
     }
@@ -1567,117 +3940,105 @@ static void validate_impl(const Json& value, const Json& schema, const std::stri
   if (value.is_object()) {
     const auto& obj = value.as_object();
 
-    if (auto mn = get_number_field(sch, "minProperties")) {
-      if (static_cast<double>(obj.size()) < *mn) {
-        if (!report_or_throw(opt, "object has fewer properties than minProperties", path)) return;
-      }
+    if (node.min_properties && static_cast<double>(obj.size()) < *node.min_properties) {
+      if (!report_or_throw(opt, "object has fewer properties than minProperties", path)) return;
     }
-    if (auto mx = get_number_field(sch, "maxProperties")) {
-      if (static_cast<double>(obj.size()) > *mx) {
-        if (!report_or_throw(opt, "object has more properties than maxProperties", path)) return;
-      }
+    if (node.max_properties && static_cast<double>(obj.size()) > *node.max_properties) {
+      if (!report_or_throw(opt, "object has more properties than maxProperties", path)) return;
     }
 
     // required
-    auto it_req = sch.find("required");
-    if (it_req != sch.end() && it_req->second.is_array()) {
-      for (const auto& k : it_req->second.as_array()) {
-        if (!k.is_string()) continue;
-        if (obj.find(k.as_string()) == obj.end()) {
-          report_or_throw(opt, "missing required property: " + k.as_string(), path + "." + k.as_string());
-        }
+    for (const std::string* k : node.required) {
+      if (obj.find(*k) == obj.end()) {
+        if (probe_fail(opt)) return;
+        report_or_throw(opt, "missing required property: " + *k, path.key(*k));
       }
     }
 
     // dependentRequired
-    {
-      auto it_dep = sch.find("dependentRequired");
-      if (it_dep != sch.end() && it_dep->second.is_object()) {
-        const auto& deps = it_dep->second.as_object();
-        for (const auto& dep : deps) {
-          const std::string& prop = dep.first;
-          if (obj.find(prop) == obj.end()) continue;
-          if (!dep.second.is_array()) continue;
-          for (const auto& req : dep.second.as_array()) {
-            if (!req.is_string()) continue;
-            const std::string& rk = req.as_string();
-            if (obj.find(rk) == obj.end()) {
-              report_or_throw(opt, "missing dependentRequired property: " + rk + " (requires because " + prop + " is present)",
-                              path + "." + rk);
-            }
-          }
+    for (const auto& dep : node.dependent_required) {
+      const std::string& prop = *dep.first;
+      if (obj.find(prop) == obj.end()) continue;
+      for (const std::string* rk : dep.second) {
+        if (obj.find(*rk) == obj.end()) {
+          if (probe_fail(opt)) return;
+          report_or_throw(opt, "missing dependentRequired property: " + *rk + " (requires because " + prop + " is present)",
+                          path.key(*rk));
         }
       }
     }
 
     // propertyNames
-    {
-      auto it_pn = sch.find("propertyNames");
-      if (it_pn != sch.end() && it_pn->second.is_object()) {
-        for (const auto& kv : obj) {
-          Json keyv(kv.first);
-          if (!schema_passes(keyv, it_pn->second, path + ".<propertyNames>")) {
-            if (!report_or_throw(opt, "property name does not satisfy propertyNames: " + kv.first, path + ".<propertyNames>")) return;
-          }
+    if (node.property_names) {
+      for (const auto& kv : obj) {
+        Json keyv(kv.first);
+        if (!schema_passes(keyv, *node.property_names, path.suffix(kPropertyNamesSuffix))) {
+          if (probe_fail(opt)) return;
+          if (!report_or_throw(opt, "property name does not satisfy propertyNames: " + kv.first, path.suffix(kPropertyNamesSuffix))) return;
         }
       }
     }
 
-    // properties
-    const JsonObject* props = nullptr;
-    auto it_props = sch.find("properties");
-    if (it_props != sch.end() && it_props->second.is_object()) props = &it_props->second.as_object();
-
-    // additionalProperties
-    enum class APMode { Allow, Forbid, Schema };
-    APMode ap = APMode::Allow;
-    const Json* ap_schema = nullptr;
-    auto it_ap = sch.find("additionalProperties");
-    if (it_ap != sch.end()) {
-      if (it_ap->second.is_bool()) {
-        ap = it_ap->second.as_bool() ? APMode::Allow : APMode::Forbid;
-      } else if (it_ap->second.is_object()) {
-        ap = APMode::Schema;
-        ap_schema = &it_ap->second;
-      }
-    }
-
-    for (const auto& kv : obj) {
-      const std::string& key = kv.first;
-      const Json& val = kv.second;
-      if (props && props->find(key) != props->end()) {
-        validate_impl(val, props->at(key), path + "." + key, opt);
-      } else {
-        if (ap == APMode::Forbid) {
-          report_or_throw(opt, "additionalProperties forbidden: " + key, path + "." + key);
-        }
-        if (ap == APMode::Schema && ap_schema) {
-          validate_impl(val, *ap_schema, path + "." + key, opt);
+    // properties / additionalProperties
+    if (!opt.shallow) {
+      for (const auto& kv : obj) {
+        const std::string& key = kv.first;
+        const Json& val = kv.second;
+        if (const SchemaNode* prop = node.find_property(key)) {
+          validate_node(val, *prop, path.key(key), opt);
+        } else {
+          if (node.additional == AdditionalMode::Forbid) {
+            if (probe_fail(opt)) return;
+            report_or_throw(opt, "additionalProperties forbidden: " + key, path.key(key));
+          }
+          if (node.additional == AdditionalMode::Schema) {
+            validate_node(val, *node.additional_schema, path.key(key), opt);
+          }
         }
+        if (probe_failed(opt)) return;
       }
     }
   }
 
   // if / then / else (applies to any type)
-  {
-    auto it_if = sch.find("if");
-    if (it_if != sch.end() && it_if->second.is_object()) {
-      bool cond = schema_passes(value, it_if->second, path);
-      auto it_then = sch.find("then");
-      auto it_else = sch.find("else");
-      if (cond) {
-        if (it_then != sch.end() && it_then->second.is_object()) {
-          validate_impl(value, it_then->second, path, opt);
-        }
-      } else {
-        if (it_else != sch.end() && it_else->second.is_object()) {
-          validate_impl(value, it_else->second, path, opt);
-        }
-      }
+  if (node.if_schema) {
+    if (schema_passes(value, *node.if_schema, path)) {
+      if (node.then_schema) validate_node(value, *node.then_schema, path, deep);
+    } else {
+      if (node.else_schema) validate_node(value, *node.else_schema, path, deep);
     }
   }
 }
 
+static void validate_impl(const Json& value, const Json& schema, const std::string& path, const ValidateOptions& opt) {
+  // One-shot validation compiles against the caller's schema without copying it.
+  SchemaProgram prog;
+  compile_schema_program(schema, prog);
+  validate_node(value, *prog.root, ValidatePath(path), opt);
+}
+
+struct CompiledSchema::Impl {
+  Json source;
+  SchemaProgram program;
+};
+
+struct CompiledSchemaAccess {
+  static const SchemaNode& root(const CompiledSchema& schema) { return *schema.impl_->program.root; }
+};
+
+CompiledSchema::CompiledSchema() : CompiledSchema(Json(JsonObject{})) {}
+
+CompiledSchema::CompiledSchema(Json schema) {
+  auto impl = std::make_shared<Impl>();
+  impl->source = std::move(schema);
+  compile_schema_program(impl->source, impl->program);
+  impl_ = std::move(impl);
+}
+
+const Json& CompiledSchema::schema() const { return impl_->source; }
+
+CompiledSchema compile_schema(const Json& schema) { return CompiledSchema(schema); }
+
 void validate(const Json& value, const Json& schema, const std::string& path) {
   ValidateOptions opt;
   validate_impl(value, schema, path, opt);
@@ -1692,6 +4053,20 @@ std::vector<ValidationError> validate_all(const Json& value, const Json& schema,
   return errors;
 }
 
+void validate(const Json& value, const CompiledSchema& schema, const std::string& path) {
+  ValidateOptions opt;
+  validate_node(value, CompiledSchemaAccess::root(schema), ValidatePath(path), opt);
+}
+
+std::vector<ValidationError> validate_all(const Json& value, const CompiledSchema& schema, const std::string& path) {
+  std::vector<ValidationError> errors;
+  ValidateOptions opt;
+  opt.collect_all = true;
+  opt.errors = &errors;
+  validate_node(value, CompiledSchemaAccess::root(schema), ValidatePath(path), opt);
+  return errors;
+}
+
 static void apply_defaults(Json& value, const Json& schema);
 
 namespace {
@@ -1778,8 +4153,18 @@ static bool repair_against_anyof(Json& value,
   const auto& any_of = it->second.as_array();
   if (any_of.empty()) return false;
 
-  for (const auto& branch : any_of) {
-    if (schema_passes(value, branch, path)) return false;
+  // With a discriminator, only the branches pinned to the value's tag (plus unpinned ones) can match; if the
+  // tag matches no branch at all, fall back to trying every branch.
+  std::vector<size_t> order;
+  if (auto index = build_discriminator_index(sch, any_of)) {
+    if (auto candidates = index->candidates(value)) order = std::move(*candidates);
+  }
+  if (order.empty()) {
+    for (size_t i = 0; i < any_of.size(); ++i) order.push_back(i);
+  }
+
+  for (size_t i : order) {
+    if (schema_passes(value, any_of[i], path)) return false;
   }
 
   size_t best_errs = std::numeric_limits<size_t>::max();
@@ -1787,7 +4172,8 @@ static bool repair_against_anyof(Json& value,
   std::vector<RepairSuggestion> best_suggestions;
   int best_budget = budget;
 
-  for (const auto& branch : any_of) {
+  for (size_t i : order) {
+    const Json& branch = any_of[i];
     Json candidate = value;
     std::vector<RepairSuggestion> local_suggestions;
     int local_budget = budget;
@@ -1880,7 +4266,7 @@ static bool repair_scalar_type(Json& value,
       if (std::fabs(frac) > 1e-12) {
         double rounded = std::round(n);
         if (std::fabs(n - rounded) < 1e-9) {
-          Json repaired(rounded);
+          Json repaired = std::fabs(rounded) < 9007199254740992.0 ? Json(static_cast<int64_t>(rounded)) : Json(rounded);
           push_suggestion(suggestions, path, "type", "expected integer", "round to nearest integer", value, repaired, true);
           value = repaired;
           --budget;
@@ -1925,7 +4311,7 @@ static bool repair_enum(Json& value,
   const auto& arr = it->second.as_array();
 
   for (const auto& v : arr) {
-    if (json_equals(value, v)) return false;
+    if (value == v) return false;
   }
 
   if (!value.is_string()) return false;
@@ -2058,7 +4444,7 @@ static bool repair_object_structure(Json& value,
   if (config.use_defaults) {
     Json before = value;
     apply_defaults(value, schema);
-    if (!json_equals(before, value)) {
+    if (before != value) {
       push_suggestion(suggestions,
                       path,
                       "required",
@@ -2800,6 +5186,43 @@ JsonArray parse_and_validate_all(const std::string& text, const Json& schema) {
 }
 
 JsonishParseAllResult parse_and_validate_all_ex(const std::string& text, const Json& schema, const RepairConfig& repair) {
+  // Compile once for all candidates.
+  return parse_and_validate_all_ex(text, CompiledSchema(schema), repair);
+}
+
+Json parse_and_validate_with_defaults(const std::string& text, const Json& schema) {
+  Json v = loads_jsonish(text);
+  apply_defaults(v, schema);
+  validate(v, schema, "$");
+  return v;
+}
+
+JsonishParseResult parse_and_validate_with_defaults_ex(
+    const std::string& text, const Json& schema, const RepairConfig& repair) {
+  JsonishParseResult r = loads_jsonish_ex(text, repair);
+  apply_defaults(r.value, schema);
+  validate(r.value, schema, "$");
+  return r;
+}
+
+Json parse_and_validate(const std::string& text, const CompiledSchema& schema) {
+  Json v = loads_jsonish(text);
+  validate(v, schema, "$");
+  return v;
+}
+
+JsonishParseResult parse_and_validate_ex(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair) {
+  JsonishParseResult r = loads_jsonish_ex(text, repair);
+  validate(r.value, schema, "$");
+  return r;
+}
+
+JsonArray parse_and_validate_all(const std::string& text, const CompiledSchema& schema) {
+  return parse_and_validate_all_ex(text, schema, RepairConfig{}).values;
+}
+
+JsonishParseAllResult parse_and_validate_all_ex(
+    const std::string& text, const CompiledSchema& schema, const RepairConfig& repair) {
   JsonishParseAllResult r = loads_jsonish_all_ex(text, repair);
   for (size_t i = 0; i < r.values.size(); ++i) {
     validate(r.values[i], schema, "$[" + std::to_string(i) + "]");
@@ -2807,21 +5230,328 @@ JsonishParseAllResult parse_and_validate_all_ex(const std::string& text, const J
   return r;
 }
 
-Json parse_and_validate_with_defaults(const std::string& text, const Json& schema) {
+Json parse_and_validate_with_defaults(const std::string& text, const CompiledSchema& schema) {
   Json v = loads_jsonish(text);
-  apply_defaults(v, schema);
+  apply_defaults(v, schema.schema());
   validate(v, schema, "$");
   return v;
 }
 
 JsonishParseResult parse_and_validate_with_defaults_ex(
-    const std::string& text, const Json& schema, const RepairConfig& repair) {
+    const std::string& text, const CompiledSchema& schema, const RepairConfig& repair) {
   JsonishParseResult r = loads_jsonish_ex(text, repair);
-  apply_defaults(r.value, schema);
+  apply_defaults(r.value, schema.schema());
   validate(r.value, schema, "$");
   return r;
 }
 
+// Parses with Parser's grammar while walking the compiled schema alongside: members and items are checked
+// against properties/additionalProperties/items as soon as each one is complete, and everything else on a
+// node once its value is, so the parse stops at the first violation. Under LastWins a member may still be
+// replaced by a later duplicate, so checks below an object wait until the object closes.
+struct SchemaDrivenParser {
+  Parser p;
+  bool drop_unconstrained{false};
+  bool checking{true};
+
+  // Keywords that judge a finished value as a whole; members below them can't be dropped.
+  static bool sees_whole_value(const SchemaNode& node) {
+    return !node.all_of.empty() || node.any_of.present || node.one_of.present || node.has_const || node.has_enum ||
+           node.if_schema || node.contains || node.property_names || node.min_properties || node.max_properties;
+  }
+
+  static bool names_property(const SchemaNode& node, const std::string& key) {
+    for (const std::string* k : node.required) {
+      if (*k == key) return true;
+    }
+    for (const auto& dep : node.dependent_required) {
+      if (*dep.first == key) return true;
+      for (const std::string* k : dep.second) {
+        if (*k == key) return true;
+      }
+    }
+    return false;
+  }
+
+  // Expected type name when a value opening with `c` (an object, array or string) can't match `type`.
+  const char* early_type_mismatch(SchemaType type, char c) const {
+    SchemaType seen;
+    if (c == '{') {
+      seen = SchemaType::Object;
+    } else if (c == '[') {
+      seen = SchemaType::Array;
+    } else if (c == '"' || (c == '\'' && p.allow_single_quotes)) {
+      seen = SchemaType::String;
+    } else {
+      return nullptr;  // scalars are checked once parsed, so repairable text still reaches the repairs
+    }
+    if (type == seen) return nullptr;
+    switch (type) {
+      case SchemaType::Null: return "null";
+      case SchemaType::Boolean: return "boolean";
+      case SchemaType::Number:
+      case SchemaType::Integer: return "number";
+      case SchemaType::String: return "string";
+      case SchemaType::Array: return "array";
+      case SchemaType::Object: return "object";
+      case SchemaType::None:
+      case SchemaType::Other: return nullptr;
+    }
+    return nullptr;
+  }
+
+  // Parses the value at the cursor and checks it against `node` (null: unconstrained).
+  Json value(const SchemaNode* node, const ValidatePath& path, bool may_drop) {
+    if (!node) return p.parse_value();
+    if (!node->valid) throw ValidationError("schema must be object", path.str());
+    p.skip_ws();
+    if (p.i >= p.s.size()) p.fail("unexpected end");
+    const char c = p.s[p.i];
+    if (!checking) {
+      if (c != '{' && c != '[') return p.parse_value();
+      const bool drop_below = may_drop && !sees_whole_value(*node);
+      return c == '{' ? object(*node, path, drop_below) : array(*node, path, drop_below);
+    }
+    if (const char* expected = early_type_mismatch(node->type, c)) {
+      throw ValidationError(std::string("expected ") + expected, path.str(), "type");
+    }
+    ValidateOptions opt;
+    if (c != '{' && c != '[') {
+      Json v = p.parse_value();
+      validate_node(v, *node, path, opt);
+      return v;
+    }
+    const bool drop_below = may_drop && !sees_whole_value(*node);
+    if (c == '{' && p.duplicate_key_policy == RepairConfig::DuplicateKeyPolicy::LastWins) {
+      // Only the surviving members are checked, as validate() would see them.
+      checking = false;
+      Json v = object(*node, path, drop_below);
+      checking = true;
+      validate_node(v, *node, path, opt);
+      return v;
+    }
+    Json v = c == '{' ? object(*node, path, drop_below) : array(*node, path, drop_below);
+    opt.shallow = true;
+    validate_node(v, *node, path, opt);
+    return v;
+  }
+
+  Json object(const SchemaNode& node, const ValidatePath& path, bool may_drop) {
+    ++p.i;
+    JsonObject obj;
+    if (p.consume('}')) return Json(std::move(obj));
+    std::string key;
+    while (true) {
+      p.skip_ws();
+      if (p.i >= p.s.size()) p.fail("unterminated object");
+      if (!(p.s[p.i] == '"' || p.s[p.i] == '\'')) p.fail("expected string key");
+      p.parse_string_into(key);
+      if (!p.consume(':')) p.fail("expected :");
+      member(node, path, may_drop, key, obj);
+      if (p.consume('}')) break;
+      if (!p.consume(',')) p.fail("expected , or }");
+    }
+    return Json(std::move(obj));
+  }
+
+  void member(const SchemaNode& node, const ValidatePath& path, bool may_drop, std::string& key, JsonObject& obj) {
+    const SchemaNode* sub = node.find_property(key);
+    if (!sub) {
+      if (node.additional == AdditionalMode::Forbid) {
+        throw ValidationError("additionalProperties forbidden: " + key, path.key(key).str());
+      }
+      sub = node.additional_schema;
+    }
+
+    auto it = obj.find(key);
+    if (it != obj.end()) {
+      if (p.duplicate_key_count) ++*p.duplicate_key_count;
+      switch (p.duplicate_key_policy) {
+        case RepairConfig::DuplicateKeyPolicy::Error:
+          throw Parser::DuplicateKeyError{key};
+        case RepairConfig::DuplicateKeyPolicy::FirstWins:
+          p.skip_value();
+          return;
+        case RepairConfig::DuplicateKeyPolicy::LastWins:
+          it->second = value(sub, path.key(key), may_drop);
+          return;
+      }
+    }
+
+    if (drop_unconstrained && may_drop && !sub && p.duplicate_key_policy != RepairConfig::DuplicateKeyPolicy::Error &&
+        !names_property(node, key)) {
+      p.skip_value();
+      return;
+    }
+    obj.emplace(std::move(key), value(sub, path.key(key), may_drop));
+    if (checking && node.max_properties && static_cast<double>(obj.size()) > *node.max_properties) {
+      throw ValidationError("object has more properties than maxProperties", path.str());
+    }
+  }
+
+  Json array(const SchemaNode& node, const ValidatePath& path, bool may_drop) {
+    ++p.i;
+    JsonArray arr;
+    if (p.consume(']')) return Json(std::move(arr));
+    while (true) {
+      // Counted only once a value follows: "[1, 2,]" is a syntax error to be repaired, not a third item.
+      p.skip_ws();
+      if (checking && node.max_items && p.i < p.s.size() && p.s[p.i] != ']' &&
+          static_cast<double>(arr.size() + 1) > *node.max_items) {
+        throw ValidationError("array longer than maxItems", path.str());
+      }
+      arr.push_back(value(node.items, path.at(arr.size()), may_drop));
+      if (p.consume(']')) break;
+      if (!p.consume(',')) p.fail("expected , or ]");
+    }
+    return Json(std::move(arr));
+  }
+
+  static Json parse(const std::string& text,
+                    const SchemaNode& root,
+                    const RepairConfig& repair,
+                    bool drop_unconstrained,
+                    int* duplicate_key_count) {
+    SchemaDrivenParser d{Parser(text, repair.allow_single_quotes, repair.duplicate_key_policy, duplicate_key_count),
+                         drop_unconstrained};
+    static const std::string kRoot = "$";
+    Json v = d.value(&root, ValidatePath(kRoot), true);
+    d.p.skip_ws();
+    if (d.p.i != text.size()) throw std::runtime_error("JSON parse error: trailing data");
+    return v;
+  }
+};
+
+JsonishParseResult parse_and_validate_fused(
+    const std::string& text, const CompiledSchema& schema, const RepairConfig& repair, const FusedValidateConfig& config) {
+  auto [candidate, from_fence] = extract_json_candidate_with_meta(text);
+  JsonishParseResult r;
+  r.metadata.extracted_from_fence = from_fence;
+  bool as_is = repair.strict_fast_path;  // the first attempt parses the candidate before any repair
+  r.fixed = parse_candidate_with_repairs(std::move(candidate), repair, r.metadata, [&](const std::string& t, int* dup_count) {
+    const bool first = std::exchange(as_is, false);
+    try {
+      r.value = SchemaDrivenParser::parse(t, CompiledSchemaAccess::root(schema), repair,
+                                          config.drop_unconstrained_properties, dup_count);
+    } catch (const ValidationError&) {
+      // A violation in text that doesn't parse as-is may be gone once it is repaired ("[1, 2,]" under maxItems 2),
+      // so the repaired text gets its turn, as in parse_and_validate.
+      std::optional<std::string> duplicate;
+      if (first && json_syntax_error(t, repair, duplicate)) throw std::runtime_error("JSON parse error: needs repair");
+      throw;
+    }
+  });
+  return r;
+}
+
+// ---------------- Non-throwing API ----------------
+
+static void set_status(TryStatus& status, ErrorCode code, std::string path, std::string message) {
+  status.code = code;
+  status.path = std::move(path);
+  status.message = std::move(message);
+}
+
+static void set_status(TryStatus& status, const ValidationError& e) {
+  ErrorCode code = ErrorCode::Schema;
+  if (e.kind == "type") code = ErrorCode::Type;
+  if (e.kind == "limit") code = ErrorCode::Limit;
+  if (e.kind == "parse") code = ErrorCode::Parse;
+  set_status(status, code, e.path, e.message);
+}
+
+template <typename T>
+static void fail_result(TryResult<T>& result, TryStatus status) {
+  static_cast<TryStatus&>(result) = std::move(status);
+  result.value = T{};
+}
+
+// The try_* paths report expected failures without throwing; anything else (allocation failure, regex
+// engine limits) is still turned into a status here rather than escaping.
+template <typename Fn>
+static void run_guarded(TryStatus& status, Fn&& fn) {
+  try {
+    fn();
+  } catch (const ValidationError& e) {
+    set_status(status, e);
+  } catch (const std::exception& e) {
+    set_status(status, ErrorCode::Internal, "$", e.what());
+  }
+}
+
+// Same flow as loads_jsonish_candidate_ex(): strict fast path, then repairs. Each attempt is checked before
+// it is built, so a rejected one costs a scan rather than an unwind.
+static void try_parse_json_candidate(const std::string& raw, const RepairConfig& repair, TryResult<Json>& r) {
+  auto build = [&](const std::string& checked) {
+    Parser p(checked, repair.allow_single_quotes, repair.duplicate_key_policy, nullptr);
+    r.value = p.parse_value();
+  };
+  std::optional<std::string> duplicate;
+  if (repair.strict_fast_path) {
+    std::optional<std::string> error = json_syntax_error(raw, repair, duplicate);
+    if (!error) return build(raw);
+    if (duplicate) return set_status(r, ErrorCode::DuplicateKey, "$." + *duplicate, "duplicate key");
+  }
+  RepairMetadata meta;
+  const std::string fixed = repair_jsonish_text(raw, repair, meta);
+  if (std::optional<std::string> error = json_syntax_error(fixed, repair, duplicate)) {
+    if (duplicate) return set_status(r, ErrorCode::DuplicateKey, "$." + *duplicate, "duplicate key");
+    return set_status(r, ErrorCode::Parse, "$", "JSON parse error: " + *error);
+  }
+  build(fixed);
+}
+
+TryResult<Json> try_loads_jsonish(const std::string& text, const RepairConfig& repair) {
+  TryResult<Json> r;
+  run_guarded(r, [&] {
+    auto candidate = try_extract_json_candidate_with_meta(text);
+    if (!candidate) return set_status(r, ErrorCode::NotFound, "$", "no JSON found");
+    try_parse_json_candidate(candidate->first, repair, r);
+  });
+  if (!r.ok()) r.value = Json();
+  return r;
+}
+
+static TryStatus try_validate_node(const Json& value, const SchemaNode& root, const std::string& path) {
+  TryStatus status;
+  run_guarded(status, [&] {
+    bool failed = false;
+    std::optional<ValidationError> error;
+    ValidateOptions opt;
+    opt.failed = &failed;
+    opt.first_error = &error;
+    validate_node(value, root, ValidatePath(path), opt);
+    if (error) set_status(status, *error);
+  });
+  return status;
+}
+
+TryStatus try_validate(const Json& value, const Json& schema, const std::string& path) {
+  SchemaProgram prog;
+  compile_schema_program(schema, prog);
+  return try_validate_node(value, *prog.root, path);
+}
+
+TryStatus try_validate(const Json& value, const CompiledSchema& schema, const std::string& path) {
+  return try_validate_node(value, CompiledSchemaAccess::root(schema), path);
+}
+
+TryResult<Json> try_parse_and_validate(const std::string& text, const Json& schema, const RepairConfig& repair) {
+  TryResult<Json> r = try_loads_jsonish(text, repair);
+  if (r.ok()) {
+    if (TryStatus status = try_validate(r.value, schema, "$"); !status.ok()) fail_result(r, std::move(status));
+  }
+  return r;
+}
+
+TryResult<Json> try_parse_and_validate(const std::string& text, const CompiledSchema& schema, const RepairConfig& repair) {
+  TryResult<Json> r = try_loads_jsonish(text, repair);
+  if (r.ok()) {
+    if (TryStatus status = try_validate(r.value, schema, "$"); !status.ok()) fail_result(r, std::move(status));
+  }
+  return r;
+}
+
 // ---------------- Markdown parsing/validation ----------------
 
 MarkdownParsed parse_markdown(const std::string& text) {
@@ -3178,30 +5908,20 @@ KeyValue parse_and_validate_kv(const std::string& text, const Json& schema) {
 
 // ---------------- YAML-ish extraction/parsing/validation ----------------
 
+// A ```yaml / ```yml body as the extractors return it: leading blank lines dropped.
+static std::string yaml_fence_body(const std::string& text, const FenceSpan& fence) {
+  std::string body = fence_body_lines(text, fence);
+  const size_t first = body.find_first_not_of('\n');
+  body.erase(0, first == std::string::npos ? body.size() : first);
+  return body;
+}
+
 std::string extract_yaml_candidate(const std::string& text) {
   // Look for ```yaml or ```yml fenced blocks first
-  const std::string fence_yaml = "```yaml";
-  const std::string fence_yml = "```yml";
-  const std::string fence_close = "```";
-  
+  if (auto fence = find_fenced_lines(text, 0, {"yaml", "yml"}, false)) return yaml_fence_body(text, *fence);
+
   auto lines = split_lines(text);
-  
-  for (size_t i = 0; i < lines.size(); ++i) {
-    std::string trimmed = ltrim_copy(lines[i]);
-    if (trimmed.find(fence_yaml) == 0 || trimmed.find(fence_yml) == 0) {
-      std::string body;
-      for (size_t j = i + 1; j < lines.size(); ++j) {
-        std::string line_trim = ltrim_copy(lines[j]);
-        if (line_trim.find(fence_close) == 0) {
-          return body;
-        }
-        if (!body.empty()) body += "\n";
-        body += lines[j];
-      }
-      return body;
-    }
-  }
-  
+
   // If no fence found, try to extract YAML-like content
   // Look for lines with key: value or list items starting with -
   std::string yaml_content;
@@ -3235,29 +5955,25 @@ std::vector<std::string> extract_yaml_candidates(const std::string& text) {
   std::vector<std::string> candidates;
   auto lines = split_lines(text);
   
-  const std::string fence_yaml = "```yaml";
-  const std::string fence_yml = "```yml";
-  const std::string fence_close = "```";
-  
   std::vector<bool> in_fence(lines.size(), false);
-  
-  // First pass: mark fenced regions
-  for (size_t i = 0; i < lines.size(); ++i) {
-    std::string trimmed = ltrim_copy(lines[i]);
-    if (trimmed.find(fence_yaml) == 0 || trimmed.find(fence_yml) == 0) {
-      std::string body;
-      for (size_t j = i + 1; j < lines.size(); ++j) {
-        std::string line_trim = ltrim_copy(lines[j]);
-        if (line_trim.find(fence_close) == 0) {
-          candidates.push_back(body);
-          for (size_t k = i; k <= j; ++k) in_fence[k] = true;
-          i = j;
-          break;
-        }
-        if (!body.empty()) body += "\n";
-        body += lines[j];
-      }
-    }
+  
+  // First pass: mark fenced regions
+  size_t line_no = 0, counted = 0;  // line number of offset `counted`
+  auto line_of = [&](size_t offset) {
+    line_no += static_cast<size_t>(std::count(text.begin() + static_cast<std::ptrdiff_t>(counted),
+                                              text.begin() + static_cast<std::ptrdiff_t>(offset), '\n'));
+    counted = offset;
+    return line_no;
+  };
+  for (size_t pos = 0; pos < text.size();) {
+    auto fence = find_fenced_lines(text, pos, {"yaml", "yml"}, false);
+    if (!fence || fence->close == std::string::npos) break;
+    candidates.push_back(yaml_fence_body(text, *fence));
+    const size_t first = line_of(fence->open);
+    const size_t last = line_of(fence->close);
+    for (size_t k = first; k <= last; ++k) in_fence[k] = true;
+    const size_t close_end = text.find('\n', fence->close);
+    pos = close_end == std::string::npos ? text.size() : close_end + 1;
   }
   
   // Second pass: look for YAML documents separated by ---
@@ -3558,11 +6274,9 @@ static Json parse_yaml_value(const std::string& yaml_text) {
   // Inline JSON array or object
   if ((val.front() == '[' && val.back() == ']') || 
       (val.front() == '{' && val.back() == '}')) {
-    try {
-      return loads_jsonish(val);
-    } catch (...) {
-      // Fall through to string
-    }
+    TryResult<Json> inline_json = try_loads_jsonish(val);
+    if (inline_json.ok()) return std::move(inline_json.value);
+    // Fall through to string
   }
   
   // Default: string
@@ -3636,72 +6350,107 @@ YamlishParseAllResult parse_and_validate_yaml_all_ex(const std::string& text, co
   return result;
 }
 
-static std::string yaml_to_string_impl(const Json& v, int indent, int level, bool inline_mode);
+// The YAML-ish parser is lenient and reports nothing itself; only validation can fail.
+TryResult<Json> try_loads_yamlish(const std::string& text, const YamlRepairConfig& repair) {
+  TryResult<Json> r;
+  run_guarded(r, [&] { r.value = loads_yamlish_ex(text, repair).value; });
+  return r;
+}
 
-static std::string yaml_to_string_impl(const Json& v, int indent, int level, bool inline_mode) {
-  std::string ind(level * indent, ' ');
-  
-  if (v.is_null()) return "null";
-  if (v.is_bool()) return v.as_bool() ? "true" : "false";
-  if (v.is_number()) {
+TryResult<Json> try_parse_and_validate_yaml(const std::string& text, const Json& schema, const YamlRepairConfig& repair) {
+  TryResult<Json> r = try_loads_yamlish(text, repair);
+  if (r.ok()) {
+    if (TryStatus status = try_validate(r.value, schema, "$"); !status.ok()) fail_result(r, std::move(status));
+  }
+  return r;
+}
+
+static void yaml_write_impl(const Json& v, int indent, int level, OutputSink& out);
+
+static void yaml_write_impl(const Json& v, int indent, int level, OutputSink& out) {
+  if (v.is_null()) {
+    out += "null";
+  } else if (v.is_bool()) {
+    out += v.as_bool() ? "true" : "false";
+  } else if (v.is_int64()) {
+    out += std::to_string(v.as_int64());
+  } else if (v.is_number()) {
     double num = v.as_number();
     if (std::floor(num) == num && num >= -1e15 && num <= 1e15) {
-      return std::to_string(static_cast<int64_t>(num));
+      out += std::to_string(static_cast<int64_t>(num));
+    } else {
+      out += std::to_string(num);
     }
-    return std::to_string(num);
-  }
-  if (v.is_string()) {
+  } else if (v.is_string()) {
     const auto& s = v.as_string();
     // Quote if contains special chars or looks like number/bool
-    if (s.empty() || s == "null" || s == "true" || s == "false" || 
+    if (s.empty() || s == "null" || s == "true" || s == "false" ||
         s.find(':') != std::string::npos || s.find('#') != std::string::npos ||
         s.find('\n') != std::string::npos) {
-      return "\"" + json_escape(s) + "\"";
+      JsonWriter(out).write_string(s);
+      return;
     }
     char* end = nullptr;
     std::strtod(s.c_str(), &end);
     if (end == s.c_str() + s.size()) {
-      return "\"" + s + "\"";
+      out += '"';
+      out += s;
+      out += '"';
+      return;
     }
-    return s;
-  }
-  if (v.is_array()) {
-    const auto& arr = v.as_array();
-    if (arr.empty()) return "[]";
-    
-    std::string result;
-    for (const auto& el : arr) {
-      result += ind + "- ";
+    out += s;
+  } else if (v.is_array() || v.is_object()) {
+    // One line per element, joined by newlines (no trailing newline); nested containers start on the
+    // next line, one level deeper.
+    const std::string ind(level * indent, ' ');
+    bool first = true;
+    auto element = [&](const Json& el) {
       if (el.is_object() || el.is_array()) {
-        result += "\n" + yaml_to_string_impl(el, indent, level + 1, false);
+        out += '\n';
+        yaml_write_impl(el, indent, level + 1, out);
       } else {
-        result += yaml_to_string_impl(el, indent, 0, true);
+        yaml_write_impl(el, indent, 0, out);
       }
-      result += "\n";
-    }
-    return result.substr(0, result.size() - 1); // Remove trailing newline
-  }
-  if (v.is_object()) {
-    const auto& obj = v.as_object();
-    if (obj.empty()) return "{}";
-    
-    std::string result;
-    for (const auto& kv : obj) {
-      result += ind + kv.first + ": ";
-      if (kv.second.is_object() || kv.second.is_array()) {
-        result += "\n" + yaml_to_string_impl(kv.second, indent, level + 1, false);
-      } else {
-        result += yaml_to_string_impl(kv.second, indent, 0, true);
+    };
+    if (v.is_array()) {
+      if (v.as_array().empty()) {
+        out += "[]";
+        return;
+      }
+      for (const auto& el : v.as_array()) {
+        if (!first) out += '\n';
+        first = false;
+        out += ind;
+        out += "- ";
+        element(el);
+      }
+    } else {
+      if (v.as_object().empty()) {
+        out += "{}";
+        return;
+      }
+      for (const auto& kv : v.as_object()) {
+        if (!first) out += '\n';
+        first = false;
+        out += ind;
+        out += kv.first;
+        out += ": ";
+        element(kv.second);
       }
-      result += "\n";
     }
-    return result.substr(0, result.size() - 1); // Remove trailing newline
   }
-  return "null";
 }
 
 std::string dumps_yaml(const Json& value, int indent) {
-  return yaml_to_string_impl(value, indent, 0, false);
+  std::string out;
+  OutputSink sink(out);
+  yaml_write_impl(value, indent, 0, sink);
+  return out;
+}
+
+void dump_yaml(const Json& value, OutputSink& sink, int indent) {
+  yaml_write_impl(value, indent, 0, sink);
+  sink.flush();
 }
 
 // ---------------- TOML extraction/parsing/validation ----------------
@@ -3837,6 +6586,27 @@ static Json parse_toml_inline_table(const std::string& text, size_t& pos);
 static Json parse_toml_inline_array(const std::string& text, size_t& pos);
 
 // Parse a TOML value (string, number, bool, array, inline table, datetime)
+// std::stoll / std::stoul / std::stod without the exceptions: the same strto* parse, returning nullopt
+// where those throw (nothing converted, or out of range). `used` receives the characters consumed.
+template <typename T>
+static std::optional<T> checked_strto(T (*strto)(const char*, char**, int), const std::string& s, int base, size_t* used = nullptr) {
+  errno = 0;
+  char* end = nullptr;
+  const T v = strto(s.c_str(), &end, base);
+  if (end == s.c_str() || errno == ERANGE) return std::nullopt;
+  if (used) *used = static_cast<size_t>(end - s.c_str());
+  return v;
+}
+
+static std::optional<double> checked_strtod(const std::string& s, size_t* used) {
+  errno = 0;
+  char* end = nullptr;
+  const double v = std::strtod(s.c_str(), &end);
+  if (end == s.c_str() || errno == ERANGE) return std::nullopt;
+  *used = static_cast<size_t>(end - s.c_str());
+  return v;
+}
+
 static Json parse_toml_value(const std::string& value_str) {
   std::string trimmed = value_str;
   // Trim whitespace
@@ -3913,35 +6683,21 @@ static Json parse_toml_value(const std::string& value_str) {
     
     // Check for hex, octal, binary
     if (num_str.size() > 2 && num_str[0] == '0') {
-      if (num_str[1] == 'x' || num_str[1] == 'X') {
-        // Hex
-        try {
-          int64_t val = std::stoll(num_str.substr(2), nullptr, 16);
-          return Json(static_cast<double>(val));
-        } catch (...) {}
-      } else if (num_str[1] == 'o' || num_str[1] == 'O') {
-        // Octal
-        try {
-          int64_t val = std::stoll(num_str.substr(2), nullptr, 8);
-          return Json(static_cast<double>(val));
-        } catch (...) {}
-      } else if (num_str[1] == 'b' || num_str[1] == 'B') {
-        // Binary
-        try {
-          int64_t val = std::stoll(num_str.substr(2), nullptr, 2);
-          return Json(static_cast<double>(val));
-        } catch (...) {}
+      const char radix = num_str[1];
+      const int base = (radix == 'x' || radix == 'X') ? 16 : (radix == 'o' || radix == 'O') ? 8 : (radix == 'b' || radix == 'B') ? 2 : 0;
+      if (base != 0) {
+        if (auto val = checked_strto<long long>(std::strtoll, num_str.substr(2), base)) return Json(static_cast<int64_t>(*val));
       }
     }
     
     // Try integer
-    try {
-      size_t processed;
-      int64_t ival = std::stoll(num_str, &processed);
-      if (processed == num_str.size()) {
-        return Json(static_cast<double>(ival));
+    {
+      size_t processed = 0;
+      auto ival = checked_strto<long long>(std::strtoll, num_str, 10, &processed);
+      if (ival && processed == num_str.size()) {
+        return Json(static_cast<int64_t>(*ival));
       }
-    } catch (...) {}
+    }
     
     // Try float (including inf, nan)
     if (num_str == "inf" || num_str == "+inf") {
@@ -3954,13 +6710,13 @@ static Json parse_toml_value(const std::string& value_str) {
       return Json(std::numeric_limits<double>::quiet_NaN());
     }
     
-    try {
-      size_t processed;
-      double dval = std::stod(num_str, &processed);
-      if (processed == num_str.size()) {
-        return Json(dval);
+    {
+      size_t processed = 0;
+      auto dval = checked_strtod(num_str, &processed);
+      if (dval && processed == num_str.size()) {
+        return Json(*dval);
       }
-    } catch (...) {}
+    }
   }
   
   // Datetime (return as string for now)
@@ -4473,6 +7229,21 @@ TomlishParseAllResult parse_and_validate_toml_all_ex(const std::string& text, co
   return result;
 }
 
+// Like YAML, TOML-ish parsing never rejects its input; only validation can fail.
+TryResult<Json> try_loads_tomlish(const std::string& text, const TomlRepairConfig& repair) {
+  TryResult<Json> r;
+  run_guarded(r, [&] { r.value = loads_tomlish_ex(text, repair).value; });
+  return r;
+}
+
+TryResult<Json> try_parse_and_validate_toml(const std::string& text, const Json& schema, const TomlRepairConfig& repair) {
+  TryResult<Json> r = try_loads_tomlish(text, repair);
+  if (r.ok()) {
+    if (TryStatus status = try_validate(r.value, schema, "$"); !status.ok()) fail_result(r, std::move(status));
+  }
+  return r;
+}
+
 static std::string toml_escape_string(const std::string& s) {
   std::string result;
   for (char c : s) {
@@ -4488,9 +7259,9 @@ static std::string toml_escape_string(const std::string& s) {
   return result;
 }
 
-static void dumps_toml_impl(const Json& value, const std::string& prefix, std::string& output, bool is_root);
+static void dumps_toml_impl(const Json& value, const std::string& prefix, OutputSink& output, bool is_root);
 
-static void dumps_toml_impl(const Json& value, const std::string& prefix, std::string& output, bool is_root) {
+static void dumps_toml_impl(const Json& value, const std::string& prefix, OutputSink& output, bool is_root) {
   if (!value.is_object()) {
     // Non-object at root - just output as key-value if possible
     return;
@@ -4520,6 +7291,8 @@ static void dumps_toml_impl(const Json& value, const std::string& prefix, std::s
       output += "\"\"";  // TOML has no null, use empty string
     } else if (val.is_bool()) {
       output += val.as_bool() ? "true" : "false";
+    } else if (val.is_int64()) {
+      output += std::to_string(val.as_int64());
     } else if (val.is_number()) {
       double num = val.as_number();
       if (std::floor(num) == num && num >= -1e15 && num <= 1e15) {
@@ -4539,6 +7312,8 @@ static void dumps_toml_impl(const Json& value, const std::string& prefix, std::s
           output += "\"\"";
         } else if (el.is_bool()) {
           output += el.as_bool() ? "true" : "false";
+        } else if (el.is_int64()) {
+          output += std::to_string(el.as_int64());
         } else if (el.is_number()) {
           double num = el.as_number();
           if (std::floor(num) == num && num >= -1e15 && num <= 1e15) {
@@ -4562,7 +7337,8 @@ static void dumps_toml_impl(const Json& value, const std::string& prefix, std::s
     
     if (val.is_object()) {
       std::string new_prefix = prefix.empty() ? key : prefix + "." + key;
-      output += "\n[" + new_prefix + "]\n";
+      if (output.size() != 0) output += '\n';  // no blank line before the first header
+      output += "[" + new_prefix + "]\n";
       dumps_toml_impl(val, new_prefix, output, false);
     }
   }
@@ -4576,7 +7352,8 @@ static void dumps_toml_impl(const Json& value, const std::string& prefix, std::s
       const auto& arr = val.as_array();
       std::string new_prefix = prefix.empty() ? key : prefix + "." + key;
       for (const auto& el : arr) {
-        output += "\n[[" + new_prefix + "]]\n";
+        if (output.size() != 0) output += '\n';
+        output += "[[" + new_prefix + "]]\n";
         dumps_toml_impl(el, new_prefix, output, false);
       }
     }
@@ -4585,14 +7362,16 @@ static void dumps_toml_impl(const Json& value, const std::string& prefix, std::s
 
 std::string dumps_toml(const Json& value) {
   std::string output;
-  dumps_toml_impl(value, "", output, true);
-  // Trim leading newline if present
-  if (!output.empty() && output[0] == '\n') {
-    output = output.substr(1);
-  }
+  OutputSink sink(output);
+  dumps_toml_impl(value, "", sink, true);
   return output;
 }
 
+void dump_toml(const Json& value, OutputSink& sink) {
+  dumps_toml_impl(value, "", sink, true);
+  sink.flush();
+}
+
 // ---------------- XML/HTML extraction/parsing/validation ----------------
 
 // HTML void elements (self-closing by default)
@@ -4622,13 +7401,15 @@ static std::string decode_html_entity(const std::string& entity) {
   
   // Numeric entity &#123; or &#x1F;
   if (!entity.empty() && entity[0] == '#') {
-    try {
-      unsigned long code = 0;
+    {
+      std::optional<unsigned long> parsed;
       if (entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X')) {
-        code = std::stoul(entity.substr(2), nullptr, 16);
+        parsed = checked_strto<unsigned long>(std::strtoul, entity.substr(2), 16);
       } else {
-        code = std::stoul(entity.substr(1), nullptr, 10);
+        parsed = checked_strto<unsigned long>(std::strtoul, entity.substr(1), 10);
       }
+      if (!parsed) return "&" + entity + ";";
+      const unsigned long code = *parsed;
       // Convert to UTF-8
       std::string utf8;
       if (code < 0x80) {
@@ -4647,8 +7428,6 @@ static std::string decode_html_entity(const std::string& entity) {
         utf8 += static_cast<char>(0x80 | (code & 0x3F));
       }
       return utf8;
-    } catch (...) {
-      return "&" + entity + ";";
     }
   }
   
@@ -4698,9 +7477,8 @@ std::string extract_xml_candidate(const std::string& text) {
   }
   if (start == std::string::npos) {
     // Find first < that starts a tag
-    for (size_t i = 0; i < text.size(); ++i) {
-      if (text[i] == '<' && i + 1 < text.size() && 
-          (std::isalpha(text[i + 1]) || text[i + 1] == '!' || text[i + 1] == '?')) {
+    for (size_t i = text.find('<'); i != std::string::npos; i = text.find('<', i + 1)) {
+      if (i + 1 < text.size() && (std::isalpha(text[i + 1]) || text[i + 1] == '!' || text[i + 1] == '?')) {
         start = i;
         break;
       }
@@ -4716,41 +7494,49 @@ std::string extract_xml_candidate(const std::string& text) {
   bool in_string = false;
   char string_char = 0;
   
+  // Only quotes and '>' matter inside a tag, and only '<' between tags, so the scan hops between those.
+  static const ByteScanner tag_scan("\"'>");
   for (size_t i = start; i < text.size(); ++i) {
-    char c = text[i];
-    
     if (in_string) {
-      if (c == string_char) in_string = false;
+      i = text.find(string_char, i);
+      if (i == std::string::npos) break;
+      in_string = false;
       continue;
     }
     
     if (in_tag) {
-      if (c == '"' || c == '\'') {
-        in_string = true;
-        string_char = c;
-      } else if (c == '>') {
+      i = tag_scan.find(text, i);
+      if (i == std::string::npos) break;
+      if (text[i] == '>') {
         in_tag = false;
         end = i + 1;
+      } else {
+        in_string = true;
+        string_char = text[i];
       }
       continue;
     }
     
-    if (c == '<') {
-      if (i + 1 < text.size()) {
-        if (text[i + 1] == '/') {
-          depth--;
-        } else if (text[i + 1] == '!' || text[i + 1] == '?') {
-          // Comment, doctype, or PI - don't change depth
-        } else if (std::isalpha(text[i + 1])) {
-          // Check for self-closing
-          size_t close = text.find('>', i);
-          if (close != std::string::npos && text[close - 1] != '/') {
-            depth++;
-          }
+    if (text[i] != '<') {
+      if (depth <= 0 && end > start) break;
+      i = text.find('<', i);
+      if (i == std::string::npos) break;
+    }
+
+    if (i + 1 < text.size()) {
+      if (text[i + 1] == '/') {
+        depth--;
+      } else if (text[i + 1] == '!' || text[i + 1] == '?') {
+        // Comment, doctype, or PI - don't change depth
+      } else if (std::isalpha(text[i + 1])) {
+        // Check for self-closing
+        size_t close = text.find('>', i);
+        if (close != std::string::npos && text[close - 1] != '/') {
+          depth++;
         }
       }
-      in_tag = true;
     }
+    in_tag = true;
     
     if (depth <= 0 && end > start) break;
   }
@@ -5245,7 +8031,7 @@ static std::string xml_escape(const std::string& s) {
   return result;
 }
 
-static void dumps_xml_impl(const XmlNode& node, int indent, int level, std::string& output, bool is_html) {
+static void dumps_xml_impl(const XmlNode& node, int indent, int level, OutputSink& output, bool is_html) {
   std::string ind(level * indent, ' ');
   
   switch (node.type) {
@@ -5324,16 +8110,28 @@ static void dumps_xml_impl(const XmlNode& node, int indent, int level, std::stri
 
 std::string dumps_xml(const XmlNode& node, int indent) {
   std::string output;
-  dumps_xml_impl(node, indent, 0, output, false);
+  OutputSink sink(output);
+  dumps_xml_impl(node, indent, 0, sink, false);
   return output;
 }
 
 std::string dumps_html(const XmlNode& node, int indent) {
   std::string output;
-  dumps_xml_impl(node, indent, 0, output, true);
+  OutputSink sink(output);
+  dumps_xml_impl(node, indent, 0, sink, true);
   return output;
 }
 
+void dump_xml(const XmlNode& node, OutputSink& sink, int indent) {
+  dumps_xml_impl(node, indent, 0, sink, false);
+  sink.flush();
+}
+
+void dump_html(const XmlNode& node, OutputSink& sink, int indent) {
+  dumps_xml_impl(node, indent, 0, sink, true);
+  sink.flush();
+}
+
 std::string xml_text_content(const XmlNode& node) {
   std::string result;
   
@@ -5433,15 +8231,17 @@ std::vector<const XmlNode*> query_xml(const XmlNode& root, const std::string& se
   return results;
 }
 
-void validate_xml(const XmlNode& node, const Json& schema, const std::string& path) {
-  if (!schema.is_object()) return;
+// validate_xml() reporting the first violation through `error` instead of throwing it.
+static bool validate_xml_impl(const XmlNode& node, const Json& schema, const std::string& path, std::optional<ValidationError>& error) {
+  if (!schema.is_object()) return true;
   const auto& s = schema.as_object();
   
   // Validate element name
   auto it = s.find("element");
   if (it != s.end() && it->second.is_string()) {
     if (node.name != it->second.as_string() && to_lower(node.name) != to_lower(it->second.as_string())) {
-      throw ValidationError("Expected element '" + it->second.as_string() + "' but got '" + node.name + "'", path, "schema");
+      error.emplace("Expected element '" + it->second.as_string() + "' but got '" + node.name + "'", path, "schema");
+      return false;
     }
   }
   
@@ -5451,7 +8251,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
     for (const auto& attr : it->second.as_array()) {
       if (attr.is_string()) {
         if (node.attributes.find(attr.as_string()) == node.attributes.end()) {
-          throw ValidationError("Missing required attribute '" + attr.as_string() + "'", path, "schema");
+          error.emplace("Missing required attribute '" + attr.as_string() + "'", path, "schema");
+          return false;
         }
       }
     }
@@ -5469,7 +8270,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
         if (pattern_it != attr_schema.end() && pattern_it->second.is_string()) {
           std::regex re(pattern_it->second.as_string());
           if (!std::regex_match(attr_it->second, re)) {
-            throw ValidationError("Attribute '" + kv.first + "' does not match pattern", path + "/@" + kv.first, "schema");
+            error.emplace("Attribute '" + kv.first + "' does not match pattern", path + "/@" + kv.first, "schema");
+            return false;
           }
         }
         // Enum validation
@@ -5483,7 +8285,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
             }
           }
           if (!found) {
-            throw ValidationError("Attribute '" + kv.first + "' value not in allowed enum", path + "/@" + kv.first, "schema");
+            error.emplace("Attribute '" + kv.first + "' value not in allowed enum", path + "/@" + kv.first, "schema");
+            return false;
           }
         }
       }
@@ -5503,7 +8306,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
         if (child.type == XmlNode::Type::Element) element_count++;
       }
       if (element_count < static_cast<size_t>(min_it->second.as_number())) {
-        throw ValidationError("Too few child elements", path, "limit");
+        error.emplace("Too few child elements", path, "limit");
+        return false;
       }
     }
     
@@ -5514,7 +8318,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
         if (child.type == XmlNode::Type::Element) element_count++;
       }
       if (element_count > static_cast<size_t>(max_it->second.as_number())) {
-        throw ValidationError("Too many child elements", path, "limit");
+        error.emplace("Too many child elements", path, "limit");
+        return false;
       }
     }
     
@@ -5532,7 +8337,8 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
           }
         }
         if (!found) {
-          throw ValidationError("Missing required child element '" + req.as_string() + "'", path, "schema");
+          error.emplace("Missing required child element '" + req.as_string() + "'", path, "schema");
+          return false;
         }
       }
     }
@@ -5544,11 +8350,17 @@ void validate_xml(const XmlNode& node, const Json& schema, const std::string& pa
     size_t idx = 0;
     for (const auto& child : node.children) {
       if (child.type == XmlNode::Type::Element) {
-        validate_xml(child, it->second, path + "/" + child.name + "[" + std::to_string(idx) + "]");
+        if (!validate_xml_impl(child, it->second, path + "/" + child.name + "[" + std::to_string(idx) + "]", error)) return false;
         idx++;
       }
     }
   }
+  return true;
+}
+
+void validate_xml(const XmlNode& node, const Json& schema, const std::string& path) {
+  std::optional<ValidationError> error;
+  if (!validate_xml_impl(node, schema, path, error)) throw *error;
 }
 
 XmlNode parse_and_validate_xml(const std::string& text, const Json& schema) {
@@ -5563,6 +8375,29 @@ XmlParseResult parse_and_validate_xml_ex(const std::string& text, const Json& sc
   return result;
 }
 
+TryResult<XmlNode> try_loads_xml(const std::string& text, const XmlRepairConfig& repair) {
+  TryResult<XmlNode> r;
+  run_guarded(r, [&] { r.value = std::move(loads_xml_ex(text, repair).root); });
+  return r;
+}
+
+TryStatus try_validate_xml(const XmlNode& node, const Json& schema, const std::string& path) {
+  TryStatus status;
+  run_guarded(status, [&] {
+    std::optional<ValidationError> error;
+    if (!validate_xml_impl(node, schema, path, error)) set_status(status, *error);
+  });
+  return status;
+}
+
+TryResult<XmlNode> try_parse_and_validate_xml(const std::string& text, const Json& schema, const XmlRepairConfig& repair) {
+  TryResult<XmlNode> r = try_loads_xml(text, repair);
+  if (r.ok()) {
+    if (TryStatus status = try_validate_xml(r.value, schema, "$"); !status.ok()) fail_result(r, std::move(status));
+  }
+  return r;
+}
+
 // ---------------- SQL extraction/parsing/validation ----------------
 
 static std::string strip_sql_strings_and_comments(const std::string& sql, bool& has_comments) {
@@ -5650,110 +8485,47 @@ static std::vector<std::string> tokenize_sql_identifiers(const std::string& sql_
 
 static std::optional<std::string> try_extract_sql_statement(const std::string& text) {
   // 1) ```sql fenced
-  {
-    auto lines = split_lines(text);
-    bool in = false;
-    std::ostringstream body;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-      std::string line = ltrim_copy(lines[idx]);
-      std::string low = to_lower(line);
-      if (!in) {
-        if (low.rfind("```sql", 0) == 0) {
-          in = true;
-          body.str("");
-          body.clear();
-        }
-      } else {
-        if (low.rfind("```", 0) == 0) {
-          std::string out = body.str();
-          if (!out.empty() && out.back() == '\n') out.pop_back();
-          return out;
-        }
-        body << lines[idx] << "\n";
-      }
-    }
-    if (in) return std::nullopt;
+  if (auto fence = find_fenced_lines(text, 0, {"sql"}, true)) {
+    if (fence->close == std::string::npos) return std::nullopt;
+    return fence_body_lines(text, *fence);
   }
 
   // 2) first statement terminated by ';' outside strings/comments
-  bool in_s = false;
-  bool in_d = false;
-  bool in_line_comment = false;
-  bool in_block_comment = false;
-
-  for (size_t i = 0; i < text.size(); ++i) {
-    char c = text[i];
-    char n = (i + 1 < text.size()) ? text[i + 1] : '\0';
-
-    if (in_line_comment) {
-      if (c == '\n') in_line_comment = false;
-      continue;
-    }
-    if (in_block_comment) {
-      if (c == '*' && n == '/') {
-        in_block_comment = false;
-        ++i;
-      }
-      continue;
-    }
-
-    if (!in_s && !in_d) {
-      if (c == '-' && n == '-') {
-        in_line_comment = true;
-        ++i;
-        continue;
-      }
-      if (c == '/' && n == '*') {
-        in_block_comment = true;
-        ++i;
-        continue;
-      }
-    }
-
-    if (!in_d && c == '\'' && !(i > 0 && text[i - 1] == '\\')) {
-      in_s = !in_s;
-      continue;
-    }
-    if (!in_s && c == '"' && !(i > 0 && text[i - 1] == '\\')) {
-      in_d = !in_d;
-      continue;
-    }
+  // A quote preceded by a backslash neither opens nor closes a string.
+  auto unescaped_quote = [&](size_t from, char q) {
+    size_t i = text.find(q, from);
+    while (i != std::string::npos && i > 0 && text[i - 1] == '\\') i = text.find(q, i + 1);
+    return i;
+  };
 
-    if (!in_s && !in_d && c == ';') {
+  // Outside strings and comments only these bytes change anything.
+  static const ByteScanner code_scan("-/'\";");
+  for (size_t i = code_scan.find(text, 0); i != std::string::npos; i = code_scan.find(text, i + 1)) {
+    const char c = text[i];
+    const char n = (i + 1 < text.size()) ? text[i + 1] : '\0';
+
+    if (c == '-' && n == '-') {
+      i = text.find('\n', i + 2);
+    } else if (c == '/' && n == '*') {
+      i = text.find("*/", i + 2);
+      if (i != std::string::npos) ++i;
+    } else if ((c == '\'' || c == '"') && !(i > 0 && text[i - 1] == '\\')) {
+      i = unescaped_quote(i + 1, c);  // the closing quote
+    } else if (c == ';') {
       std::string stmt = text.substr(0, i);
       if (!stmt.empty() && stmt.back() == '\r') stmt.pop_back();
       return stmt;
     }
+    if (i == std::string::npos) break;
   }
 
   return std::nullopt;
 }
 
 std::string extract_sql_candidate(const std::string& text) {
-  // ```sql fenced (scan lines; MSVC std::regex doesn't support (?is) flags)
-  {
-    auto lines = split_lines(text);
-    bool in = false;
-    std::ostringstream body;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-      std::string line = ltrim_copy(lines[idx]);
-      std::string low = to_lower(line);
-      if (!in) {
-        if (low.rfind("```sql", 0) == 0) {
-          in = true;
-          body.str("");
-          body.clear();
-        }
-      } else {
-        if (low.rfind("```", 0) == 0) {
-          std::string out = body.str();
-          if (!out.empty() && out.back() == '\n') out.pop_back();
-          return out;
-        }
-        body << lines[idx] << "\n";
-      }
-    }
-  }
+  // ```sql fenced
+  auto fence = find_fenced_lines(text, 0, {"sql"}, true);
+  if (fence && fence->close != std::string::npos) return fence_body_lines(text, *fence);
   // fallback: whole text
   return text;
 }
@@ -6234,23 +9006,132 @@ SqlParsed parse_and_validate_sql(const std::string& text, const Json& schema) {
   return p;
 }
 
+// ---------------- Mixed-format blocks ----------------
+
+// The format a fence tag names, for the tags extract_structured_blocks() reports.
+static std::optional<BlockFormat> block_format_for_tag(const std::string& tag) {
+  const std::string t = to_lower(tag);
+  if (t == "json" || t == "jsonc" || t == "json5") return BlockFormat::Json;
+  if (t == "yaml" || t == "yml") return BlockFormat::Yaml;
+  if (t == "toml") return BlockFormat::Toml;
+  if (t == "xml") return BlockFormat::Xml;
+  if (t == "html") return BlockFormat::Html;
+  if (t == "sql") return BlockFormat::Sql;
+  return std::nullopt;
+}
+
+// One forward pass: jump from fence line to fence line, matching bare JSON brackets in the prose between
+// them. Each stretch of prose is matched on its own, so no bare run crosses a fence.
+std::vector<StructuredBlock> extract_structured_blocks(const std::string& text) {
+  constexpr size_t npos = std::string::npos;
+  const size_t n = text.size();
+  std::vector<StructuredBlock> blocks;
+  auto add_bare_runs = [&](size_t from, size_t to) {
+    BracketMatcher brackets;
+    brackets.scan(text, from, to);
+    for (const auto& [start, end] : brackets.outer_runs()) {
+      blocks.push_back(StructuredBlock{BlockFormat::Json, std::string(), start, end, false});
+    }
+  };
+
+  for (size_t i = 0; i < n;) {
+    const size_t open = find_fence_line(text, i, {""}, false);
+    add_bare_runs(i, open == npos ? n : open);
+    if (open == npos) break;
+
+    const size_t tag_start = text.find('`', open) + 3;
+    size_t tag_end = tag_start;
+    while (tag_end < n && (std::isalnum(static_cast<unsigned char>(text[tag_end])) || text[tag_end] == '_' ||
+                           text[tag_end] == '-' || text[tag_end] == '+')) {
+      ++tag_end;
+    }
+    const size_t open_end = text.find('\n', open);
+    const size_t body = open_end == npos ? n : open_end + 1;
+    const size_t close = find_fence_line(text, body, {""}, false);
+    const std::string tag = text.substr(tag_start, tag_end - tag_start);
+    if (tag.empty()) {
+      add_bare_runs(body, close == npos ? n : close);  // an untagged fence holds JSON as often as not
+    } else if (auto format = block_format_for_tag(tag)) {
+      size_t end = close == npos ? n : close;
+      if (end > body && text[end - 1] == '\n') {
+        --end;
+        if (end > body && text[end - 1] == '\r') --end;
+      }
+      blocks.push_back(StructuredBlock{*format, tag, body, end, true});
+    }
+    if (close == npos) break;
+    const size_t close_end = text.find('\n', close);
+    i = close_end == npos ? n : close_end + 1;
+  }
+  return blocks;
+}
+
+// Each block goes straight to its format's parser: extraction already happened, and running it again on a
+// block could pick out a nested part (the first {...} inside a [...], say).
+std::vector<ParsedBlock> parse_structured_blocks(const std::string& text) {
+  std::vector<ParsedBlock> out;
+  for (StructuredBlock& block : extract_structured_blocks(text)) {
+    ParsedBlock parsed;
+    const std::string body = text.substr(block.start, block.end - block.start);
+    run_guarded(parsed, [&] {
+      switch (block.format) {
+        case BlockFormat::Json: {
+          TryResult<Json> r;
+          try_parse_json_candidate(body, RepairConfig{}, r);
+          static_cast<TryStatus&>(parsed) = r;
+          parsed.value = r.ok() ? std::move(r.value) : Json();
+          break;
+        }
+        case BlockFormat::Yaml: {
+          YamlRepairMetadata meta;
+          parsed.value = parse_yaml_impl(apply_yaml_repairs(body, YamlRepairConfig{}, meta));
+          break;
+        }
+        case BlockFormat::Toml: {
+          TomlRepairMetadata meta;
+          parsed.value = parse_toml_impl(apply_toml_repairs(body, TomlRepairConfig{}, meta));
+          break;
+        }
+        case BlockFormat::Xml:
+        case BlockFormat::Html: {
+          XmlRepairConfig cfg;
+          if (block.format == BlockFormat::Html) {
+            cfg.html_mode = true;
+            cfg.lowercase_names = true;
+          }
+          XmlRepairMetadata meta;
+          parsed.xml = parse_xml_impl(body, cfg, meta);
+          break;
+        }
+        case BlockFormat::Sql:
+          parsed.sql = parse_sql_statement_only(body);
+          break;
+      }
+    });
+    parsed.block = std::move(block);
+    out.push_back(std::move(parsed));
+  }
+  return out;
+}
+
 // ---------------- Streaming incremental parsing ----------------
 
-static StreamLocation compute_location_from_buffer(const std::string& buf) {
-  StreamLocation loc;
-  loc.offset = buf.size();
-  int line = 1;
-  int col = 1;
-  for (char c : buf) {
+// Moves `loc` past `chunk`, appended to the buffer it describes.
+static void advance_location(StreamLocation& loc, const std::string& chunk) {
+  loc.offset += chunk.size();
+  for (char c : chunk) {
     if (c == '\n') {
-      ++line;
-      col = 1;
+      ++loc.line;
+      loc.col = 1;
     } else {
-      ++col;
+      ++loc.col;
     }
   }
-  loc.line = line;
-  loc.col = col;
+}
+
+static StreamLocation compute_location_from_buffer(const std::string& buf) {
+  StreamLocation loc;
+  advance_location(loc, buf);
   return loc;
 }
 
@@ -6259,11 +9140,19 @@ JsonStreamParser::JsonStreamParser(Json schema) : schema_(std::move(schema)) {}
 JsonStreamParser::JsonStreamParser(Json schema, size_t max_buffer_bytes)
   : schema_(std::move(schema)), max_buffer_bytes_(max_buffer_bytes) {}
 
+JsonStreamParser::JsonStreamParser(CompiledSchema schema) : schema_(std::move(schema)) {}
+
+JsonStreamParser::JsonStreamParser(CompiledSchema schema, size_t max_buffer_bytes)
+  : schema_(std::move(schema)), max_buffer_bytes_(max_buffer_bytes) {}
+
 void JsonStreamParser::reset() {
   buf_.clear();
   finished_ = false;
   done_ = false;
+  scan_ = Scan{};
+  loc_ = StreamLocation{};
   last_ = StreamOutcome<Json>{};
+  partial_.reset();
 }
 
 void JsonStreamParser::finish() {
@@ -6274,6 +9163,7 @@ void JsonStreamParser::finish() {
 void JsonStreamParser::append(const std::string& chunk) {
   if (done_) return;
   buf_ += chunk;
+  advance_location(loc_, chunk);
 
   if (max_buffer_bytes_ > 0 && buf_.size() > max_buffer_bytes_) {
     done_ = true;
@@ -6288,12 +9178,91 @@ void JsonStreamParser::append(const std::string& chunk) {
   }
 }
 
-StreamLocation JsonStreamParser::location() const { return compute_location_from_buffer(buf_); }
+StreamLocation JsonStreamParser::location() const { return loc_; }
+
+// Feeds buf_[scan_.pos..) through the state that settles the stream's candidate, as if the whole buffer were
+// scanned: the first ```json fence line and whether it has closed, and the first balanced {...} and [...]
+// runs. Brackets stop mattering once a fence is seen or a {...} run closes; after that only line starts are
+// looked at.
+void JsonStreamParser::scan_appended() {
+  Scan& st = scan_;
+  const size_t n = buf_.size();
+  for (size_t i = st.pos; i < n; ++i) {
+    const bool brackets = st.fence == 0 && st.obj_end == 0;
+    if (st.line_match < 0 && !brackets && !(st.fence == 2 && st.fence_root == 0)) {
+      const void* nl = std::memchr(buf_.data() + i, '\n', n - i);
+      if (!nl) break;
+      i = static_cast<size_t>(static_cast<const char*>(nl) - buf_.data());
+    }
+    const char c = buf_[i];
+
+    if (c == '\n') {
+      if (st.fence == 1) {
+        st.fence = 2;
+        st.fence_body = i + 1;
+      }
+      st.line_start = i + 1;
+      st.line_match = st.fence == 3 ? -1 : 0;
+    } else if (st.line_match >= 0 && !(st.line_match == 0 && std::isspace(static_cast<unsigned char>(c)))) {
+      // The opening line is ```json in any case; any later line starting with ``` closes it.
+      const char* marker = st.fence == 0 ? "```json" : "```";
+      if (std::tolower(static_cast<unsigned char>(c)) != marker[st.line_match]) {
+        st.line_match = -1;
+      } else if (marker[++st.line_match] == '\0') {
+        st.line_match = -1;
+        if (st.fence == 0) {
+          st.fence = 1;
+        } else {
+          st.fence = 3;
+          st.fence_close = st.line_start;
+        }
+      }
+    }
+    if (st.fence == 3) break;  // settled: nothing later in the buffer changes the candidate
+    if (st.fence == 2 && st.fence_root == 0 && (c == '{' || c == '[')) st.fence_root = i;
+    if (!brackets) continue;
+
+    if (st.quote) {
+      if (st.escape) {
+        st.escape = false;
+      } else if (c == '\\') {
+        st.escape = true;
+      } else if (c == st.quote) {
+        st.quote = 0;
+      }
+    } else if (c == '"' || c == '\'') {
+      st.quote = c;
+    } else if (c == '{') {
+      if (st.obj_depth++ == 0) st.obj_start = i;
+    } else if (c == '}') {
+      if (st.obj_depth > 0 && --st.obj_depth == 0) st.obj_end = i + 1;
+    } else if (st.arr_end == 0) {
+      if (c == '[') {
+        if (st.arr_depth++ == 0) st.arr_start = i;
+      } else if (c == ']' && st.arr_depth > 0 && --st.arr_depth == 0) {
+        st.arr_end = i + 1;
+      }
+    }
+  }
+  st.pos = n;
+}
+
+// The candidate the buffer holds so far: a ```json fence's body once the fence closes (nothing while it is open),
+// else the first balanced {...} run, else the first balanced [...] run.
+std::optional<std::string> JsonStreamParser::scanned_candidate() const {
+  const Scan& st = scan_;
+  if (st.fence == 3) return fence_body_lines(buf_, FenceSpan{0, st.fence_body, st.fence_close});
+  if (st.fence != 0) return std::nullopt;  // fence started but not closed yet
+  if (st.obj_end) return buf_.substr(st.obj_start, st.obj_end - st.obj_start);
+  if (st.arr_end) return buf_.substr(st.arr_start, st.arr_end - st.arr_start);
+  return std::nullopt;
+}
 
 StreamOutcome<Json> JsonStreamParser::poll() {
   if (done_) return last_;
 
-  auto cand = try_extract_json_candidate(buf_);
+  scan_appended();
+  auto cand = scanned_candidate();
   if (!cand) {
     if (finished_) {
       done_ = true;
@@ -6332,11 +9301,184 @@ StreamOutcome<Json> JsonStreamParser::poll() {
   }
 }
 
+// Builds PartialJson::value a byte at a time from where the document starts. Bytes only ever land in the
+// innermost open value, so the pointers to the open containers stay valid while their children are appended.
+struct JsonStreamParser::PartialBuilder {
+  struct Frame {
+    Json* node;
+    bool object;
+    char expect;      // 'k' key, ':' colon, 'v' value, ',' separator or close
+    std::string key;  // the member name most recently read
+  };
+
+  size_t start{std::string::npos};  // where the document starts in the buffer
+  size_t pos{0};                    // next byte to feed
+  bool settled{false};              // `view` holds poll()'s final value
+  PartialJson view;
+  std::vector<Frame> frames;
+  std::string* text{nullptr};  // the open string: the top frame's key, or a string value in the tree
+  char quote{0};
+  bool escape{false};
+  std::string word;  // number or bare word still being read
+
+  void feed(const std::string& buf, size_t end) {
+    for (; pos < end && !view.complete; ++pos) {
+      const char c = buf[pos];
+      if (quote) {
+        if (escape) {
+          text->push_back(unescape_json_char(c));
+          escape = false;
+        } else if (c == '\\') {
+          escape = true;
+        } else if (c != quote) {
+          text->push_back(c);
+        } else {
+          quote = 0;
+          if (text == &frames.back().key) {
+            frames.back().expect = ':';
+          } else {
+            view.incomplete.pop_back();
+          }
+          text = nullptr;
+        }
+        continue;
+      }
+      if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.' || c == '_') {
+        word.push_back(c);
+        continue;
+      }
+      if (!word.empty()) end_word();
+
+      if (c == '"' || c == '\'') {
+        if (!frames.empty() && frames.back().object && frames.back().expect == 'k') {
+          text = &frames.back().key;
+          text->clear();
+        } else if (Json* slot = add_value(Json(std::string()), true)) {
+          text = &std::get<std::string>(slot->value);
+        } else {
+          continue;
+        }
+        quote = c;
+      } else if (c == '{' || c == '[') {
+        const bool object = c == '{';
+        if (Json* slot = add_value(object ? Json(JsonObject{}) : Json(JsonArray{}), true)) {
+          frames.push_back(Frame{slot, object, object ? 'k' : 'v', std::string()});
+        }
+      } else if ((c == '}' || c == ']') && !frames.empty()) {
+        frames.pop_back();
+        view.incomplete.pop_back();
+        if (frames.empty()) {
+          view.complete = true;
+        } else {
+          frames.back().expect = ',';
+        }
+      } else if (c == ',' && !frames.empty()) {
+        frames.back().expect = frames.back().object ? 'k' : 'v';
+      } else if (c == ':' && !frames.empty() && frames.back().expect == ':') {
+        frames.back().expect = 'v';
+      }
+    }
+  }
+
+  // Places `v` where the next value goes and returns it, or nullptr when no value is expected here. An
+  // `open` value's path joins the incomplete list.
+  Json* add_value(Json v, bool open) {
+    Json* slot = nullptr;
+    std::string path;
+    if (frames.empty()) {
+      if (pos != start) return nullptr;
+      slot = &view.value;
+      path = "$";
+    } else {
+      Frame& f = frames.back();
+      if (f.expect != 'v') return nullptr;
+      f.expect = ',';
+      if (f.object) {
+        if (open) path = view.incomplete[frames.size() - 1] + "." + f.key;
+        slot = &std::get<JsonObject>(f.node->value)[f.key];
+      } else {
+        JsonArray& arr = std::get<JsonArray>(f.node->value);
+        if (open) path = view.incomplete[frames.size() - 1] + "[" + std::to_string(arr.size()) + "]";
+        slot = &arr.emplace_back();
+      }
+    }
+    *slot = std::move(v);
+    if (open) view.incomplete.push_back(std::move(path));
+    return slot;
+  }
+
+  // A finished bare word is a key where one is expected, else a number, a literal or a string value.
+  void end_word() {
+    if (!frames.empty() && frames.back().object && frames.back().expect == 'k') {
+      frames.back().key = std::move(word);
+      frames.back().expect = ':';
+    } else if (word == "true" || word == "false") {
+      add_value(Json(word == "true"), false);
+    } else if (word == "null") {
+      add_value(Json(nullptr), false);
+    } else {
+      Parser p(word, true, RepairConfig::DuplicateKeyPolicy::FirstWins, nullptr);
+      const bool numeric = std::isdigit(static_cast<unsigned char>(word[0])) ||
+                           (word.size() > 1 && word[0] == '-' && std::isdigit(static_cast<unsigned char>(word[1])));
+      Json v = numeric ? p.parse_number() : Json(word);
+      add_value(numeric && p.i != word.size() ? Json(word) : std::move(v), false);
+    }
+    word.clear();
+  }
+};
+
+JsonStreamParser::JsonStreamParser(JsonStreamParser&&) noexcept = default;
+JsonStreamParser& JsonStreamParser::operator=(JsonStreamParser&&) noexcept = default;
+JsonStreamParser::~JsonStreamParser() = default;
+
+const PartialJson& JsonStreamParser::poll_partial() {
+  if (!partial_) partial_ = std::make_unique<PartialBuilder>();
+  PartialBuilder& pb = *partial_;
+  if (done_) {
+    if (last_.ok && !pb.settled) {
+      pb.view = PartialJson{*last_.value, {}, true};
+      pb.settled = true;
+    }
+    return pb.view;
+  }
+
+  // The document poll() will return: a ```json fence's body once one is seen, else the {...} run, else [...].
+  scan_appended();
+  const Scan& st = scan_;
+  size_t root = std::string::npos;
+  size_t end = buf_.size();
+  if (st.fence >= 2) {
+    if (st.fence_root) root = st.fence_root;
+    if (st.fence == 3) {
+      end = st.fence_close;
+    } else if (st.line_match >= 0) {
+      end = st.line_start;  // the last line may still turn out to close the fence
+    }
+  } else if (st.fence == 0) {
+    if (st.obj_depth > 0 || st.obj_end) {
+      root = st.obj_start;
+    } else if (st.arr_depth > 0 || st.arr_end) {
+      root = st.arr_start;
+    }
+  }
+  if (root != pb.start) {
+    pb = PartialBuilder{};
+    pb.start = pb.pos = root;
+  }
+  if (root != std::string::npos) pb.feed(buf_, end);
+  return pb.view;
+}
+
 JsonStreamCollector::JsonStreamCollector(Json item_schema) : schema_(std::move(item_schema)) {}
 
 JsonStreamCollector::JsonStreamCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items)
   : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
 
+JsonStreamCollector::JsonStreamCollector(CompiledSchema item_schema) : schema_(std::move(item_schema)) {}
+
+JsonStreamCollector::JsonStreamCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items)
+  : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
+
 void JsonStreamCollector::reset() {
   buf_.clear();
   closed_ = false;
@@ -6373,8 +9515,9 @@ StreamOutcome<JsonArray> JsonStreamCollector::poll() {
   if (done_) return last_;
 
   // Parse as many completed JSON candidates as we can.
+  StreamCandidateCursor cursor(buf_);
   for (;;) {
-    auto cand = pop_next_json_candidate(buf_);
+    auto cand = cursor.next();
     if (!cand) break;
 
     try {
@@ -6429,6 +9572,11 @@ JsonStreamBatchCollector::JsonStreamBatchCollector(Json item_schema) : schema_(s
 JsonStreamBatchCollector::JsonStreamBatchCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items)
   : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
 
+JsonStreamBatchCollector::JsonStreamBatchCollector(CompiledSchema item_schema) : schema_(std::move(item_schema)) {}
+
+JsonStreamBatchCollector::JsonStreamBatchCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items)
+  : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
+
 void JsonStreamBatchCollector::reset() {
   buf_.clear();
   closed_ = false;
@@ -6465,8 +9613,9 @@ StreamOutcome<JsonArray> JsonStreamBatchCollector::poll() {
   if (done_) return last_;
 
   JsonArray batch;
+  StreamCandidateCursor cursor(buf_);
   for (;;) {
-    auto cand = pop_next_json_candidate(buf_);
+    auto cand = cursor.next();
     if (!cand) break;
 
     try {
@@ -6531,6 +9680,11 @@ JsonStreamValidatedBatchCollector::JsonStreamValidatedBatchCollector(Json item_s
 JsonStreamValidatedBatchCollector::JsonStreamValidatedBatchCollector(Json item_schema, size_t max_buffer_bytes, size_t max_items)
   : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
 
+JsonStreamValidatedBatchCollector::JsonStreamValidatedBatchCollector(CompiledSchema item_schema) : schema_(std::move(item_schema)) {}
+
+JsonStreamValidatedBatchCollector::JsonStreamValidatedBatchCollector(CompiledSchema item_schema, size_t max_buffer_bytes, size_t max_items)
+  : schema_(std::move(item_schema)), max_buffer_bytes_(max_buffer_bytes), max_items_(max_items) {}
+
 void JsonStreamValidatedBatchCollector::reset() {
   buf_.clear();
   closed_ = false;
@@ -6565,13 +9719,14 @@ StreamOutcome<JsonArray> JsonStreamValidatedBatchCollector::poll() {
   if (done_) return last_;
 
   JsonArray batch;
+  StreamCandidateCursor cursor(buf_);
   for (;;) {
-    auto cand = pop_next_json_candidate(buf_);
+    auto cand = cursor.next();
     if (!cand) break;
 
     try {
       Json v = loads_jsonish(*cand);
-      apply_defaults(v, schema_);
+      apply_defaults(v, schema_.schema());
       validate(v, schema_);
       batch.push_back(v);
 
@@ -6633,38 +9788,20 @@ namespace {
 
 // Helper to detect string formats
 std::string detect_string_format(const std::string& s) {
-  // ISO 8601 date-time: 2024-01-15T10:30:00Z or 2024-01-15T10:30:00+08:00
-  static const std::regex datetime_regex(R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(\.\d+)?(Z|[+-]\d{2}:\d{2})?$)");
-  if (std::regex_match(s, datetime_regex)) return "date-time";
-  
-  // ISO 8601 date: 2024-01-15
-  static const std::regex date_regex(R"(^\d{4}-\d{2}-\d{2}$)");
-  if (std::regex_match(s, date_regex)) return "date";
-  
-  // ISO 8601 time: 10:30:00 or 10:30:00.123
-  static const std::regex time_regex(R"(^\d{2}:\d{2}:\d{2}(\.\d+)?$)");
-  if (std::regex_match(s, time_regex)) return "time";
-  
-  // Email (simplified)
-  static const std::regex email_regex(R"(^[a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,}$)");
-  if (std::regex_match(s, email_regex)) return "email";
-  
-  // URI
-  static const std::regex uri_regex(R"(^(https?|ftp|mailto|file|data)://[^\s]+$)");
-  if (std::regex_match(s, uri_regex)) return "uri";
-  
-  // UUID
-  static const std::regex uuid_regex(R"(^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}$)");
-  if (std::regex_match(s, uuid_regex)) return "uuid";
-  
-  // IPv4
-  static const std::regex ipv4_regex(R"(^(\d{1,3}\.){3}\d{1,3}$)");
-  if (std::regex_match(s, ipv4_regex)) return "ipv4";
-  
-  // Hostname
-  static const std::regex hostname_regex(R"(^[a-zA-Z0-9]([a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?(\.[a-zA-Z0-9]([a-zA-Z0-9-]{0,61}[a-zA-Z0-9])?)*$)");
-  if (std::regex_match(s, hostname_regex) && s.find('.') != std::string::npos) return "hostname";
-  
+  // Shares the validators behind schema "format", so inferred formats validate their own examples.
+  if (is_date_time_format(s)) return "date-time";
+  if (is_date_format(s)) return "date";
+  if (is_time_format(s)) return "time";
+  if (is_email_format(s)) return "email";
+
+  // Only URIs with an authority ("scheme://..."); bare "word:word" text is too common to tag.
+  if (is_uri_format(s) && s.find("://") != std::string::npos) return "uri";
+  if (is_uuid_format(s)) return "uuid";
+  if (is_ipv4_format(s)) return "ipv4";
+
+  // Single labels are ordinary words; require a dotted name.
+  if (is_hostname_format(s) && s.find('.') != std::string::npos) return "hostname";
+
   return "";
 }
 
@@ -6672,6 +9809,7 @@ std::string detect_string_format(const std::string& s) {
 std::string get_json_type(const Json& v) {
   if (v.is_null()) return "null";
   if (v.is_bool()) return "boolean";
+  if (v.is_int64()) return "integer";
   if (v.is_number()) {
     double d = v.as_number();
     if (d == std::floor(d) && std::abs(d) <= 9007199254740992.0) return "integer";
@@ -6755,7 +9893,7 @@ Json infer_schema_internal(const Json& value, const SchemaInferenceConfig& confi
     }
   } else if (value.is_number()) {
     double d = value.as_number();
-    bool is_int = (d == std::floor(d) && std::abs(d) <= 9007199254740992.0);
+    bool is_int = value.is_int64() || (d == std::floor(d) && std::abs(d) <= 9007199254740992.0);
     
     if (config.prefer_integer && is_int) {
       schema_obj["type"] = Json("integer");
@@ -1,8 +1,18 @@
 #include "llm_structured.hpp"
 
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <regex>
+#include <sstream>
 #include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
 
 using namespace llm_structured;
 
@@ -742,6 +752,1072 @@ static void test_additional_properties_schema_is_enforced() {
   assert(!errs.empty());
 }
 
+static void test_compiled_schema_matches_json_schema() {
+  Json schema = Json(JsonObject{
+      {"type", "object"},
+      {"required", JsonArray{Json("id"), Json("tags")}},
+      {"additionalProperties", Json(false)},
+      {"properties", Json(JsonObject{
+          {"id", Json(JsonObject{{"type", "integer"}, {"minimum", 1.0}})},
+          {"kind", Json(JsonObject{{"enum", JsonArray{Json("a"), Json("b")}}, {"default", "a"}})},
+          {"tags", Json(JsonObject{{"type", "array"}, {"items", Json(JsonObject{{"type", "string"}})}})},
+      })},
+  });
+  CompiledSchema compiled = compile_schema(schema);
+
+  // Reused across values; same acceptance and error paths as the raw schema.
+  validate(loads_jsonish("{\"id\": 1, \"kind\": \"b\", \"tags\": []}"), compiled);
+  const char* bad = "{\"id\": 0, \"kind\": \"c\", \"tags\": [1], \"extra\": true}";
+  auto raw_errs = validate_all(loads_jsonish(bad), schema);
+  auto compiled_errs = validate_all(loads_jsonish(bad), compiled);
+  assert(raw_errs.size() == compiled_errs.size());
+  for (size_t i = 0; i < raw_errs.size(); ++i) {
+    assert(raw_errs[i].path == compiled_errs[i].path);
+    assert(std::string(raw_errs[i].what()) == compiled_errs[i].what());
+  }
+  assert(has_error_path(compiled_errs, "$.tags[0]"));
+  assert(has_error_path(compiled_errs, "$.extra"));
+
+  // parse_and_validate* and defaults use the source schema.
+  Json v = parse_and_validate_with_defaults("```json\n{\"id\": 2, \"tags\": [\"x\"]}\n```", compiled);
+  assert(v.as_object().at("kind").as_string() == "a");
+
+  // Non-object sub-schemas still fail when they are applied.
+  CompiledSchema broken(Json(JsonObject{{"properties", Json(JsonObject{{"a", Json(1.0)}})}}));
+  validate(loads_jsonish("{\"b\": 1}"), broken);
+  try {
+    validate(loads_jsonish("{\"a\": 1}"), broken);
+    assert(false && "expected ValidationError");
+  } catch (const ValidationError& e) {
+    assert(e.path == "$.a");
+  }
+}
+
+static void test_compiled_schema_stream_collector() {
+  CompiledSchema item(Json(JsonObject{{"type", "object"}, {"required", JsonArray{Json("a")}}}));
+  JsonStreamCollector c(item);
+  c.append("{\"a\": 1}\n{\"a\": 2}");
+  c.close();
+  auto out = c.poll();
+  assert(out.done && out.ok);
+  assert(out.value && out.value->size() == 2);
+
+  JsonStreamParser p(item);
+  p.append("{\"b\": 1}");
+  auto r = p.poll();
+  assert(r.done && !r.ok);
+  assert(r.error && r.error->path == "$.a");
+}
+
+static void test_pattern_regex_cache_reuses_compiled_regex() {
+  clear_regex_cache();
+  Json schema = Json(JsonObject{{"type", "array"}, {"items", Json(JsonObject{{"pattern", "^[a-z]+$"}})}});
+
+  JsonArray items;
+  for (int i = 0; i < 100; ++i) items.push_back(Json("abc"));
+  validate(Json(items), schema);
+  RegexCacheStats st = regex_cache_stats();
+  assert(st.misses == 1);
+  assert(st.size == 1);
+
+  // Each Json-schema validation looks the pattern up once, not once per string.
+  validate(Json(items), schema);
+  assert(regex_cache_stats().hits == st.hits + 1);
+
+  // Invalid patterns are cached too and still reported per value.
+  CompiledSchema bad(Json(JsonObject{{"pattern", "(["}}));
+  auto errs = validate_all(Json("x"), bad);
+  assert(errs.size() == 1);
+  assert(std::string(errs[0].what()) == "invalid pattern regex");
+  assert(regex_cache_stats().misses == 2);
+  (void)validate_all(Json("y"), bad);
+  assert(regex_cache_stats().misses == 2);
+}
+
+static void test_string_format_validators() {
+  struct Case {
+    const char* format;
+    const char* good;
+    const char* bad;
+  };
+  const Case cases[] = {
+      {"email", "a.b+c@example.co", "a@b@example.com"},
+      {"uuid", "123e4567-e89b-12d3-a456-426614174000", "123e4567e89b12d3a456426614174000"},
+      {"date-time", "2024-02-29T23:59:60.5+08:00", "2023-02-29T10:00:00Z"},
+      {"date", "2024-01-15", "2024-13-01"},
+      {"time", "10:30:00Z", "24:00:00"},
+      {"ipv4", "192.168.0.255", "192.168.01.1"},
+      {"uri", "https://example.com/a?b=c", "not a uri"},
+      {"hostname", "api-1.example.com", "-bad.example.com"},
+  };
+  for (const auto& c : cases) {
+    Json schema = Json(JsonObject{{"type", "string"}, {"format", c.format}});
+    assert(matches_string_format(c.format, c.good));
+    assert(!matches_string_format(c.format, c.bad));
+    validate(Json(c.good), schema);
+    auto errs = validate_all(Json(c.bad), schema);
+    assert(errs.size() == 1);
+    assert(std::string(errs[0].what()) == std::string("string does not match ") + c.format + " format");
+  }
+  assert(matches_string_format("unknown-format", "anything"));
+
+  // Inference uses the same validators.
+  Json inferred = infer_schema(loads_jsonish("{\"at\": \"2024-01-15T10:30:00Z\", \"ip\": \"10.0.0.1\", \"word\": \"hello\"}"));
+  const auto& props = inferred.as_object().at("properties").as_object();
+  assert(props.at("at").as_object().at("format").as_string() == "date-time");
+  assert(props.at("ip").as_object().at("format").as_string() == "ipv4");
+  assert(props.at("word").as_object().count("format") == 0);
+}
+
+static void test_pattern_linear_time_engine() {
+  clear_regex_cache();
+  // Same answers as std::regex_search for the supported subset.
+  const char* patterns[] = {"^[a-z]+(-[a-z0-9]+)*$", "\\bfoo\\b", "colou?r", "^\\d{3}-\\d{2,4}$", "(?:ab|cd)+?x", "[^\\s]\\.[A-Z]"};
+  const char* inputs[] = {"", "abc", "my-slug-2", "foo bar", "foobar", "color", "colour", "123-4567", "ababx", "a.B", "a .B"};
+  for (const char* p : patterns) {
+    std::regex re(p, std::regex::ECMAScript);
+    Json schema = Json(JsonObject{{"type", "string"}, {"pattern", p}});
+    for (const char* in : inputs) {
+      assert(validate_all(Json(in), schema).empty() == std::regex_search(std::string(in), re));
+    }
+  }
+  assert(regex_cache_stats().fallbacks == 0);
+
+  // Nested quantifiers that make backtracking engines explode stay linear.
+  Json nested = Json(JsonObject{{"pattern", "^(a+)+$"}});
+  std::string input(5000, 'a');
+  input += "!";
+  assert(!validate_all(Json(input), nested).empty());
+
+  // Backreferences fall back to std::regex unless the fallback is disabled.
+  Json backref = Json(JsonObject{{"pattern", "^(a|b)\\1$"}});
+  validate(Json("aa"), backref);
+  assert(!validate_all(Json("ab"), backref).empty());
+  assert(regex_cache_stats().fallbacks == 1);
+
+  set_pattern_regex_fallback(false);
+  auto errs = validate_all(Json("aa"), backref);
+  assert(errs.size() == 1);
+  assert(std::string(errs[0].what()).find("unsupported pattern regex") == 0);
+  set_pattern_regex_fallback(true);
+  assert(pattern_regex_fallback());
+  validate(Json("bb"), backref);
+}
+
+static void test_validate_error_paths_nested() {
+  Json row = Json(JsonObject{
+      {"type", "object"},
+      {"required", JsonArray{Json("id")}},
+      {"propertyNames", Json(JsonObject{{"maxLength", 4.0}})},
+      {"properties", Json(JsonObject{
+          {"tags", Json(JsonObject{{"type", "array"}, {"items", Json(JsonObject{{"type", "string"}})}})},
+      })},
+  });
+  Json schema = Json(JsonObject{
+      {"type", "object"},
+      {"properties", Json(JsonObject{{"rows", Json(JsonObject{{"type", "array"}, {"items", row}})}})},
+  });
+  Json v = loads_jsonish("{\"rows\": [{\"id\": 1, \"tags\": [\"a\", 2]}, {\"long_name\": 0}]}");
+  auto errs = validate_all(v, schema, "$[7]");
+  assert(has_error_path(errs, "$[7].rows[0].tags[1]"));
+  assert(has_error_path(errs, "$[7].rows[1].id"));
+  assert(has_error_path(errs, "$[7].rows[1].<propertyNames>"));
+  assert(errs.size() == 3);
+}
+
+static void test_combinators_probe_without_errors() {
+  // Failing branches are probed without leaking their errors into validate_all.
+  JsonArray branches;
+  for (int i = 0; i < 8; ++i) {
+    branches.push_back(Json(JsonObject{
+        {"required", JsonArray{Json("kind")}},
+        {"properties", Json(JsonObject{{"kind", Json(JsonObject{{"const", "k" + std::to_string(i)}})}})},
+    }));
+  }
+  Json schema = Json(JsonObject{{"oneOf", Json(branches)}});
+  validate(loads_jsonish("{\"kind\": \"k5\"}"), schema);
+  auto errs = validate_all(loads_jsonish("{\"kind\": \"k9\"}"), schema);
+  assert(errs.size() == 1);
+  assert(std::string(errs[0].what()) == "does not match oneOf");
+
+  // A malformed branch (non-object property schema) simply does not match.
+  Json any = Json(JsonObject{{"anyOf", JsonArray{
+      Json(JsonObject{{"type", "object"}, {"properties", Json(JsonObject{{"a", Json(1.0)}})}}),
+      Json(JsonObject{{"type", "string"}}),
+  }}});
+  validate(Json("x"), any);
+  assert(!validate_all(loads_jsonish("{\"a\": 1}"), any).empty());
+  assert(!validate_all(Json(1.0), any).empty());
+}
+
+static void test_discriminated_union_dispatch() {
+  auto variant = [](const char* tag, const char* value_type) {
+    return Json(JsonObject{
+        {"type", "object"},
+        {"required", JsonArray{Json("type"), Json("value")}},
+        {"properties", Json(JsonObject{
+            {"type", Json(JsonObject{{"const", tag}})},
+            {"value", Json(JsonObject{{"type", value_type}})},
+        })},
+    });
+  };
+  Json schema = Json(JsonObject{{"oneOf", JsonArray{
+      variant("text", "string"),
+      variant("count", "integer"),
+      Json(JsonObject{{"type", "object"}, {"required", JsonArray{Json("type"), Json("value")}},
+                      {"properties", Json(JsonObject{{"type", Json(JsonObject{{"enum", JsonArray{Json("flag"), Json("toggle")}}})},
+                                                     {"value", Json(JsonObject{{"type", "boolean"}})}})}}),
+  }}});
+  validate(loads_jsonish("{\"type\": \"count\", \"value\": 3}"), schema);
+  validate(loads_jsonish("{\"type\": \"toggle\", \"value\": true}"), schema);
+  assert(!validate_all(loads_jsonish("{\"type\": \"count\", \"value\": \"3\"}"), schema).empty());
+  assert(!validate_all(loads_jsonish("{\"type\": \"other\", \"value\": 3}"), schema).empty());
+  assert(!validate_all(loads_jsonish("{\"value\": 3}"), schema).empty());
+
+  // Two branches pinned to the same tag that both match still violate oneOf; unpinned branches are still tried.
+  Json overlap = Json(JsonObject{{"discriminator", Json(JsonObject{{"propertyName", "type"}})}, {"oneOf", JsonArray{
+      variant("text", "string"),
+      variant("text", "string"),
+      Json(JsonObject{{"required", JsonArray{Json("other")}}}),
+  }}});
+  assert(!validate_all(loads_jsonish("{\"type\": \"text\", \"value\": \"a\"}"), overlap).empty());
+  validate(loads_jsonish("{\"type\": \"nope\", \"other\": 1}"), overlap);
+
+  // Repair picks the branch named by the tag.
+  Json any = Json(JsonObject{{"anyOf", JsonArray{variant("text", "string"), variant("count", "integer")}}});
+  auto r = validate_with_repair(loads_jsonish("{\"type\": \"count\", \"value\": \"3\"}"), any);
+  assert(r.fully_repaired);
+  assert(r.repaired_value.as_object().at("value").as_number() == 3);
+}
+
+static void test_strict_fast_path() {
+  auto clean = loads_jsonish_ex("```json\n{\"a\": [1, 2], \"b\": \"x\"}\n```");
+  assert(clean.metadata.used_strict_fast_path);
+  assert(clean.metadata.extracted_from_fence);
+  assert(!clean.metadata.dropped_trailing_commas && !clean.metadata.quoted_unquoted_keys);
+  assert(clean.fixed == "{\"a\": [1, 2], \"b\": \"x\"}");
+
+  auto repaired = loads_jsonish_ex("{a: 1, b: [True, None],}");
+  assert(!repaired.metadata.used_strict_fast_path);
+  assert(repaired.metadata.quoted_unquoted_keys && repaired.metadata.dropped_trailing_commas);
+  assert(repaired.value.as_object().at("a").as_number() == 1);
+
+  RepairConfig cfg;
+  cfg.strict_fast_path = false;
+  assert(!loads_jsonish_ex("{\"a\": 1}", cfg).metadata.used_strict_fast_path);
+
+  // Duplicate keys are still reported from the fast path.
+  RepairConfig dup;
+  dup.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::Error;
+  bool threw = false;
+  try {
+    (void)loads_jsonish_ex("{\"a\": 1, \"a\": 2}", dup);
+  } catch (const ValidationError& e) {
+    threw = true;
+    assert(e.path == "$.a");
+  }
+  assert(threw);
+}
+
+static void test_fused_repair_scan() {
+  // Every repair in one candidate; comments may hide quotes and commas that must not be touched.
+  auto r = loads_jsonish_ex(
+      "{name: \xE2\x80\x9Cx, y\xE2\x80\x9D, /* a: True, */ ok: True, // 'quote\n"
+      " note: None, list: [1, 2,], url: 'http://a/b', Nonex: False,}");
+  assert(r.metadata.fixed_smart_quotes && r.metadata.stripped_comments && r.metadata.replaced_python_literals);
+  assert(r.metadata.quoted_unquoted_keys && r.metadata.dropped_trailing_commas);
+  assert(!r.metadata.converted_kv_object);
+  assert(r.fixed == "{\"name\": \"x, y\",  \"ok\": true, \n \"note\": null, \"list\": [1, 2], "
+                    "\"url\": 'http://a/b', \"Nonex\": false}");
+  const auto& o = r.value.as_object();
+  assert(o.at("name").as_string() == "x, y");
+  assert(o.at("note").is_null());
+  assert(o.at("url").as_string() == "http://a/b");
+  assert(o.count("a") == 0);
+
+  // key=value lines are converted before keys would be quoted.
+  auto kv = loads_jsonish_ex("```json\na = True\nb = 'x, y'\n```");
+  assert(kv.metadata.converted_kv_object && !kv.metadata.quoted_unquoted_keys);
+  assert(kv.value.as_object().at("a").as_bool());
+  assert(kv.value.as_object().at("b").as_string() == "x, y");
+}
+
+static void test_number_parsing_matches_strtod() {
+  const std::vector<std::string> tokens = {"0", "-0", "42", "-17", "123456789012345", "1234567890123456789",
+                                           "0.1", "-2.5e-3", "6.02214076E23", "1e400", "-1e400", "4.9e-324",
+                                           "1e-400", "0.30000000000000004", "9007199254740993"};
+  std::string text = "{\"v\": [";
+  for (size_t i = 0; i < tokens.size(); ++i) text += (i ? ", " : "") + tokens[i];
+  text += "]}";
+  Json parsed = loads_jsonish(text);
+  const auto& arr = parsed.as_object().at("v").as_array();
+  assert(arr.size() == tokens.size());
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    double expected = std::strtod(tokens[i].c_str(), nullptr);
+    double got = arr[i].as_number();
+    assert(std::memcmp(&expected, &got, sizeof(double)) == 0);
+  }
+}
+
+static void test_int64_exact_numbers() {
+  Json v = loads_jsonish("{\"id\": 9007199254740993, \"neg\": -42, \"f\": 1.0, \"z\": -0, \"big\": 99999999999999999999}");
+  const auto& o = v.as_object();
+  assert(o.at("id").is_int64() && o.at("id").as_int64() == 9007199254740993LL);
+  assert(o.at("neg").is_int64() && o.at("neg").as_number() == -42.0);
+  assert(!o.at("f").is_int64() && o.at("f").is_number());
+  assert(!o.at("z").is_int64() && std::signbit(o.at("z").as_number()));
+  assert(!o.at("big").is_int64() && o.at("big").as_number() == 1e20);
+  assert(dumps_json(o.at("id")) == "9007199254740993");
+  assert(dumps_json(Json(int64_t{-9223372036854775807LL - 1})) == "-9223372036854775808");
+
+  // 2^53 + 1 is odd, but its nearest double is even.
+  Json even = Json(JsonObject{{"type", "integer"}, {"multipleOf", Json(2)}});
+  assert(!validate_all(o.at("id"), even).empty());
+  validate(Json(int64_t{9007199254740994LL}), even);
+  validate(Json(2.0), even);
+  assert(!validate_all(Json(2.5), even).empty());
+
+  Json same = Json(JsonObject{{"enum", JsonArray{Json(1), Json("x")}}});
+  validate(Json(1.0), same);
+}
+
+static void test_json_document_arena() {
+  const std::string text = "```json\n{\"b\": [1, 2.5, \"x\\ny\", null, true], \"a\": {\"k\": \"v\"}}\n```";
+  JsonDocument doc;
+  RepairMetadata meta = loads_jsonish_into(doc, text);
+  assert(meta.used_strict_fast_path && meta.extracted_from_fence);
+  const JsonNode& root = doc.root();
+  assert(root.is_object() && root.size() == 2);
+  assert(root.member(0).key == "b");  // source order
+  const JsonNode& b = *root.find("b");
+  assert(b.size() == 5 && b[0].is_int64() && b[1].as_number() == 2.5);
+  assert(b[2].as_string() == "x\ny" && b[3].is_null() && b[4].as_bool());
+  assert(root.find("a")->find("k")->as_string() == "v");
+  assert(root.find("missing") == nullptr);
+  assert(dumps_json(doc.to_json()) == dumps_json(loads_jsonish(text)));
+
+  // Repairs and duplicate-key policies behave as in loads_jsonish_ex.
+  meta = loads_jsonish_into(doc, "{a: 1, a: 2, c: [True,],}");
+  assert(!meta.used_strict_fast_path && meta.quoted_unquoted_keys && meta.duplicateKeyCount == 1);
+  assert(doc.root().find("a")->as_int64() == 1 && doc.root().find("c")->size() == 1);
+  RepairConfig last;
+  last.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::LastWins;
+  loads_jsonish_into(doc, "{\"a\": 1, \"a\": 2}", last);
+  assert(doc.root().find("a")->as_int64() == 2 && doc.root().size() == 1);
+  // Wide objects find duplicates through an index, nested objects keeping their own.
+  std::string wide = "{";
+  for (int i = 0; i < 40; ++i) wide += "\"k" + std::to_string(i) + "\": {\"k" + std::to_string(i) + "\": " + std::to_string(i) + "}, ";
+  wide += "\"k7\": 99, \"k39\": 98}";
+  loads_jsonish_into(doc, wide, last);
+  assert(doc.root().size() == 40 && doc.root().find("k7")->as_int64() == 99 && doc.root().find("k39")->as_int64() == 98);
+  assert(doc.root().find("k8")->find("k8")->as_int64() == 8);
+  meta = loads_jsonish_into(doc, wide);
+  assert(meta.duplicateKeyCount == 2 && doc.root().find("k7")->find("k7")->as_int64() == 7);
+
+  // Reparsing reuses the arena instead of growing it.
+  std::string big = "{\"rows\": [";
+  for (int i = 0; i < 2000; ++i) big += std::string(i ? "," : "") + "{\"id\": " + std::to_string(i) + ", \"name\": \"row\"}";
+  big += "]}";
+  loads_jsonish_into(doc, big);
+  size_t reserved = doc.arena_bytes();
+  loads_jsonish_into(doc, big);
+  assert(doc.arena_bytes() == reserved);
+  assert(doc.root().find("rows")->size() == 2000);
+
+  bool threw = false;
+  try {
+    loads_jsonish_into(doc, "{\"a\": [1, 2}");
+  } catch (const ValidationError& e) {
+    threw = true;
+    assert(e.kind == "parse");
+  }
+  assert(threw && doc.root().is_null());
+}
+
+static void test_json_object_insertion_order() {
+  Json v = loads_jsonish("{\"z\": 1, \"a\": {\"y\": true, \"b\": null}, \"m\": [1]}");
+  assert(dumps_json(v) == "{\"z\":1,\"a\":{\"y\":true,\"b\":null},\"m\":[1]}");
+
+  // Past the index threshold lookups, overwrites and erases stay consistent.
+  JsonObject big;
+  for (int i = 0; i < 100; ++i) big["k" + std::to_string(i)] = Json(i);
+  assert(big.size() == 100 && big.at("k42").as_int64() == 42);
+  assert(!big.emplace("k7", Json(0)).second && big.at("k7").as_int64() == 7);
+  assert(big.erase("k7") == 1 && big.count("k7") == 0 && big.at("k8").as_int64() == 8);
+  assert(big.begin()->first == "k0" && (big.end() - 1)->first == "k99");
+  big["k7"] = Json(70);
+  assert((big.end() - 1)->first == "k7" && big.find("k7")->second.as_int64() == 70);
+  // Erasing in place keeps the index consistent down through the threshold.
+  for (int i = 0; i < 100; i += 3) assert(big.erase("k" + std::to_string(i)) == 1);
+  for (int i = 0; i < 100; ++i) {
+    auto it = big.find("k" + std::to_string(i));
+    assert((i % 3 == 0) == (it == big.end()));
+    if (it != big.end()) assert(it->second.as_int64() == (i == 7 ? 70 : i));
+  }
+  while (big.size() > 10) big.erase(big.begin() + 1);
+  assert(big.begin()->first == "k1" && big.find("k7")->second.as_int64() == 70);
+  assert(big.count("k2") == 0 && big.count("k98") == 1);
+
+  // Keys are read-only through iterators, as with std::map; values stay writable.
+  static_assert(!std::is_assignable_v<decltype((big.begin()->first)), std::string>);
+  static_assert(!std::is_assignable_v<decltype(((*big.begin()).first)), std::string>);
+  static_assert(std::is_assignable_v<decltype((big.begin()->second)), Json>);
+  for (auto [key, value] : big) value = Json(key);
+  assert(big.at("k1").as_string() == "k1" && std::next(big.cbegin(), 2)->first == (big.begin() + 2)->first);
+
+  // const/enum comparisons ignore key order.
+  Json schema = Json(JsonObject{{"enum", JsonArray{Json(JsonObject{{"a", Json(1)}, {"b", Json(2)}})}}});
+  validate(loads_jsonish("{\"b\": 2, \"a\": 1}"), schema);
+  assert(!validate_all(loads_jsonish("{\"b\": 2, \"a\": 3}"), schema).empty());
+}
+
+static void test_json_view_tape() {
+  const std::string json =
+      "{\"route\": \"search\", \"args\": {\"q\": \"a\\\"b\\nc\", \"k\\u\": 1}, "
+      "\"items\": [1, -2.5, 9007199254740993, true, null, [], {\"x\": \"y\"}], \"route\": \"dup\"}";
+  JsonTape tape = parse_json_tape(json);
+  JsonView root = tape.root();
+  assert(tape.text().data() == json.data());  // zero-copy
+  assert(root.is_object() && root.size() == 4);
+  assert(root.find("route")->raw_string() == "search");  // first duplicate wins
+  assert(root.at_path("$.args.q")->raw_string() == "a\\\"b\\nc");
+  assert(root.at_path("args.q")->as_string() == "a\"b\nc");
+  assert(root.at_path("$.args[\"ku\"]")->as_int64() == 1);
+  JsonView items = *root.find("items");
+  assert(items.size() == 7 && items[1].as_number() == -2.5 && !items[1].is_int64());
+  assert(items[2].as_int64() == 9007199254740993LL && items[3].as_bool() && items[4].is_null());
+  assert(items[5].size() == 0 && items[6].find("x")->as_string() == "y");
+  assert(root.at_path("$.items[6].x")->as_string() == "y");
+  assert(!root.at_path("$.items[7]") && !root.at_path("$.nope.x"));
+  size_t keys = 0;
+  for (JsonView v : root) keys += v.key().empty() ? 0 : 1;
+  assert(keys == 4);
+  assert(dumps_json(root.to_json()) == dumps_json(loads_jsonish(json)));
+
+  // The jsonish entry point extracts, repairs and then owns the candidate text.
+  JsonTape repaired = loads_jsonish_tape("Result:\n```json\n{route: 'plan', steps: [1, 2,],}\n```");
+  assert(repaired.metadata().quoted_unquoted_keys && repaired.metadata().extracted_from_fence);
+  assert(repaired.root().find("route")->as_string() == "plan" && repaired.root().at_path("steps")->size() == 2);
+
+  // loads_jsonish_tape follows duplicate_key_policy like loads_jsonish_ex.
+  const std::string dup = "{\"a\": 1, \"b\": {\"c\": 2}, \"a\": 3}";
+  RepairConfig policy;
+  JsonTape first = loads_jsonish_tape(dup, policy);
+  assert(first.metadata().duplicateKeyCount == 1 && first.root().size() == 2 && first.root().find("a")->as_int64() == 1);
+  policy.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::LastWins;
+  JsonTape last = loads_jsonish_tape(dup, policy);
+  assert(last.root().size() == 2 && last.root().find("a")->as_int64() == 3);
+  assert(last.root().to_json() == loads_jsonish_ex(dup, policy).value);
+  // The winner is reported in the first occurrence's slot, as in loads_jsonish_ex.
+  const std::string chain = R"({"a": {"x": [1]}, "k": 1, "a": null, "a": [2, {"y": 3}], "z": 0})";
+  JsonTape chained = loads_jsonish_tape(chain, policy);
+  assert(dumps_json(chained.root().to_json()) == R"({"a":[2,{"y":3}],"k":1,"z":0})");
+  assert(dumps_json(chained.root().to_json()) == dumps_json(loads_jsonish_ex(chain, policy).value));
+  assert(chained.root().size() == 3 && chained.root().begin() != chained.root().end());
+  assert((*chained.root().begin()).key() == "a" && chained.root().at_path("$.a[1].y")->as_int64() == 3);
+  policy.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::Error;
+  bool threw = false;
+  try {
+    (void)loads_jsonish_tape(dup, policy);
+  } catch (const ValidationError& e) {
+    threw = e.path == "$.a";
+  }
+  assert(threw);
+
+  threw = false;
+  try {
+    (void)parse_json_tape("{\"a\": [1, 2}");
+  } catch (const ValidationError& e) {
+    threw = e.kind == "parse";
+  }
+  assert(threw);
+}
+
+// Records events as a compact trace; stops after `limit` events when set.
+struct SaxTrace : JsonSaxHandler {
+  std::string out;
+  int limit{-1};
+  bool emit(const std::string& ev) {
+    out += ev;
+    out += ' ';
+    return --limit != 0;
+  }
+  bool on_null() override { return emit("null"); }
+  bool on_bool(bool b) override { return emit(b ? "true" : "false"); }
+  bool on_integer(int64_t v) override { return emit("i" + std::to_string(v)); }
+  bool on_number(double v) override { return emit("d" + std::to_string(v)); }
+  bool on_string(std::string_view s) override { return emit("s:" + std::string(s)); }
+  bool on_array_start() override { return emit("["); }
+  bool on_array_end() override { return emit("]"); }
+  bool on_object_start() override { return emit("{"); }
+  bool on_key(std::string_view k) override { return emit("k:" + std::string(k)); }
+  bool on_object_end() override { return emit("}"); }
+};
+
+static void test_sax_events() {
+  SaxTrace t;
+  RepairMetadata meta = parse_jsonish_sax("{\"a\": [1, -2.5, \"x\\ny\"], \"b\": {\"c\": null, \"d\": true}}", t);
+  assert(t.out == "{ k:a [ i1 d-2.500000 s:x\ny ] k:b { k:c null k:d true } } ");
+  assert(meta.used_strict_fast_path);
+
+  // Same repairs as loads_jsonish_ex.
+  SaxTrace r;
+  meta = parse_jsonish_sax("Sure:\n```json\n{name: 'x', ok: True, n: [1,2,],}\n```", r);
+  assert(r.out == "{ k:name s:x k:ok true k:n [ i1 i2 ] } ");
+  assert(meta.quoted_unquoted_keys && meta.replaced_python_literals && meta.extracted_from_fence);
+
+  // Duplicate members follow the key policy, like the DOM parser.
+  RepairConfig cfg;
+  SaxTrace first;
+  meta = parse_jsonish_sax("{\"a\": 1, \"b\": 2, \"a\": 3}", first, cfg);
+  assert(first.out == "{ k:a i1 k:b i2 } " && meta.duplicateKeyCount == 1);
+  cfg.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::LastWins;
+  SaxTrace last;
+  parse_jsonish_sax("{\"a\": 1, \"b\": 2, \"a\": 3}", last, cfg);
+  assert(last.out == "{ k:a i3 k:b i2 } ");  // the winner keeps the first occurrence's position
+  cfg.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::Error;
+  SaxTrace dup;
+  bool threw = false;
+  try {
+    parse_jsonish_sax("{\"a\": 1, \"a\": 3}", dup, cfg);
+  } catch (const ValidationError& e) {
+    threw = e.path == "$.a" && e.kind == "parse";
+  }
+  assert(threw && dup.out.empty());
+
+  // Past the small-object threshold duplicates are found through the index, escaped spellings included.
+  std::string wide = "{";
+  for (int i = 0; i < 40; ++i) wide += "\"k" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+  wide += "\"\\k5\": 99, \"k39\": 98}";
+  cfg.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::FirstWins;
+  SaxTrace wide_first;
+  meta = parse_jsonish_sax(wide, wide_first, cfg);
+  assert(meta.duplicateKeyCount == 2 && wide_first.out.find("{ k:k0 i0 ") == 0);
+  assert(wide_first.out.find("k:k5 i5 ") != std::string::npos && wide_first.out.find("i99") == std::string::npos);
+  cfg.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::LastWins;
+  SaxTrace wide_last;
+  parse_jsonish_sax(wide, wide_last, cfg);
+  assert(wide_last.out.find("k:k5 i5 ") == std::string::npos);
+  assert(wide_last.out.find("k:k4 i4 k:k5 i99 k:k6 i6 ") != std::string::npos);
+  const std::string tail = "k:k38 i38 k:k39 i98 } ";
+  assert(wide_last.out.size() > tail.size() && wide_last.out.compare(wide_last.out.size() - tail.size(), tail.size(), tail) == 0);
+
+  // Returning false stops the events; an unparseable candidate reports nothing.
+  SaxTrace stop;
+  stop.limit = 3;
+  parse_jsonish_sax("{\"a\": [1, 2, 3]}", stop);
+  assert(stop.out == "{ k:a [ ");
+  // Events come from the scan itself: stopping early leaves the later duplicates unread.
+  SaxTrace early;
+  early.limit = 2;
+  meta = parse_jsonish_sax("{\"a\": 1, \"a\": 2, \"b\": [3], \"b\": 4}", early);
+  assert(early.out == "{ k:a " && meta.duplicateKeyCount == 0);
+  SaxTrace bad;
+  threw = false;
+  try {
+    parse_jsonish_sax("{\"a\": [1, 2}", bad);
+  } catch (const ValidationError&) {
+    threw = true;
+  }
+  assert(threw && bad.out.empty());
+}
+
+static void test_fused_parse_validate() {
+  CompiledSchema schema(loads_jsonish(R"({
+    "type": "object",
+    "required": ["id", "tags"],
+    "additionalProperties": false,
+    "properties": {
+      "id": {"type": "integer", "minimum": 1},
+      "tags": {"type": "array", "maxItems": 3, "items": {"type": "string", "minLength": 1}},
+      "meta": {"type": "object", "properties": {"score": {"type": "number"}}},
+      "kind": {"enum": ["a", "b"]}
+    }
+  })"));
+
+  // Same outcome as the two-pass path on valid and invalid input.
+  const std::vector<std::string> cases = {
+      R"({"id": 3, "tags": ["x", "y"], "meta": {"score": 0.5, "note": "n"}, "kind": "a"})",
+      R"({"id": 3, "tags": ["x", "y", "z", "w"]})",
+      R"({"id": 0, "tags": []})",
+      R"({"id": 3})",
+      R"({"id": 3, "tags": [""]})",
+      R"({"id": 3, "tags": [], "kind": "c"})",
+      R"({"id": 3, "tags": [], "extra": 1})",
+      R"({"id": 3.5, "tags": []})",
+      R"({"id": 3, "tags": {"a": 1}})",
+      "{id: 3, tags: ['x',], kind: 'b',}",
+      R"({"id": 3, "tags": ["x", "y", "z",]})",
+      R"({"id": 3, "tags": ["x", "y", "z", "w",]})",
+      R"({"id": 3, "tags": ["x"], "extra": 1,})",
+  };
+  for (const auto& text : cases) {
+    std::string two_pass;
+    std::string fused;
+    try {
+      two_pass = dumps_json(parse_and_validate_ex(text, schema).value);
+    } catch (const ValidationError& e) {
+      two_pass = "error " + e.path;
+    }
+    try {
+      fused = dumps_json(parse_and_validate_fused(text, schema).value);
+    } catch (const ValidationError& e) {
+      fused = "error " + e.path;
+    }
+    assert(two_pass == fused);
+  }
+
+  // Under LastWins only the surviving duplicate is checked.
+  bool threw = false;
+  RepairConfig last_wins;
+  last_wins.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::LastWins;
+  CompiledSchema str(loads_jsonish(R"({"properties": {"a": {"type": "string"}}})"));
+  CompiledSchema max3(loads_jsonish(R"({"properties": {"a": {"maximum": 3}}})"));
+  assert(dumps_json(parse_and_validate_ex(R"({"a": 1, "a": "x"})", str, last_wins).value) == R"({"a":"x"})");
+  assert(dumps_json(parse_and_validate_fused(R"({"a": 1, "a": "x"})", str, last_wins).value) == R"({"a":"x"})");
+  assert(dumps_json(parse_and_validate_fused(R"({"a": 10, "a": 2})", max3, last_wins).value) == R"({"a":2})");
+  threw = false;
+  try {
+    parse_and_validate_fused(R"({"a": 2, "a": 10})", max3, last_wins);
+  } catch (const ValidationError& e) {
+    threw = e.path == "$.a";
+  }
+  assert(threw);
+
+  // A trailing comma is repaired rather than counted as one more item.
+  CompiledSchema two(loads_jsonish(R"({"properties": {"a": {"maxItems": 2}}})"));
+  assert(dumps_json(parse_and_validate_fused(R"({"a": [1, 2,]})", two).value) == R"({"a":[1,2]})");
+
+  // Violations are reported before the rest of the document is read, even if it would not parse.
+  threw = false;
+  try {
+    parse_and_validate_fused(R"({"id": 3, "tags": "nope", "oops": [1, 2, @@]})", schema);
+  } catch (const ValidationError& e) {
+    threw = e.kind == "type" && e.path == "$.tags";
+  }
+  assert(threw);
+  threw = false;
+  try {
+    parse_and_validate_fused(R"({"id": 3, "tags": [], "big": [1, 2, @@]})", schema);
+  } catch (const ValidationError& e) {
+    threw = e.path == "$.big" && std::string(e.what()).find("additionalProperties") != std::string::npos;
+  }
+  assert(threw);
+
+  // Unconstrained members can be dropped instead of built.
+  FusedValidateConfig drop;
+  drop.drop_unconstrained_properties = true;
+  auto r = parse_and_validate_fused(R"({"id": 1, "tags": [], "meta": {"score": 2, "blob": {"x": [1, 2]}}})", schema,
+                                    RepairConfig{}, drop);
+  assert(dumps_json(r.value) == R"({"id":1,"tags":[],"meta":{"score":2}})");
+  assert(r.metadata.used_strict_fast_path);
+}
+
+static void test_json_equality_hash() {
+  Json a = loads_jsonish(R"({"x": [1, 2.5, "s", null, true], "y": {"k": 1, "j": {}}})");
+  Json b = loads_jsonish(R"({"y": {"j": {}, "k": 1.0}, "x": [1.0, 2.5, "s", null, true]})");
+  assert(a == b && hash(a) == hash(b));
+  assert(Json(1) == Json(1.0) && hash(Json(1)) == hash(Json(1.0)) && hash(Json(0)) == hash(Json(-0.0)));
+  assert(Json(int64_t(9007199254740993LL)) != Json(9007199254740992.0));
+  assert(Json("1") != Json(1) && Json(nullptr) != Json(false) && Json(JsonArray{}) != Json(JsonObject{}));
+  assert(loads_jsonish(R"({"x": [1, 2]})") != loads_jsonish(R"({"x": [2, 1]})"));
+  assert(loads_jsonish(R"({"a": 1})") != loads_jsonish(R"({"a": 1, "b": 2})"));
+
+  std::unordered_set<Json> seen{a, Json("s"), Json(2)};
+  assert(seen.count(b) && seen.count(Json(2.0)) && !seen.count(Json(2.5)));
+
+  // enum/const compare structurally.
+  JsonArray values;
+  for (int i = 0; i < 200; ++i) values.push_back(Json("v" + std::to_string(i)));
+  values.push_back(loads_jsonish(R"({"p": 1, "q": [true]})"));
+  values.push_back(Json(3));
+  CompiledSchema schema(Json(JsonObject{{"enum", Json(values)}}));
+  validate(Json("v150"), schema);
+  validate(loads_jsonish(R"({"q": [true], "p": 1.0})"), schema);
+  validate(Json(3.0), schema);
+  bool threw = false;
+  try {
+    validate(Json("v200"), schema);
+  } catch (const ValidationError& e) {
+    threw = std::string(e.what()) == "value not in enum";
+  }
+  assert(threw);
+  CompiledSchema konst(loads_jsonish(R"({"const": {"a": [1, {"b": null}], "c": "d"}})"));
+  validate(loads_jsonish(R"({"c": "d", "a": [1.0, {"b": null}]})"), konst);
+  assert(!validate_all(loads_jsonish(R"({"c": "d", "a": [1, {"b": 0}]})"), konst).empty());
+}
+
+static void test_json_writer() {
+  assert(dumps_json(Json(0.1)) == "0.1" && dumps_json(Json(1.0 / 3.0)) == "0.3333333333333333");
+  assert(dumps_json(Json(3.0)) == "3" && dumps_json(Json(-0.0)) == "-0" && dumps_json(Json(1e300)) == "1e+300");
+  // Whole numbers keep fixed notation: the TypeScript addon builds every number as a double.
+  assert(dumps_json(Json(1000000.0)) == "1000000" && dumps_json(Json(1e15)) == "1000000000000000");
+  assert(dumps_json(Json(-4503599627370496.0)) == "-4503599627370496" && dumps_json(Json(1e17)) == "1e+17");
+  assert(dumps_json(loads_yamlish("n: 1000000")) == "{\"n\":1000000}");
+  assert(dumps_json(Json(std::nan(""))) == "null" && dumps_json(Json(int64_t(-9223372036854775807LL - 1))) == "-9223372036854775808");
+  assert(dumps_json(Json("a\"b\\c\n\x01\xc3\xa9")) == "\"a\\\"b\\\\c\\n\\u0001\xc3\xa9\"");
+
+  // Doubles round-trip exactly.
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (int i = 0; i < 2000; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    double d;
+    uint64_t bits = state;
+    std::memcpy(&d, &bits, sizeof(d));
+    if (!std::isfinite(d)) continue;
+    const Json back = loads_jsonish("{\"v\": " + dumps_json(Json(d)) + "}");
+    assert(back.as_object().at("v").as_number() == d);
+  }
+
+  // A reused writer appends into the same buffer; a caller's string is appended to in place.
+  Json v = loads_jsonish(R"({"id": 7, "tags": ["x", "y"], "score": 0.25, "ok": true, "none": null})");
+  JsonWriter w;
+  w.write(v);
+  assert(w.str() == dumps_json(v) && w.str() == R"({"id":7,"tags":["x","y"],"score":0.25,"ok":true,"none":null})");
+  const size_t cap = w.str().capacity();
+  w.clear();
+  w.write(v);
+  assert(w.str() == dumps_json(v) && w.str().capacity() == cap);
+  std::string out = "data: ";
+  JsonWriter(out).write(Json(JsonArray{Json(1), Json("two")})).write_string("!");
+  assert(out == "data: [1,\"two\"]\"!\"");
+}
+
+static void test_output_sinks() {
+  const Json v = loads_jsonish(R"({"name": "a:b", "n": 3, "x": 0.5, "tags": ["t1", "t2"], "meta": {"k": true}, "rows": [{"id": 1}, {"id": 2}]})");
+
+  // Every sink kind produces byte-identical output to the string serializers.
+  std::string s = "> ";
+  {
+    OutputSink sink(s);
+    dump_json(v, sink);
+    assert(sink.size() == s.size() - 2);
+  }
+  assert(s == "> " + dumps_json(v));
+
+  std::ostringstream os;
+  {
+    OutputSink sink(os, 8);
+    dump_yaml(v, sink);
+  }
+  assert(os.str() == dumps_yaml(v));
+
+  std::FILE* f = std::tmpfile();
+  assert(f);
+  {
+    OutputSink sink(f);
+    dump_toml(v, sink);
+  }
+  std::rewind(f);
+  std::string from_file;
+  char chunk[256];
+  for (size_t n; (n = std::fread(chunk, 1, sizeof(chunk), f)) > 0;) from_file.append(chunk, n);
+  std::fclose(f);
+  assert(from_file == dumps_toml(v));
+
+  // A small callback buffer is handed on in bounded chunks.
+  std::string collected;
+  size_t chunks = 0, largest = 0;
+  {
+    OutputSink sink(
+        [&](std::string_view c) {
+          ++chunks;
+          largest = std::max(largest, c.size());
+          collected.append(c.data(), c.size());
+        },
+        16);
+    dump_json(v, sink);
+    assert(sink.size() == collected.size());
+  }
+  assert(collected == dumps_json(v) && chunks > 1 && largest < 64);
+
+  const XmlNode doc = loads_xml("<root a=\"1\"><item>x</item><item>y</item></root>");
+  std::string xml;
+  {
+    OutputSink sink([&](std::string_view c) { xml.append(c.data(), c.size()); }, 4);
+    dump_xml(doc, sink);
+  }
+  assert(xml == dumps_xml(doc));
+
+  // Pretty-printed JSON.
+  std::string pretty;
+  {
+    OutputSink sink(pretty);
+    dump_json(loads_jsonish(R"({"a": [1, {}], "b": {"c": []}})"), sink, 2);
+  }
+  assert(pretty == "{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": {\n    \"c\": []\n  }\n}");
+  assert(loads_jsonish(pretty) == loads_jsonish(R"({"a": [1, {}], "b": {"c": []}})"));
+}
+
+// The try_* result must report exactly what the throwing call raises (or return the same value).
+template <typename Throwing, typename T>
+static void expect_same_outcome(Throwing&& throwing, const TryResult<T>& r) {
+  try {
+    const T expected = throwing();
+    assert(r.ok() && r.code == ErrorCode::Ok);
+    if constexpr (std::is_same_v<T, Json>) assert(r.value == expected);
+  } catch (const ValidationError& e) {
+    assert(!r.ok() && !r);
+    assert(r.path == e.path && r.message == e.message);
+    assert(r.code != ErrorCode::Ok && r.code != ErrorCode::NotFound && r.code != ErrorCode::Internal);
+  } catch (const std::runtime_error& e) {
+    assert(r.code == ErrorCode::NotFound && r.message == e.what());
+  }
+}
+
+static void test_try_api() {
+  const Json schema = loads_jsonish(R"({
+    "type": "object",
+    "required": ["id", "tags"],
+    "additionalProperties": false,
+    "properties": {
+      "id": {"type": "integer", "minimum": 1},
+      "tags": {"type": "array", "maxItems": 2, "items": {"type": "string", "enum": ["a", "b"]}},
+      "name": {"type": "string", "pattern": "^[a-z]+$"}
+    }
+  })");
+  const CompiledSchema compiled(schema);
+  const std::vector<std::string> inputs = {
+      R"({"id": 1, "tags": ["a"]})",
+      R"(Sure: ```json
+{"id": 2, "tags": ["b", "a"], "name": "x"}
+```)",
+      R"({id: 3, 'tags': ['a',], name: "y",})",
+      R"({"id": 0, "tags": []})",
+      R"({"id": 1.5, "tags": []})",
+      R"({"id": 1, "tags": ["a", "b", "a"]})",
+      R"({"id": 1, "tags": ["c"]})",
+      R"({"id": 1, "tags": [], "extra": true})",
+      R"({"id": 1, "tags": [], "name": "UPPER"})",
+      R"({"id": 1})",
+      R"({"id": 1, "tags": [1 2]})",
+      R"({"id": @@, "tags": []})",
+      R"({"id": 1, "tags": [], "id": 2})",
+      R"([1, 2, tru])",
+      R"("unterminated)",
+      "no structured output here",
+      "Sorry, nothing to report.",
+      "",
+      R"({"a": "é", "b": -0, "c": 1e400})",
+  };
+  for (const auto& text : inputs) {
+    expect_same_outcome([&] { return loads_jsonish(text); }, try_loads_jsonish(text));
+    expect_same_outcome([&] { return parse_and_validate(text, schema); }, try_parse_and_validate(text, schema));
+    expect_same_outcome([&] { return parse_and_validate(text, compiled); }, try_parse_and_validate(text, compiled));
+    RepairConfig strict;
+    strict.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::Error;
+    strict.allow_single_quotes = false;
+    expect_same_outcome([&] { return loads_jsonish_ex(text, strict).value; }, try_loads_jsonish(text, strict));
+  }
+
+  auto no_json = try_loads_jsonish("Sorry, no JSON.");
+  assert(no_json.code == ErrorCode::NotFound && no_json.value.is_null());
+  RepairConfig dup_error;
+  dup_error.duplicate_key_policy = RepairConfig::DuplicateKeyPolicy::Error;
+  auto dup = try_loads_jsonish(R"({"k": 1, "k": 2})", dup_error);
+  assert(dup.code == ErrorCode::DuplicateKey && dup.path == "$.k" && dup.value.is_null());
+  auto bad = try_parse_and_validate(R"({"id": 1, "tags": ["a", "b", "a"]})", compiled);
+  assert(bad.code == ErrorCode::Schema && bad.path == "$.tags" && bad.value.is_null());
+  auto wrong_type = try_validate(Json("x"), compiled);
+  assert(wrong_type.code == ErrorCode::Type && wrong_type.message == "expected object");
+  assert(try_validate(Json(1), Json("not a schema")).message == "schema must be object");
+
+  // try_validate reports the violation validate() throws, and validate_all() lists first.
+  const Json value = loads_jsonish(R"({"tags": ["a", "z"], "extra": 1})");
+  const TryStatus first = try_validate(value, schema);
+  const auto all = validate_all(value, schema);
+  assert(!first.ok() && !all.empty() && first.path == all.front().path && first.message == all.front().message);
+
+  const Json yaml_schema = loads_jsonish(R"({"type": "object", "required": ["name"], "properties": {"port": {"type": "integer"}}})");
+  for (const std::string text : {"name: app\nport: 80", "name: app\nport: eighty", "port: 80", "items: [1, 2", "cfg: {bad json}"}) {
+    expect_same_outcome([&] { return loads_yamlish(text); }, try_loads_yamlish(text));
+    expect_same_outcome([&] { return parse_and_validate_yaml(text, yaml_schema); }, try_parse_and_validate_yaml(text, yaml_schema));
+  }
+  for (const std::string text : {"name = \"app\"\nport = 0x50", "port = 1e999", "name = \"app\"\nport = \"x\"", "v = 12abc"}) {
+    expect_same_outcome([&] { return loads_tomlish(text); }, try_loads_tomlish(text));
+    expect_same_outcome([&] { return parse_and_validate_toml(text, yaml_schema); }, try_parse_and_validate_toml(text, yaml_schema));
+  }
+
+  const Json xml_schema = loads_jsonish(R"({"element": "root", "requiredAttributes": ["id"], "children": {"required": ["item"]}})");
+  for (const std::string text : {"<root id=\"1\"><item/></root>", "<root><item/></root>", "<root id=\"1\">&#xZZ;</root>", "<other/>"}) {
+    expect_same_outcome([&] { return parse_and_validate_xml(text, xml_schema); }, try_parse_and_validate_xml(text, xml_schema));
+    assert(try_loads_xml(text).ok() && dumps_xml(try_loads_xml(text).value) == dumps_xml(loads_xml(text)));
+  }
+  auto xml_bad = try_parse_and_validate_xml("<root><item/></root>", xml_schema);
+  assert(xml_bad.code == ErrorCode::Schema && xml_bad.message == "Missing required attribute 'id'");
+}
+
+static void test_multi_candidate_scan() {
+  // Unmatched brackets before the candidates do not hide them, and nested brackets are not re-emitted.
+  std::string text = "Notes { and [ never close.\n";
+  for (int i = 0; i < 200; ++i) text += "row " + std::to_string(i) + " {\"i\": " + std::to_string(i) + ", \"t\": [1]}\n";
+  const auto candidates = extract_json_candidates(text);
+  assert(candidates.size() == 200);
+  assert(candidates.front() == "{\"i\": 0, \"t\": [1]}" && candidates.back() == "{\"i\": 199, \"t\": [1]}");
+  const auto values = loads_jsonish_all(text);
+  assert(values.size() == 200 && values[7].as_object().at("i").as_int64() == 7);
+
+  // Brackets inside strings are ignored; arrays and objects come back in text order.
+  auto mixed = extract_json_candidates("a [1, \"}\"] b {\"k\": \"[\"} c [2]");
+  assert(mixed.size() == 3 && mixed[0] == "[1, \"}\"]" && mixed[1] == "{\"k\": \"[\"}" && mixed[2] == "[2]");
+
+  // Fenced blocks are ordered by position among bracket candidates.
+  auto fenced = extract_json_candidates("{\"a\": 1}\n```json\n{\"b\": 2}\n```\n{\"c\": 3}");
+  assert(fenced.size() == 3 && fenced[0] == "{\"a\": 1}" && fenced[1] == "{\"b\": 2}" && fenced[2] == "{\"c\": 3}");
+
+  // One append holding many items is drained in a single poll, and a trailing partial item waits.
+  // (A stream keeps waiting on an open bracket, so the stray prefix is left out here.)
+  JsonStreamBatchCollector c(Json(JsonObject{{"type", "object"}}));
+  c.append(text.substr(text.find('\n') + 1) + "{\"partial\": ");
+  auto o = c.poll();
+  assert(o.ok && o.value.has_value() && o.value->size() == 200);
+  c.append("true}");
+  auto rest = c.poll();
+  assert(rest.ok && rest.value->size() == 1 && rest.value->front().as_object().at("partial").as_bool());
+}
+
+static void test_structural_scan_extractors() {
+  // Structural bytes are found at every offset around the 16/32/64-byte blocks the scanner compares.
+  for (size_t pad = 0; pad < 140; ++pad) {
+    const std::string prose(pad, 'x');
+    assert(extract_json_candidate(prose + "{\"a\": \"}\\\"\"}" + prose) == "{\"a\": \"}\\\"\"}");
+    assert(extract_json_candidate(prose + "[1, [2]]" + prose) == "[1, [2]]");
+    assert(extract_json_candidate(prose + "\n  ```JSON\r\n{\"b\": 2}\r\n```\n") == "{\"b\": 2}");
+    assert(extract_sql_candidate(prose + "\n```sql\nSELECT 1\n```") == "SELECT 1");
+    assert(extract_xml_candidate(prose + " <r a=\"1 2\" b='3'/> after") == "<r a=\"1 2\" b='3'/>");
+  }
+
+  // A backtick run that is not at the start of its line does not open a fence.
+  assert(extract_json_candidate("see ```json\n{\"a\": 1}\n``` and [2]") == "{\"a\": 1}");
+  assert(extract_yaml_candidate("intro\n```yaml\n\nname: app\n```\n") == "name: app");
+  assert(extract_yaml_candidates("```yml\na: 1\n```\n---\nb: 2\n").front() == "a: 1");
+
+  // The first statement ends at a ';' outside strings and comments.
+  SqlStreamParser sql(Json(JsonObject{}));
+  sql.append("SELECT ';' -- not here;\n/* nor ; here */ FROM t; SELECT 2;");
+  auto stmt = sql.poll();
+  assert(stmt.ok && stmt.value && stmt.value->sql == "SELECT ';' -- not here;\n/* nor ; here */ FROM t");
+}
+
+static void test_structured_blocks() {
+  const std::string text =
+      "Here is the plan {\"step\": 1} and the files.\n"
+      "```json\n[{\"a\": 1}, {\"a\": 2}]\n```\n"
+      "```yml\r\nname: app\r\nport: 80\r\n```\r\n"
+      "```python\nprint({'not': 'json'})\n```\n"
+      "  ```TOML\n[server]\nport = 8080\n```\n"
+      "```html\n<DIV class=\"x\"><p>hi</p></DIV>\n```\n"
+      "A bracket { left open before\n"
+      "```sql\nSELECT id FROM users LIMIT 5\n```\n"
+      "then } and [1, 2].\n"
+      "```xml\n<r id=\"1\"><i/></r>";  // never closed: runs to the end
+
+  const auto blocks = extract_structured_blocks(text);
+  assert(blocks.size() == 8);
+  auto body_of = [](const std::string& in, const StructuredBlock& b) { return in.substr(b.start, b.end - b.start); };
+  auto body = [&](const StructuredBlock& b) { return body_of(text, b); };
+  assert(blocks[0].format == BlockFormat::Json && !blocks[0].fenced && body(blocks[0]) == "{\"step\": 1}");
+  assert(blocks[1].format == BlockFormat::Json && blocks[1].fenced && blocks[1].lang == "json");
+  assert(body(blocks[1]) == "[{\"a\": 1}, {\"a\": 2}]");
+  assert(blocks[2].format == BlockFormat::Yaml && blocks[2].lang == "yml" && body(blocks[2]) == "name: app\r\nport: 80");
+  assert(blocks[3].format == BlockFormat::Toml && blocks[3].lang == "TOML");
+  assert(blocks[4].format == BlockFormat::Html);
+  assert(blocks[5].format == BlockFormat::Sql && body(blocks[5]) == "SELECT id FROM users LIMIT 5");
+  // A bracket opened before a fence does not pair with one after it.
+  assert(!blocks[6].fenced && body(blocks[6]) == "[1, 2]");
+  assert(blocks[7].format == BlockFormat::Xml && body(blocks[7]) == "<r id=\"1\"><i/></r>");
+  for (size_t i = 1; i < blocks.size(); ++i) assert(blocks[i - 1].end <= blocks[i].start);
+
+  const auto parsed = parse_structured_blocks(text);
+  assert(parsed.size() == blocks.size());
+  for (const auto& p : parsed) assert(p.ok());
+  assert(parsed[0].value == loads_jsonish("{\"step\": 1}"));
+  // The fenced array is parsed whole, not re-extracted down to its first object.
+  assert(parsed[1].value.is_array() && parsed[1].value.as_array().size() == 2);
+  assert(parsed[2].value.as_object().at("port").as_number() == 80);
+  assert(parsed[3].value.as_object().at("server").as_object().at("port").as_number() == 8080);
+  assert(parsed[4].xml.name == "div" && xml_get_attribute(parsed[4].xml, "class") == "x");
+  assert(parsed[5].sql.statementType == "select" && parsed[5].sql.limit == 5);
+  assert(parsed[7].xml.name == "r" && parsed[7].xml.children.size() == 1);
+
+  auto bad = parse_structured_blocks("```json\n{\"a\": [1 2}\n```");
+  assert(bad.size() == 1 && bad[0].code == ErrorCode::Parse && bad[0].value.is_null());
+  assert(extract_structured_blocks("no blocks here").empty());
+
+  // An untagged fence is searched for JSON like extract_json_candidates does.
+  const std::string untagged = "Result:\n```\n{\"b\":2}\n```\n```\nplain text\n```";
+  const auto found = extract_structured_blocks(untagged);
+  assert(found.size() == 1 && found[0].format == BlockFormat::Json && body_of(untagged, found[0]) == "{\"b\":2}");
+  assert(extract_json_candidates(untagged) == std::vector<std::string>{"{\"b\":2}"});
+  assert(parse_structured_blocks(untagged)[0].value == loads_jsonish("{\"b\": 2}"));
+}
+
+static void test_json_stream_parser_incremental() {
+  // Fed a byte at a time, the parser finishes on exactly the byte that closes the candidate.
+  const std::string text = "Sure: {\"msg\": \"a } and a \\\" inside\", \"n\": {\"y\": 2}} trailing";
+  const size_t close = text.find(" trailing");
+  JsonStreamParser p(Json(JsonObject{}));
+  for (size_t i = 0; i < text.size(); ++i) {
+    p.append(text.substr(i, 1));
+    auto out = p.poll();
+    assert(out.done == (i + 1 >= close));
+    if (out.done) {
+      assert(out.ok && out.value->as_object().at("msg").as_string() == "a } and a \" inside");
+      break;
+    }
+  }
+
+  // A ```json fence takes over from brackets, and an unclosed one keeps the parser waiting.
+  JsonStreamParser f(Json(JsonObject{}));
+  f.append("{\"early\": 1} then\n``");
+  f.append("`JSON\n[1,");
+  assert(!f.poll().done);
+  f.append(" 2]\r\n");
+  assert(!f.poll().done);
+  f.append("  ```\n");
+  auto fenced = f.poll();
+  assert(fenced.done && fenced.ok && *fenced.value == loads_jsonish("[1, 2]"));
+
+  // location() tracks appends; reset() starts the scan over.
+  f.reset();
+  f.append("ab\ncd");
+  auto loc = f.location();
+  assert(loc.offset == 5 && loc.line == 2 && loc.col == 3);
+  f.append("{\"a\": 1}");
+  assert(f.poll().ok);
+}
+
+static void test_json_stream_parser_partial() {
+  JsonStreamParser p(Json(JsonObject{}));
+  assert(p.poll_partial().value.is_null() && p.poll_partial().incomplete.empty());
+
+  p.append("Calling the tool: {\"city\": \"Par");
+  const PartialJson& view = p.poll_partial();
+  assert(view.value == loads_jsonish("{\"city\": \"Par\"}"));
+  assert((view.incomplete == std::vector<std::string>{"$", "$.city"}));
+
+  // A number still being written and a key without a value yet are left out.
+  p.append("is\", \"days\": [1, 2, {\"unit\": 'c', \"max\": 3");
+  assert(p.poll_partial().value == loads_jsonish("{\"city\": \"Paris\", \"days\": [1, 2, {\"unit\": \"c\"}]}"));
+  assert((p.poll_partial().incomplete == std::vector<std::string>{"$", "$.days", "$.days[2]"}));
+  p.append("0}], \"note\"");
+  assert(p.poll_partial().value.as_object().at("days").as_array()[2].as_object().at("max").as_int64() == 30);
+  assert(!p.poll_partial().value.as_object().contains("note"));
+
+  p.append(": null}");
+  assert(p.poll_partial().complete && p.poll_partial().incomplete.empty());
+  auto out = p.poll();
+  assert(out.ok && p.poll_partial().value == *out.value);
+
+  // A ```json fence replaces whatever bracket run came before it.
+  JsonStreamParser f(Json(JsonObject{}));
+  f.append("Options [a, b]\n```json\n[{\"id\": 1}, {\"id\"");
+  assert(f.poll_partial().value == Json(JsonArray{Json(JsonObject{{"id", Json(1)}}), Json(JsonObject{})}));
+  assert((f.poll_partial().incomplete == std::vector<std::string>{"$", "$[1]"}));
+  f.reset();
+  assert(f.poll_partial().value.is_null());
+}
+
 int main() {
   auto run = [](const char* name, void (*fn)()) {
     try {
@@ -788,6 +1864,32 @@ int main() {
     run("schema_const_keyword", test_schema_const_keyword);
     run("schema_allof_keyword", test_schema_allof_keyword);
     run("additional_properties_schema_is_enforced", test_additional_properties_schema_is_enforced);
+    run("compiled_schema_matches_json_schema", test_compiled_schema_matches_json_schema);
+    run("compiled_schema_stream_collector", test_compiled_schema_stream_collector);
+    run("pattern_regex_cache_reuses_compiled_regex", test_pattern_regex_cache_reuses_compiled_regex);
+    run("string_format_validators", test_string_format_validators);
+    run("pattern_linear_time_engine", test_pattern_linear_time_engine);
+    run("validate_error_paths_nested", test_validate_error_paths_nested);
+    run("combinators_probe_without_errors", test_combinators_probe_without_errors);
+    run("discriminated_union_dispatch", test_discriminated_union_dispatch);
+    run("strict_fast_path", test_strict_fast_path);
+    run("fused_repair_scan", test_fused_repair_scan);
+    run("number_parsing_matches_strtod", test_number_parsing_matches_strtod);
+    run("int64_exact_numbers", test_int64_exact_numbers);
+    run("json_document_arena", test_json_document_arena);
+    run("json_object_insertion_order", test_json_object_insertion_order);
+    run("json_view_tape", test_json_view_tape);
+    run("sax_events", test_sax_events);
+    run("fused_parse_validate", test_fused_parse_validate);
+    run("json_equality_hash", test_json_equality_hash);
+    run("json_writer", test_json_writer);
+    run("output_sinks", test_output_sinks);
+    run("try_api", test_try_api);
+    run("multi_candidate_scan", test_multi_candidate_scan);
+    run("structural_scan_extractors", test_structural_scan_extractors);
+    run("structured_blocks", test_structured_blocks);
+    run("json_stream_parser_incremental", test_json_stream_parser_incremental);
+    run("json_stream_parser_partial", test_json_stream_parser_partial);
     std::cout << "OK\n";
     return 0;
   } catch (...) {
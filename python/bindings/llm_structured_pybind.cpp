@@ -60,6 +60,7 @@ static py::object ToPyNumber(double n) {
 static py::object ToPy(const Json& v) {
   if (v.is_null()) return py::none();
   if (v.is_bool()) return py::bool_(v.as_bool());
+  if (v.is_int64()) return py::int_(v.as_int64());
   if (v.is_number()) return ToPyNumber(v.as_number());
   if (v.is_string()) return py::str(v.as_string());
   if (v.is_array()) return ToPyArray(v.as_array());
@@ -103,7 +104,7 @@ static bool FromPy(py::handle v, Json& out) {
     return true;
   }
   if (py::isinstance<py::int_>(v)) {
-    // Json stores numbers as double; keep integer range loss-minimal.
+    // Json keeps int64 exact; larger Python ints do not fit and raise.
     const int64_t i = py::cast<int64_t>(v);
     out = Json(i);
     return true;
@@ -207,6 +208,7 @@ static RepairConfig RepairConfigFromPy(py::object o) {
   set_bool("quoteUnquotedKeys", cfg.quote_unquoted_keys);
   set_bool("dropTrailingCommas", cfg.drop_trailing_commas);
   set_bool("allowSingleQuotes", cfg.allow_single_quotes);
+  set_bool("strictFastPath", cfg.strict_fast_path);
 
   if (d.contains("duplicateKeyPolicy")) {
     const std::string raw = py::cast<std::string>(d["duplicateKeyPolicy"]);
@@ -236,6 +238,7 @@ static py::dict RepairMetadataToPy(const RepairMetadata& m) {
   d["convertedKvObject"] = m.converted_kv_object;
   d["quotedUnquotedKeys"] = m.quoted_unquoted_keys;
   d["droppedTrailingCommas"] = m.dropped_trailing_commas;
+  d["usedStrictFastPath"] = m.used_strict_fast_path;
   d["duplicateKeyCount"] = m.duplicateKeyCount;
 
   const auto pol = m.duplicateKeyPolicy;
@@ -216,6 +216,7 @@ static bool RepairConfigFromNapi(napi_env env, napi_value v, llm_structured::Rep
   if (!GetOptionalBoolProperty(env, v, "quoteUnquotedKeys", out.quote_unquoted_keys)) return false;
   if (!GetOptionalBoolProperty(env, v, "dropTrailingCommas", out.drop_trailing_commas)) return false;
   if (!GetOptionalBoolProperty(env, v, "allowSingleQuotes", out.allow_single_quotes)) return false;
+  if (!GetOptionalBoolProperty(env, v, "strictFastPath", out.strict_fast_path)) return false;
 
   std::string pol;
   if (!GetOptionalStringProperty(env, v, "duplicateKeyPolicy", pol)) return false;
@@ -305,6 +306,8 @@ static napi_value RepairMetadataToNapi(napi_env env, const llm_structured::Repai
   napi_set_named_property(env, obj, "quotedUnquotedKeys", b);
   napi_get_boolean(env, m.dropped_trailing_commas, &b);
   napi_set_named_property(env, obj, "droppedTrailingCommas", b);
+  napi_get_boolean(env, m.used_strict_fast_path, &b);
+  napi_set_named_property(env, obj, "usedStrictFastPath", b);
 
   napi_value n;
   napi_create_int32(env, m.duplicateKeyCount, &n);
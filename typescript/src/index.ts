@@ -230,6 +230,8 @@ export interface RepairConfig {
   quoteUnquotedKeys?: boolean;
   dropTrailingCommas?: boolean;
   allowSingleQuotes?: boolean;
+  // Parse as-is first and only run the repairs above if that fails (default: true).
+  strictFastPath?: boolean;
 
   // How to handle duplicate keys within JSON objects.
   // - "firstWins" (default): keep the first value
@@ -246,6 +248,8 @@ export interface RepairMetadata {
   convertedKvObject: boolean;
   quotedUnquotedKeys: boolean;
   droppedTrailingCommas: boolean;
+  // True when the payload parsed as-is and no repair pass ran.
+  usedStrictFastPath: boolean;
 
   // Number of duplicate keys encountered while parsing objects.
   duplicateKeyCount: number;